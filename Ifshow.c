@@ -1,136 +1,2019 @@
+#define _GNU_SOURCE // strptime
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
-#include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <net/if.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+
+#include "iftrie.h"
+#include "nlutil.h"
+#include "ifsnapshot.h"
+
+/*
+ * Affiche les adresses IPv4 et IPv6 de toutes les interfaces (ifname_filter
+ * NULL, "ifname: adresse/préfixe") ou d'une seule ("adresse/préfixe"),
+ * dans le format de 'render' (texte, JSON ou binaire : ifsnapshot.h).
+ */
+static void show_interface(const char *ifname_filter, ifsnap_render_fn render) {
+    ifsnap_t snap = { NULL, 0, 0, 0 };
+    if (ifsnap_collect_alloc(&snap, ifname_filter) < 0) {
+        perror("rtnetlink");
+        exit(EXIT_FAILURE);
+    }
+
+    int with_name = ifname_filter == NULL;
+    size_t len = render(&snap, with_name, NULL, 0);
+    char *out = malloc(len + 1);
+    if (!out) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    render(&snap, with_name, out, len + 1);
+    fwrite(out, 1, len, stdout);
+
+    free(out);
+    free(snap.recs);
+}
+
+/*
+ * Indique, pour chaque adresse, l'interface qui la possède ou la dessert
+ * (plus long préfixe). L'arbre est construit une fois à partir d'un
+ * instantané des adresses ; avec "-", les adresses sont lues sur l'entrée standard,
+ * une par ligne, et les réponses écrites par gros blocs.
+ */
+static void show_owner(char **ips, int count) {
+    ifsnap_t snap = { NULL, 0, 0, 0 };
+    if (ifsnap_collect_alloc(&snap, NULL) < 0) {
+        perror("rtnetlink");
+        exit(EXIT_FAILURE);
+    }
+    iftrie_t trie;
+    iftrie_init(&trie);
+    ifsnap_to_trie(&snap, &trie);
+    free(snap.recs);
+    iftrie_build(&trie);
+
+    char out[256];
+    if (count == 1 && strcmp(ips[0], "-") == 0) {
+        static char obuf[1 << 20];
+        setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+
+        char line[256];
+        while (fgets(line, sizeof(line), stdin)) {
+            size_t len = strcspn(line, " \t\r\n");
+            if (len == 0) {
+                continue;
+            }
+            size_t n = iftrie_answer(&trie, line, len, out, sizeof(out));
+            fwrite(out, 1, n, stdout);
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            size_t n = iftrie_answer(&trie, ips[i], strlen(ips[i]), out, sizeof(out));
+            fwrite(out, 1, n, stdout);
+        }
+    }
+    fflush(stdout);
+    iftrie_free(&trie);
+}
+
+/*
+ * Table de routage (-r), lue par un dump RTM_GETROUTE.
+ * Chaque route est affichée dès sa réception : la mémoire reste bornée
+ * au buffer netlink, même avec une table BGP complète.
+ */
+typedef struct {
+    int           table;      // -1 = toutes
+    int           protocol;   // -1 = tous
+    int           family;     // AF_UNSPEC si pas de préfixe
+    unsigned char prefix[16];
+    int           prefixlen;  // -1 = pas de filtre
+} route_filter_t;
+
+static const char *const route_tables[256] = {
+    [RT_TABLE_UNSPEC] = "unspec", [RT_TABLE_DEFAULT] = "default",
+    [RT_TABLE_MAIN]   = "main",   [RT_TABLE_LOCAL]   = "local",
+};
+
+static const char *const route_protocols[256] = {
+    [0] = "unspec", [1] = "redirect", [2] = "kernel", [3] = "boot",
+    [4] = "static", [8] = "gated", [9] = "ra", [10] = "mrt", [11] = "zebra",
+    [12] = "bird", [13] = "dnrouted", [14] = "xorp", [15] = "ntk",
+    [16] = "dhcp", [17] = "mrouted", [18] = "keepalived", [42] = "babel",
+    [186] = "bgp", [187] = "isis", [188] = "ospf", [189] = "rip",
+    [192] = "eigrp",
+};
+
+static const char *const route_types[RTN_MAX + 1] = {
+    [RTN_LOCAL] = "local", [RTN_BROADCAST] = "broadcast",
+    [RTN_ANYCAST] = "anycast", [RTN_MULTICAST] = "multicast",
+    [RTN_BLACKHOLE] = "blackhole", [RTN_UNREACHABLE] = "unreachable",
+    [RTN_PROHIBIT] = "prohibit", [RTN_THROW] = "throw", [RTN_NAT] = "nat",
+};
+
+// Nom ou numéro ("main", "254", "all") -> valeur ; -2 si inconnu
+static int parse_route_name(const char *const names[], const char *arg) {
+    if (strcmp(arg, "all") == 0) {
+        return -1;
+    }
+    for (int i = 0; i < 256; i++) {
+        if (names[i] && strcmp(names[i], arg) == 0) {
+            return i;
+        }
+    }
+    char *end;
+    long v = strtol(arg, &end, 10);
+    return (*arg && !*end && v >= 0) ? (int)v : -2;
+}
+
+/*
+ * Noms d'interfaces indexés par ifindex, résolus à la première rencontre :
+ * quelques appels à if_indextoname() pour un million de routes.
+ */
+static char (*ifname_cache)[IF_NAMESIZE];
+static int    ifname_cache_cap;
+
+static const char *cached_ifname(int ifindex) {
+    if (ifindex <= 0) {
+        return "?";
+    }
+    if (ifindex >= ifname_cache_cap) {
+        int cap = ifname_cache_cap ? ifname_cache_cap : 64;
+        while (cap <= ifindex) {
+            cap *= 2;
+        }
+        ifname_cache = realloc(ifname_cache, cap * sizeof(*ifname_cache));
+        if (!ifname_cache) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        memset(ifname_cache + ifname_cache_cap, 0,
+               (cap - ifname_cache_cap) * sizeof(*ifname_cache));
+        ifname_cache_cap = cap;
+    }
+    if (!ifname_cache[ifindex][0] && !if_indextoname(ifindex, ifname_cache[ifindex])) {
+        snprintf(ifname_cache[ifindex], IF_NAMESIZE, "if%d", ifindex);
+    }
+    return ifname_cache[ifindex];
+}
+
+static int prefix_match(const unsigned char *a, const unsigned char *p, int len) {
+    int bytes = len / 8, bits = len % 8;
+    if (memcmp(a, p, bytes) != 0) {
+        return 0;
+    }
+    return bits == 0 || ((a[bytes] ^ p[bytes]) & (0xff << (8 - bits))) == 0;
+}
+
+static int print_route(struct nlmsghdr *nh, void *ctx) {
+    const route_filter_t *f = ctx;
+    if (nh->nlmsg_type != RTM_NEWROUTE) {
+        return 0;
+    }
+    struct rtmsg *rtm = NLMSG_DATA(nh);
+    struct rtattr *tb[RTA_MAX + 1];
+    nl_parse_attrs(tb, RTA_MAX, RTM_RTA(rtm), RTM_PAYLOAD(nh));
+
+    int family = rtm->rtm_family;
+    if (family != AF_INET && family != AF_INET6) {
+        return 0;
+    }
+    int table = tb[RTA_TABLE] ? (int)*(unsigned int *)RTA_DATA(tb[RTA_TABLE]) : rtm->rtm_table;
+
+    // Filtres (le noyau les applique déjà s'il gère NETLINK_GET_STRICT_CHK)
+    if ((f->table >= 0 && table != f->table) ||
+        (f->protocol >= 0 && rtm->rtm_protocol != f->protocol)) {
+        return 0;
+    }
+    unsigned char dst[16] = {0};
+    if (tb[RTA_DST]) {
+        memcpy(dst, RTA_DATA(tb[RTA_DST]), family == AF_INET ? 4 : 16);
+    }
+    if (f->prefixlen >= 0 &&
+        (family != f->family || rtm->rtm_dst_len < f->prefixlen ||
+         !prefix_match(dst, f->prefix, f->prefixlen))) {
+        return 0;
+    }
+
+    // "type dst/len", au format des adresses de -a
+    char str[INET6_ADDRSTRLEN];
+    if (rtm->rtm_type != RTN_UNICAST && rtm->rtm_type <= RTN_MAX && route_types[rtm->rtm_type]) {
+        printf("%s ", route_types[rtm->rtm_type]);
+    }
+    inet_ntop(family, dst, str, sizeof(str));
+    printf("%s/%d", str, rtm->rtm_dst_len);
+
+    if (tb[RTA_GATEWAY]) {
+        inet_ntop(family, RTA_DATA(tb[RTA_GATEWAY]), str, sizeof(str));
+        printf(" via %s", str);
+    }
+    if (tb[RTA_OIF]) {
+        printf(" dev %s", cached_ifname(*(int *)RTA_DATA(tb[RTA_OIF])));
+    }
+    if (table != RT_TABLE_MAIN) {
+        if (table < 256 && route_tables[table]) {
+            printf(" table %s", route_tables[table]);
+        } else {
+            printf(" table %d", table);
+        }
+    }
+    if (route_protocols[rtm->rtm_protocol]) {
+        printf(" proto %s", route_protocols[rtm->rtm_protocol]);
+    } else {
+        printf(" proto %d", rtm->rtm_protocol);
+    }
+    if (rtm->rtm_scope == RT_SCOPE_LINK) {
+        printf(" scope link");
+    } else if (rtm->rtm_scope == RT_SCOPE_HOST) {
+        printf(" scope host");
+    }
+    if (tb[RTA_PREFSRC]) {
+        inet_ntop(family, RTA_DATA(tb[RTA_PREFSRC]), str, sizeof(str));
+        printf(" src %s", str);
+    }
+    if (tb[RTA_PRIORITY]) {
+        printf(" metric %u", *(unsigned int *)RTA_DATA(tb[RTA_PRIORITY]));
+    }
+
+    // Routes multi-chemins : un "nexthop" par chemin
+    if (tb[RTA_MULTIPATH]) {
+        struct rtnexthop *nhp = RTA_DATA(tb[RTA_MULTIPATH]);
+        int len = RTA_PAYLOAD(tb[RTA_MULTIPATH]);
+        while (len >= (int)sizeof(*nhp) && nhp->rtnh_len >= sizeof(*nhp) && nhp->rtnh_len <= len) {
+            struct rtattr *ntb[RTA_MAX + 1];
+            nl_parse_attrs(ntb, RTA_MAX, RTNH_DATA(nhp), nhp->rtnh_len - sizeof(*nhp));
+            printf(" nexthop");
+            if (ntb[RTA_GATEWAY]) {
+                inet_ntop(family, RTA_DATA(ntb[RTA_GATEWAY]), str, sizeof(str));
+                printf(" via %s", str);
+            }
+            printf(" dev %s weight %d", cached_ifname(nhp->rtnh_ifindex), nhp->rtnh_hops + 1);
+            len -= RTNH_ALIGN(nhp->rtnh_len);
+            nhp = RTNH_NEXT(nhp);
+        }
+    }
+    putchar('\n');
+    return 0;
+}
+
+static void show_routes(const route_filter_t *f) {
+    int fd = nl_open(0);
+    if (fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    // Filtrage côté noyau par table et protocole (Linux >= 4.20)
+    int one = 1;
+    int strict = setsockopt(fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &one, sizeof(one)) == 0;
+
+    struct {
+        struct rtmsg  rtm;
+        struct rtattr rta;
+        unsigned int  table;
+    } req;
+    memset(&req, 0, sizeof(req));
+    size_t len = sizeof(req.rtm);
+    req.rtm.rtm_family = f->family;
+    if (strict) {
+        if (f->protocol >= 0) {
+            req.rtm.rtm_protocol = f->protocol;
+        }
+        if (f->table >= 0) {
+            req.rta.rta_type = RTA_TABLE;
+            req.rta.rta_len  = RTA_LENGTH(sizeof(req.table));
+            req.table        = f->table;
+            len = sizeof(req);
+        }
+    }
+
+    static char obuf[1 << 20];
+    setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+    if (nl_dump(fd, RTM_GETROUTE, f->family, &req, len, print_route, (void *)f) < 0) {
+        perror("RTM_GETROUTE");
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    close(fd);
+}
+
+/*
+ * Vue des liens (-l) : un dump RTM_GETLINK puis un dump RTM_GETADDR sur
+ * le même socket, joints par ifindex dans un tableau indexé par ifindex
+ * (accès direct, pas de parcours de liste par adresse).
+ */
+typedef struct {
+    int           family;
+    unsigned char addr[16];
+    int           prefixlen;
+    int           scope;     // RT_SCOPE_* (global, link, host...)
+    unsigned int  flags;     // IFA_F_* (IFA_FLAGS s'il existe, sinon ifa_flags)
+    unsigned int  valid;     // durées de vie IFA_CACHEINFO en secondes,
+    unsigned int  preferred; // INFINITY_LIFE_TIME = permanente
+    int           next;      // adresse suivante du même lien, -1 = fin
+} link_addr_t;
+
+/*
+ * Filtre d'adresses, appliqué pendant le dump : les adresses écartées
+ * ne sont jamais stockées.
+ */
+typedef struct {
+    int stable_only; // ni deprecated, ni tentative, ni dadfailed, ni temporary
+    int scope;       // RT_SCOPE_*, -1 = toutes
+} addr_filter_t;
+
+typedef struct {
+    int           present;
+    char          name[IF_NAMESIZE];
+    char          kind[16];  // IFLA_INFO_KIND : bond, bridge, veth, vlan...
+    int           operstate;
+    unsigned int  flags;
+    unsigned int  mtu;
+    unsigned char mac[32];
+    int           mac_len;
+    int           master;    // ifindex du maître (bond, bridge), 0 = aucun
+    int           link;      // IFLA_LINK : lien inférieur (vlan, macvlan), pair (veth)
+    int           link_netns;// IFLA_LINK_NETNSID présent : 'link' est dans un autre netns
+    int           speed;     // Mb/s, -1 = inconnue (ou non demandée)
+    int           duplex;    // DUPLEX_*, -1 = inconnu
+    int           addr_head; // première adresse, -1 = aucune
+    int           addr_tail;
+} link_info_t;
+
+typedef struct {
+    link_info_t *links;      // indexé par ifindex
+    int          cap;
+    link_addr_t *addrs;
+    int          addr_count;
+    int          addr_cap;
+    addr_filter_t filter;
+} link_table_t;
+
+#ifndef INFINITY_LIFE_TIME
+#define INFINITY_LIFE_TIME 0xFFFFFFFFU
+#endif
+
+static const char *const scope_names[256] = {
+    [RT_SCOPE_UNIVERSE] = "global", [RT_SCOPE_SITE] = "site",
+    [RT_SCOPE_LINK] = "link", [RT_SCOPE_HOST] = "host",
+    [RT_SCOPE_NOWHERE] = "nowhere",
+};
+
+// Drapeaux affichés, dans l'ordre de "ip addr". IFA_F_PERMANENT est rendu
+// par son absence ("dynamic"), comme le fait iproute2.
+static const struct {
+    unsigned int flag;
+    const char  *name;
+} addr_flag_names[] = {
+    { IFA_F_NODAD,          "nodad" },
+    { IFA_F_OPTIMISTIC,     "optimistic" },
+    { IFA_F_DADFAILED,      "dadfailed" },
+    { IFA_F_HOMEADDRESS,    "home" },
+    { IFA_F_DEPRECATED,     "deprecated" },
+    { IFA_F_TENTATIVE,      "tentative" },
+    { IFA_F_MANAGETEMPADDR, "mngtmpaddr" },
+    { IFA_F_NOPREFIXROUTE,  "noprefixroute" },
+    { IFA_F_MCAUTOJOIN,     "autojoin" },
+};
+
+// Adresse "stable" pour les contrôles de santé : utilisable et durable
+static int addr_is_stable(int family, unsigned int flags) {
+    unsigned int bad = IFA_F_DEPRECATED | IFA_F_TENTATIVE | IFA_F_DADFAILED;
+    // IFA_F_TEMPORARY (adresse de confidentialité) vaut IFA_F_SECONDARY en IPv4
+    if (family == AF_INET6) {
+        bad |= IFA_F_TEMPORARY;
+    }
+    return (flags & bad) == 0;
+}
+
+// IFLA_OPERSTATE (RFC 2863) ; les IF_OPER_* de <linux/if.h> entrent en
+// conflit avec <net/if.h>, d'où les valeurs numériques
+static const char *const oper_names[] = {
+    "UNKNOWN", "NOTPRESENT", "DOWN", "LOWERLAYERDOWN", "TESTING", "DORMANT", "UP",
+};
+
+static link_info_t *link_slot(link_table_t *t, int ifindex) {
+    if (ifindex <= 0) {
+        return NULL;
+    }
+    if (ifindex >= t->cap) {
+        int cap = t->cap ? t->cap : 64;
+        while (cap <= ifindex) {
+            cap *= 2;
+        }
+        t->links = realloc(t->links, cap * sizeof(*t->links));
+        if (!t->links) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        memset(t->links + t->cap, 0, (cap - t->cap) * sizeof(*t->links));
+        t->cap = cap;
+    }
+    return &t->links[ifindex];
+}
+
+static int link_cb(struct nlmsghdr *nh, void *ctx) {
+    link_table_t *t = ctx;
+    if (nh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtattr *tb[IFLA_MAX + 1];
+    nl_parse_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(nh));
+
+    link_info_t *l = link_slot(t, ifi->ifi_index);
+    if (!l) {
+        return 0;
+    }
+    memset(l, 0, sizeof(*l));
+    l->present   = 1;
+    l->flags     = ifi->ifi_flags;
+    l->speed     = -1;
+    l->duplex    = -1;
+    l->addr_head = l->addr_tail = -1;
+    if (tb[IFLA_IFNAME]) {
+        snprintf(l->name, sizeof(l->name), "%s", (char *)RTA_DATA(tb[IFLA_IFNAME]));
+    }
+    if (tb[IFLA_OPERSTATE]) {
+        l->operstate = *(unsigned char *)RTA_DATA(tb[IFLA_OPERSTATE]);
+    }
+    if (tb[IFLA_MTU]) {
+        l->mtu = *(unsigned int *)RTA_DATA(tb[IFLA_MTU]);
+    }
+    if (tb[IFLA_MASTER]) {
+        l->master = *(int *)RTA_DATA(tb[IFLA_MASTER]);
+    }
+    if (tb[IFLA_LINK]) {
+        l->link = *(int *)RTA_DATA(tb[IFLA_LINK]);
+    }
+    l->link_netns = tb[IFLA_LINK_NETNSID] != NULL;
+    if (tb[IFLA_ADDRESS]) {
+        l->mac_len = RTA_PAYLOAD(tb[IFLA_ADDRESS]);
+        if (l->mac_len > (int)sizeof(l->mac)) {
+            l->mac_len = sizeof(l->mac);
+        }
+        memcpy(l->mac, RTA_DATA(tb[IFLA_ADDRESS]), l->mac_len);
+    }
+    if (tb[IFLA_LINKINFO]) {
+        struct rtattr *info[IFLA_INFO_MAX + 1];
+        nl_parse_attrs(info, IFLA_INFO_MAX, RTA_DATA(tb[IFLA_LINKINFO]),
+                       RTA_PAYLOAD(tb[IFLA_LINKINFO]));
+        if (info[IFLA_INFO_KIND]) {
+            snprintf(l->kind, sizeof(l->kind), "%.*s",
+                     (int)RTA_PAYLOAD(info[IFLA_INFO_KIND]), (char *)RTA_DATA(info[IFLA_INFO_KIND]));
+        }
+    }
+    return 0;
+}
+
+static int link_addr_cb(struct nlmsghdr *nh, void *ctx) {
+    link_table_t *t = ctx;
+    if (nh->nlmsg_type != RTM_NEWADDR) {
+        return 0;
+    }
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    if ((ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6) ||
+        (int)ifa->ifa_index >= t->cap || !t->links[ifa->ifa_index].present) {
+        return 0;
+    }
+    struct rtattr *tb[IFA_MAX + 1];
+    nl_parse_attrs(tb, IFA_MAX, IFA_RTA(ifa), IFA_PAYLOAD(nh));
+    // IFA_LOCAL est l'adresse locale (IFA_ADDRESS est le pair en point à point)
+    struct rtattr *a = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+    if (!a) {
+        return 0;
+    }
+
+    // Portée, drapeaux et durées de vie décodés dans le même passage
+    unsigned int flags = tb[IFA_FLAGS] ? *(unsigned int *)RTA_DATA(tb[IFA_FLAGS])
+                                       : ifa->ifa_flags;
+    if ((t->filter.stable_only && !addr_is_stable(ifa->ifa_family, flags)) ||
+        (t->filter.scope >= 0 && ifa->ifa_scope != t->filter.scope)) {
+        return 0;
+    }
+
+    if (t->addr_count == t->addr_cap) {
+        t->addr_cap = t->addr_cap ? t->addr_cap * 2 : 64;
+        t->addrs = realloc(t->addrs, t->addr_cap * sizeof(*t->addrs));
+        if (!t->addrs) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int idx = t->addr_count++;
+    link_addr_t *e = &t->addrs[idx];
+    memset(e, 0, sizeof(*e));
+    e->family    = ifa->ifa_family;
+    e->prefixlen = ifa->ifa_prefixlen;
+    e->scope     = ifa->ifa_scope;
+    e->flags     = flags;
+    e->valid     = INFINITY_LIFE_TIME;
+    e->preferred = INFINITY_LIFE_TIME;
+    if (tb[IFA_CACHEINFO]) {
+        const struct ifa_cacheinfo *ci = RTA_DATA(tb[IFA_CACHEINFO]);
+        e->valid     = ci->ifa_valid;
+        e->preferred = ci->ifa_prefered;
+    }
+    e->next      = -1;
+    memcpy(e->addr, RTA_DATA(a), e->family == AF_INET ? 4 : 16);
+
+    // Jointure : accès direct au lien par son ifindex, ordre du dump conservé
+    link_info_t *l = &t->links[ifa->ifa_index];
+    if (l->addr_tail >= 0) {
+        t->addrs[l->addr_tail].next = idx;
+    } else {
+        l->addr_head = idx;
+    }
+    l->addr_tail = idx;
+    return 0;
+}
+
+static void load_links(link_table_t *t, const addr_filter_t *filter) {
+    memset(t, 0, sizeof(*t));
+    t->filter = *filter;
+    int fd = nl_open(0);
+    if (fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (nl_dump(fd, RTM_GETLINK, AF_UNSPEC, NULL, 0, link_cb, t) < 0 ||
+        nl_dump(fd, RTM_GETADDR, AF_UNSPEC, NULL, 0, link_addr_cb, t) < 0) {
+        perror("rtnetlink");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
+/*
+ * Vitesse et duplex par ethtool, seulement sur demande (-s) et pour le seul
+ * lien 'only' s'il est donné : un seul socket pour tous les ioctl.
+ * ETHTOOL_GLINKSETTINGS d'abord, l'ancien ETHTOOL_GSET pour les pilotes
+ * qui ne le gèrent pas.
+ */
+static void load_link_speeds(link_table_t *t, const char *only) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return;
+    }
+    struct {
+        struct ethtool_link_settings req;
+        __u32 masks[3 * 127]; // link_mode_masks, taille maximale
+    } ecmd;
+
+    for (int i = 0; i < t->cap; i++) {
+        link_info_t *l = &t->links[i];
+        if (!l->present || (l->flags & IFF_LOOPBACK) ||
+            (only && strcmp(only, l->name) != 0)) {
+            continue;
+        }
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", l->name);
+
+        // Poignée de main : le noyau indique le nombre de mots des masques
+        memset(&ecmd, 0, sizeof(ecmd));
+        ecmd.req.cmd = ETHTOOL_GLINKSETTINGS;
+        ifr.ifr_data = (void *)&ecmd;
+        if (ioctl(fd, SIOCETHTOOL, &ifr) == 0 && ecmd.req.link_mode_masks_nwords < 0) {
+            ecmd.req.link_mode_masks_nwords = -ecmd.req.link_mode_masks_nwords;
+            ecmd.req.cmd = ETHTOOL_GLINKSETTINGS;
+            if (ioctl(fd, SIOCETHTOOL, &ifr) == 0) {
+                l->speed  = ecmd.req.speed == (__u32)SPEED_UNKNOWN ? -1 : (int)ecmd.req.speed;
+                l->duplex = ecmd.req.duplex == DUPLEX_UNKNOWN ? -1 : ecmd.req.duplex;
+                continue;
+            }
+        }
+        struct ethtool_cmd legacy;
+        memset(&legacy, 0, sizeof(legacy));
+        legacy.cmd   = ETHTOOL_GSET;
+        ifr.ifr_data = (void *)&legacy;
+        if (ioctl(fd, SIOCETHTOOL, &ifr) == 0) {
+            __u32 speed = ethtool_cmd_speed(&legacy);
+            l->speed  = speed == (__u32)SPEED_UNKNOWN ? -1 : (int)speed;
+            l->duplex = legacy.duplex == DUPLEX_UNKNOWN ? -1 : legacy.duplex;
+        }
+    }
+    close(fd);
+}
+
+/*
+ * 'head' précède la ligne du lien, 'cont' celles de ses adresses
+ * (indentations de la vue arborescente, chaînes vides sinon).
+ */
+static void print_link(const link_table_t *t, int ifindex, int with_speed,
+                       const char *head, const char *cont) {
+    const link_info_t *l = &t->links[ifindex];
+    printf("%s%s:", head, l->name);
+    if (l->kind[0]) {
+        printf(" type %s", l->kind);
+    }
+    printf(" state %s mtu %u",
+           l->operstate < (int)(sizeof(oper_names) / sizeof(oper_names[0])) &&
+           oper_names[l->operstate] ? oper_names[l->operstate] : "?", l->mtu);
+    if (l->mac_len > 0) {
+        printf(" mac ");
+        for (int b = 0; b < l->mac_len; b++) {
+            printf("%s%02x", b ? ":" : "", l->mac[b]);
+        }
+    }
+    if (l->master > 0) {
+        const char *m = l->master < t->cap && t->links[l->master].present
+                        ? t->links[l->master].name : "?";
+        printf(" master %s", m);
+    }
+    if (with_speed) {
+        if (l->speed >= 0) {
+            printf(" speed %dMb/s", l->speed);
+        }
+        if (l->duplex >= 0) {
+            printf(" duplex %s", l->duplex == DUPLEX_FULL ? "full" : "half");
+        }
+    }
+    printf("\n");
+
+    // Adresses au format de -i, indentées sous le lien, puis portée,
+    // drapeaux et durées de vie
+    for (int a = l->addr_head; a >= 0; a = t->addrs[a].next) {
+        const link_addr_t *e = &t->addrs[a];
+        char addr_str[INET6_ADDRSTRLEN];
+        inet_ntop(e->family, e->addr, addr_str, sizeof(addr_str));
+        printf("%s    %s/%d", cont, addr_str, e->prefixlen);
+        if (scope_names[e->scope]) {
+            printf(" scope %s", scope_names[e->scope]);
+        } else {
+            printf(" scope %d", e->scope);
+        }
+        if (e->family == AF_INET6 && (e->flags & IFA_F_TEMPORARY)) {
+            printf(" temporary");
+        } else if (e->family == AF_INET && (e->flags & IFA_F_SECONDARY)) {
+            printf(" secondary");
+        }
+        if (!(e->flags & IFA_F_PERMANENT)) {
+            printf(" dynamic");
+        }
+        for (size_t f = 0; f < sizeof(addr_flag_names) / sizeof(addr_flag_names[0]); f++) {
+            if (e->flags & addr_flag_names[f].flag) {
+                printf(" %s", addr_flag_names[f].name);
+            }
+        }
+        if (e->valid != INFINITY_LIFE_TIME) {
+            printf(" valid %us", e->valid);
+        }
+        if (e->preferred != INFINITY_LIFE_TIME) {
+            printf(" preferred %us", e->preferred);
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * Parent d'un lien dans l'arbre : son maître (bond, bridge), sinon son
+ * lien inférieur (vlan, macvlan...). Le IFLA_LINK d'un veth désigne son
+ * pair, pas un parent, et celui d'un lien d'un autre netns n'a pas de sens
+ * ici : ignorés. 0 = racine.
+ */
+static int link_parent(const link_table_t *t, int ifindex) {
+    const link_info_t *l = &t->links[ifindex];
+    int p = l->master;
+    if (p <= 0 && l->link > 0 && l->link != ifindex && !l->link_netns &&
+        strcmp(l->kind, "veth") != 0) {
+        p = l->link;
+    }
+    return (p > 0 && p < t->cap && t->links[p].present) ? p : 0;
+}
+
+#define TREE_MAX_DEPTH 32
+
+/*
+ * Parcours en profondeur depuis 'root' avec une pile explicite. Un lien
+ * n'est empilé qu'une fois (marque 'seen') : un cycle maître/lien ne peut
+ * pas boucler.
+ */
+static void print_link_subtree(const link_table_t *t, int root, const int *first,
+                               const int *next, int *depth, char *seen,
+                               int *stack, int with_speed)
+{
+    // Pour chaque profondeur : reste-t-il des frères à afficher ?
+    static char more[TREE_MAX_DEPTH + 1];
+    int sp = 0;
+    stack[sp++] = root;
+    seen[root] = 1;
+    depth[root] = 0;
+
+    while (sp > 0) {
+        int i = stack[--sp];
+        int d = depth[i] < TREE_MAX_DEPTH ? depth[i] : TREE_MAX_DEPTH;
+
+        char head[4 * TREE_MAX_DEPTH + 8] = "", cont[4 * TREE_MAX_DEPTH + 8] = "";
+        for (int k = 1; k < d; k++) {
+            strcat(head, more[k] ? "|   " : "    ");
+        }
+        if (d > 0) {
+            more[d] = next[i] != 0;
+            strcpy(cont, head);
+            strcat(head, more[d] ? "|-- " : "`-- ");
+            strcat(cont, more[d] ? "|   " : "    ");
+        }
+        print_link(t, i, with_speed, head, cont);
+
+        // Enfants empilés puis retournés : ils sortent dans l'ordre des ifindex
+        int base = sp;
+        for (int c = first[i]; c; c = next[c]) {
+            if (!seen[c]) {
+                seen[c] = 1;
+                depth[c] = depth[i] + 1;
+                stack[sp++] = c;
+            }
+        }
+        for (int a = base, b = sp - 1; a < b; a++, b--) {
+            int tmp = stack[a];
+            stack[a] = stack[b];
+            stack[b] = tmp;
+        }
+    }
+}
+
+/*
+ * Vue arborescente (-l -tree) : listes d'enfants indexées par ifindex
+ * (premier enfant / frère suivant), construites en un passage : O(n).
+ */
+static void show_link_tree(const link_table_t *t, int with_speed) {
+    int  *first = calloc(t->cap + 1, sizeof(int));
+    int  *next  = calloc(t->cap + 1, sizeof(int));
+    int  *depth = calloc(t->cap + 1, sizeof(int));
+    int  *stack = calloc(t->cap + 1, sizeof(int));
+    char *seen  = calloc(t->cap + 1, 1);
+    if (!first || !next || !depth || !stack || !seen) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // Insertion en tête, ifindex décroissants : enfants triés par ifindex
+    for (int i = t->cap - 1; i > 0; i--) {
+        if (!t->links[i].present) {
+            continue;
+        }
+        int p = link_parent(t, i);
+        if (p) {
+            next[i]  = first[p];
+            first[p] = i;
+        }
+    }
+
+    static char obuf[1 << 20];
+    setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+    for (int i = 1; i < t->cap; i++) {
+        if (t->links[i].present && !link_parent(t, i)) {
+            print_link_subtree(t, i, first, next, depth, seen, stack, with_speed);
+        }
+    }
+    // Restent les liens pris dans un cycle : chacun devient une racine
+    for (int i = 1; i < t->cap; i++) {
+        if (t->links[i].present && !seen[i]) {
+            printf("(cycle) ");
+            print_link_subtree(t, i, first, next, depth, seen, stack, with_speed);
+        }
+    }
+    fflush(stdout);
+
+    free(first);
+    free(next);
+    free(depth);
+    free(stack);
+    free(seen);
+}
+
+static void show_links(const char *ifname_filter, int with_speed, int tree,
+                       const addr_filter_t *filter) {
+    link_table_t t;
+    load_links(&t, filter);
+    if (with_speed) {
+        // L'arbre montre tous les liens ; sinon, seul le lien filtré
+        load_link_speeds(&t, tree ? NULL : ifname_filter);
+    }
+    if (tree) {
+        show_link_tree(&t, with_speed);
+        free(t.links);
+        free(t.addrs);
+        return;
+    }
+    int found = 0;
+    for (int i = 0; i < t.cap; i++) {
+        if (!t.links[i].present ||
+            (ifname_filter && strcmp(ifname_filter, t.links[i].name) != 0)) {
+            continue;
+        }
+        print_link(&t, i, with_speed, "", "");
+        found = 1;
+    }
+    if (ifname_filter && !found) {
+        fprintf(stderr, "Interface %s introuvable\n", ifname_filter);
+        exit(EXIT_FAILURE);
+    }
+    free(t.links);
+    free(t.addrs);
+}
+
+/*
+ * Instantanés binaires (--snapshot) et leur comparaison (--diff).
+ *
+ * Un instantané est un tableau trié d'enregistrements de taille fixe, un
+ * par lien et un par adresse, mis à zéro avant remplissage (octets de
+ * bourrage compris) : deux états identiques donnent deux fichiers
+ * identiques, quel que soit l'ordre du dump. Les liens sont désignés par
+ * leur nom (l'ifindex change d'un redémarrage à l'autre) et la clé de tri
+ * est le début de l'enregistrement : --diff compare par memcmp() et
+ * parcourt les deux tableaux en une seule fusion, O(n).
+ *
+ * Seul l'état durable est conservé : ni durées de vie, ni drapeaux
+ * transitoires (tentative...) des adresses, ni compteurs.
+ */
+#define SNAP_MAGIC "IFSNAP1"  // 8 octets avec le '\0' final
+
+enum { SNAP_LINK = 0, SNAP_ADDR = 1 };
+
+typedef struct {
+    char     magic[8];
+    uint32_t count;
+    uint32_t reserved;
+} snap_hdr_t;
+
+typedef struct {
+    // Clé de tri : nom, type (le lien avant ses adresses), famille, adresse, préfixe
+    char          name[IF_NAMESIZE];
+    unsigned char type;
+    unsigned char family;
+    unsigned char addr[16];
+    unsigned char prefixlen;
+    // Attributs comparés
+    unsigned char scope;      // adresse
+    char          kind[16];   // lien
+    char          master[IF_NAMESIZE];
+    uint32_t      mtu;
+    uint32_t      flags;      // IFF_*
+    uint32_t      operstate;
+    uint32_t      mac_len;
+    unsigned char mac[32];
+} snap_rec_t;
+
+#define SNAP_KEY_LEN (offsetof(snap_rec_t, prefixlen) + 1)
+
+static int snap_cmp(const void *a, const void *b) {
+    return memcmp(a, b, SNAP_KEY_LEN);
+}
+
+static void write_snapshot(const char *path) {
+    link_table_t t;
+    addr_filter_t all = { 0, -1 };
+    load_links(&t, &all);
+
+    size_t count = t.addr_count;
+    for (int i = 0; i < t.cap; i++) {
+        count += t.links[i].present;
+    }
+    snap_rec_t *recs = calloc(count ? count : 1, sizeof(*recs));
+    if (!recs) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < t.cap; i++) {
+        const link_info_t *l = &t.links[i];
+        if (!l->present) {
+            continue;
+        }
+        snap_rec_t *r = &recs[n++];
+        memcpy(r->name, l->name, sizeof(r->name));
+        r->type = SNAP_LINK;
+        memcpy(r->kind, l->kind, sizeof(r->kind));
+        if (l->master > 0 && l->master < t.cap && t.links[l->master].present) {
+            memcpy(r->master, t.links[l->master].name, sizeof(r->master));
+        }
+        r->mtu       = l->mtu;
+        r->flags     = l->flags;
+        r->operstate = l->operstate;
+        r->mac_len   = l->mac_len;
+        memcpy(r->mac, l->mac, l->mac_len);
+
+        for (int a = l->addr_head; a >= 0; a = t.addrs[a].next) {
+            const link_addr_t *e = &t.addrs[a];
+            snap_rec_t *ra = &recs[n++];
+            memcpy(ra->name, l->name, sizeof(ra->name));
+            ra->type      = SNAP_ADDR;
+            ra->family    = e->family;
+            memcpy(ra->addr, e->addr, e->family == AF_INET ? 4 : 16);
+            ra->prefixlen = e->prefixlen;
+            ra->scope     = e->scope;
+        }
+    }
+    free(t.links);
+    free(t.addrs);
+    qsort(recs, n, sizeof(*recs), snap_cmp);
+
+    // Écriture dans un fichier temporaire puis rename() : un lecteur ne
+    // voit jamais d'instantané partiel
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        exit(EXIT_FAILURE);
+    }
+    snap_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+    hdr.count = n;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(recs, sizeof(*recs), n, f) != n ||
+        fclose(f) != 0 || rename(tmp, path) < 0) {
+        perror(path);
+        unlink(tmp);
+        exit(EXIT_FAILURE);
+    }
+    free(recs);
+}
+
+/*
+ * Projette un instantané en mémoire ; quitte avec le code 2 (erreur,
+ * comme diff(1)) s'il est illisible.
+ */
+static const snap_rec_t *map_snapshot(const char *path, size_t *count, size_t *maplen) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        exit(2);
+    }
+    const snap_hdr_t *hdr = NULL;
+    if ((size_t)st.st_size >= sizeof(*hdr)) {
+        hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (!hdr || hdr == MAP_FAILED ||
+        memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) != 0 ||
+        (size_t)st.st_size != sizeof(*hdr) + (size_t)hdr->count * sizeof(snap_rec_t)) {
+        fprintf(stderr, "%s : instantané invalide\n", path);
+        exit(2);
+    }
+    *count  = hdr->count;
+    *maplen = st.st_size;
+    return (const snap_rec_t *)(hdr + 1);
+}
+
+static void print_snap_rec(char sign, const snap_rec_t *r) {
+    if (r->type == SNAP_LINK) {
+        printf("%c lien %.*s%s%.*s\n", sign, IF_NAMESIZE, r->name,
+               r->kind[0] ? " type " : "", (int)sizeof(r->kind), r->kind);
+    } else {
+        char addr_str[INET6_ADDRSTRLEN];
+        inet_ntop(r->family, r->addr, addr_str, sizeof(addr_str));
+        printf("%c %.*s %s/%d\n", sign, IF_NAMESIZE, r->name, addr_str, r->prefixlen);
+    }
+}
+
+static const char *oper_name(uint32_t operstate) {
+    return operstate < sizeof(oper_names) / sizeof(oper_names[0]) && oper_names[operstate]
+           ? oper_names[operstate] : "?";
+}
+
+static void format_mac(const snap_rec_t *r, char *out, size_t outlen) {
+    size_t off = 0;
+    out[0] = '\0';
+    for (uint32_t b = 0; b < r->mac_len && b < sizeof(r->mac) && off + 4 <= outlen; b++) {
+        off += snprintf(out + off, outlen - off, "%s%02x", b ? ":" : "", r->mac[b]);
+    }
+}
+
+// Même clé : compare les attributs, 1 ligne "~" si l'un d'eux a changé
+static int diff_snap_attrs(const snap_rec_t *a, const snap_rec_t *b) {
+    char buf[512];
+    size_t off = 0;
+#define DIFF_APPEND(...) \
+    (off += snprintf(buf + off, off < sizeof(buf) ? sizeof(buf) - off : 0, __VA_ARGS__))
+
+    if (a->type == SNAP_ADDR) {
+        if (a->scope != b->scope) {
+            DIFF_APPEND(" scope %d -> %d", a->scope, b->scope);
+        }
+    } else {
+        if (strncmp(a->kind, b->kind, sizeof(a->kind)) != 0) {
+            DIFF_APPEND(" type %.*s -> %.*s", (int)sizeof(a->kind), a->kind[0] ? a->kind : "-",
+                        (int)sizeof(b->kind), b->kind[0] ? b->kind : "-");
+        }
+        if (a->operstate != b->operstate) {
+            DIFF_APPEND(" state %s -> %s", oper_name(a->operstate), oper_name(b->operstate));
+        }
+        if (a->mtu != b->mtu) {
+            DIFF_APPEND(" mtu %u -> %u", a->mtu, b->mtu);
+        }
+        if (a->flags != b->flags) {
+            DIFF_APPEND(" flags 0x%x -> 0x%x", a->flags, b->flags);
+        }
+        if (a->mac_len != b->mac_len || memcmp(a->mac, b->mac, sizeof(a->mac)) != 0) {
+            char ma[100], mb[100];
+            format_mac(a, ma, sizeof(ma));
+            format_mac(b, mb, sizeof(mb));
+            DIFF_APPEND(" mac %s -> %s", ma[0] ? ma : "-", mb[0] ? mb : "-");
+        }
+        if (strncmp(a->master, b->master, sizeof(a->master)) != 0) {
+            DIFF_APPEND(" master %.*s -> %.*s", IF_NAMESIZE, a->master[0] ? a->master : "-",
+                        IF_NAMESIZE, b->master[0] ? b->master : "-");
+        }
+    }
+#undef DIFF_APPEND
+    if (off == 0) {
+        return 0;
+    }
+    if (a->type == SNAP_LINK) {
+        printf("~ lien %.*s:%s\n", IF_NAMESIZE, a->name, buf);
+    } else {
+        char addr_str[INET6_ADDRSTRLEN];
+        inet_ntop(a->family, a->addr, addr_str, sizeof(addr_str));
+        printf("~ %.*s %s/%d:%s\n", IF_NAMESIZE, a->name, addr_str, a->prefixlen, buf);
+    }
+    return 1;
+}
+
+/*
+ * ifshow --diff A B : "-" retiré de A, "+" ajouté dans B, "~" modifié.
+ * Code de sortie de diff(1) : 0 identiques, 1 différents, 2 erreur.
+ */
+static int diff_snapshots(const char *path_a, const char *path_b) {
+    size_t na, nb, la, lb;
+    const snap_rec_t *a = map_snapshot(path_a, &na, &la);
+    const snap_rec_t *b = map_snapshot(path_b, &nb, &lb);
+
+    static char obuf[1 << 20];
+    setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+
+    int changed = 0;
+    size_t i = 0, j = 0;
+    while (i < na || j < nb) {
+        int c = i == na ? 1 : j == nb ? -1 : snap_cmp(&a[i], &b[j]);
+        if (c < 0) {
+            print_snap_rec('-', &a[i++]);
+            changed = 1;
+        } else if (c > 0) {
+            print_snap_rec('+', &b[j++]);
+            changed = 1;
+        } else {
+            changed |= diff_snap_attrs(&a[i++], &b[j++]);
+        }
+    }
+    fflush(stdout);
+
+    munmap((void *)((const snap_hdr_t *)a - 1), la);
+    munmap((void *)((const snap_hdr_t *)b - 1), lb);
+    return changed;
+}
+
+/*
+ * Compteurs des liens (--record, --top) : un dump RTM_GETSTATS limité à
+ * IFLA_STATS_LINK_64, bien plus léger qu'un dump RTM_GETLINK complet.
+ */
+enum { ST_RX_BYTES, ST_TX_BYTES, ST_RX_PACKETS, ST_TX_PACKETS,
+       ST_RX_ERRORS, ST_TX_ERRORS, ST_RX_DROPPED, ST_TX_DROPPED, STAT_COLS };
+
+static const char *const stat_names[STAT_COLS] = {
+    "rx_bytes", "tx_bytes", "rx_packets", "tx_packets",
+    "rx_errors", "tx_errors", "rx_dropped", "tx_dropped",
+};
+
+typedef struct {
+    int      ifindex;
+    uint64_t c[STAT_COLS];
+} if_stat_t;
+
+typedef struct {
+    if_stat_t *v;      // trié par ifindex
+    int        count;
+    int        cap;
+} stat_set_t;
+
+static int stats_cb(struct nlmsghdr *nh, void *ctx) {
+    stat_set_t *s = ctx;
+    if (nh->nlmsg_type != RTM_NEWSTATS) {
+        return 0;
+    }
+    struct if_stats_msg *m = NLMSG_DATA(nh);
+    struct rtattr *tb[IFLA_STATS_MAX + 1];
+    nl_parse_attrs(tb, IFLA_STATS_MAX,
+                   (struct rtattr *)((char *)m + NLMSG_ALIGN(sizeof(*m))),
+                   nh->nlmsg_len - NLMSG_LENGTH(sizeof(*m)));
+    struct rtattr *a = tb[IFLA_STATS_LINK_64];
+    if (!a || RTA_PAYLOAD(a) < sizeof(struct rtnl_link_stats64)) {
+        return 0;
+    }
+    struct rtnl_link_stats64 st;
+    memcpy(&st, RTA_DATA(a), sizeof(st)); // RTA_DATA n'est aligné que sur 4
+
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->v = realloc(s->v, s->cap * sizeof(*s->v));
+        if (!s->v) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if_stat_t *e = &s->v[s->count++];
+    e->ifindex          = m->ifindex;
+    e->c[ST_RX_BYTES]   = st.rx_bytes;
+    e->c[ST_TX_BYTES]   = st.tx_bytes;
+    e->c[ST_RX_PACKETS] = st.rx_packets;
+    e->c[ST_TX_PACKETS] = st.tx_packets;
+    e->c[ST_RX_ERRORS]  = st.rx_errors;
+    e->c[ST_TX_ERRORS]  = st.tx_errors;
+    e->c[ST_RX_DROPPED] = st.rx_dropped;
+    e->c[ST_TX_DROPPED] = st.tx_dropped;
+    return 0;
+}
+
+static int cmp_stat_ifindex(const void *a, const void *b) {
+    const if_stat_t *x = a, *y = b;
+    return (x->ifindex > y->ifindex) - (x->ifindex < y->ifindex);
+}
+
+static void sample_stats(int fd, stat_set_t *s) {
+    struct if_stats_msg req;
+    memset(&req, 0, sizeof(req));
+    req.family      = AF_UNSPEC;
+    req.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    s->count = 0;
+    if (nl_dump(fd, RTM_GETSTATS, AF_UNSPEC, &req, sizeof(req), stats_cb, s) < 0) {
+        perror("RTM_GETSTATS");
+        exit(EXIT_FAILURE);
+    }
+    // Le dump suit déjà l'ordre des ifindex : tri seulement en cas d'écart
+    for (int i = 1; i < s->count; i++) {
+        if (s->v[i].ifindex < s->v[i - 1].ifindex) {
+            qsort(s->v, s->count, sizeof(*s->v), cmp_stat_ifindex);
+            break;
+        }
+    }
+}
+
+static uint64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
 
 /*
- * Fonction pour calculer le nombre de bits à 1 (pour un masque contigu)
- * dans un buffer binaire. On l'utilise pour compter le préfixe.
+ * Enregistreur de compteurs (--record) : fichier anneau de taille fixe,
+ * projeté en mémoire.
+ *
+ *   en-tête (4 Kio) : magic "IFRING1", taille et nombre des blocs,
+ *                     intervalle, numéro du bloc courant
+ *   blocs           : le bloc numéro n occupe l'emplacement n % nblocks ;
+ *                     une fois l'anneau plein, le plus ancien est écrasé.
+ *
+ * Un bloc commence par une image clé (liste des liens, noms, valeurs
+ * absolues) suivie de trames de deltas : pour chaque lien et chaque
+ * colonne, l'écart au relevé précédent en varint zigzag (1 octet pour un
+ * compteur immobile). Chaque bloc se décode seul : la lecture (--read)
+ * trouve le premier bloc d'un intervalle par dichotomie sur leur heure
+ * de début, sans parcourir le fichier. Un lien qui apparaît ou disparaît
+ * ouvre un nouveau bloc.
  */
-static int count_prefix_len(const unsigned char *buf, size_t buflen) {
-    int prefix_len = 0;
-    for (size_t i = 0; i < buflen; i++) {
-        unsigned char c = buf[i];
-        while (c) {
-            prefix_len += (c & 1);
-            c >>= 1;
+#define RING_MAGIC      "IFRING1"  // 8 octets avec le '\0' final
+#define RING_HDR_SIZE   4096
+#define RING_MIN_BLOCK  65536
+#define VARINT_MAX      10
+
+typedef struct {
+    char     magic[8];
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint32_t interval_ms;
+    uint32_t reserved;
+    uint64_t cur_seq;     // bloc en cours d'écriture, 0 = aucun
+} ring_hdr_t;
+
+typedef struct {
+    uint64_t seq;         // numéro du bloc, 0 = vide ou en réécriture
+    uint64_t t_first_ms;  // heure de l'image clé (ms depuis l'epoch)
+    uint64_t t_last_ms;   // heure de la dernière trame
+    uint32_t nframes;
+    uint32_t used;        // octets écrits, en-tête compris (publié en dernier)
+} ring_blk_t;
+
+// Taille maximale encodée d'un lien dans une image clé / une trame
+#define RING_KEY_MAX   (VARINT_MAX + 1 + IF_NAMESIZE + STAT_COLS * VARINT_MAX)
+#define RING_DELTA_MAX (STAT_COLS * VARINT_MAX)
+
+static size_t put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// NULL si le varint déborde de [p, end)
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end,
+                                       uint64_t *v)
+{
+    uint64_t r = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Deltas signés (compteur remis à zéro) sur peu d'octets
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static ring_blk_t *ring_block(const ring_hdr_t *h, uint64_t seq) {
+    return (ring_blk_t *)((unsigned char *)h + RING_HDR_SIZE +
+                          (seq % h->nblocks) * h->block_size);
+}
+
+typedef struct {
+    ring_hdr_t *hdr;
+    ring_blk_t *blk;      // bloc courant, NULL avant la première image clé
+    stat_set_t  prev;     // dernier relevé écrit : base des deltas
+    uint64_t    prev_ms;
+} ring_writer_t;
+
+static int same_links(const stat_set_t *a, const stat_set_t *b) {
+    if (a->count != b->count) {
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        if (a->v[i].ifindex != b->v[i].ifindex) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Liens qu'une image clé peut contenir dans un bloc de 'block_size' octets
+static int ring_max_links(uint32_t block_size) {
+    return (int)((block_size - sizeof(ring_blk_t) - VARINT_MAX) / RING_KEY_MAX);
+}
+
+// Ouvre le bloc suivant avec une image clé du relevé 's' (ring_max_links au plus)
+static void ring_keyframe(ring_writer_t *w, int nl, const stat_set_t *s, uint64_t ms) {
+    ring_hdr_t *h = w->hdr;
+
+    // Noms des liens : un dump RTM_GETLINK par bloc seulement
+    link_table_t names;
+    memset(&names, 0, sizeof(names));
+    if (nl_dump(nl, RTM_GETLINK, AF_UNSPEC, NULL, 0, link_cb, &names) < 0) {
+        perror("RTM_GETLINK");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t seq = h->cur_seq + 1;
+    ring_blk_t *b = ring_block(h, seq);
+    // Un lecteur qui voit seq == 0 ignore le bloc pendant sa réécriture
+    __atomic_store_n(&b->seq, 0, __ATOMIC_RELEASE);
+    // ... et ce 0 doit être visible avant toute écriture du contenu
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    unsigned char *p = (unsigned char *)(b + 1);
+    p += put_varint(p, s->count);
+    for (int i = 0; i < s->count; i++) {
+        const if_stat_t *e = &s->v[i];
+        const char *name = e->ifindex < names.cap && names.links[e->ifindex].present
+                           ? names.links[e->ifindex].name : "";
+        size_t len = strnlen(name, IF_NAMESIZE - 1);
+        p += put_varint(p, e->ifindex);
+        *p++ = (unsigned char)len;
+        memcpy(p, name, len);
+        p += len;
+        for (int c = 0; c < STAT_COLS; c++) {
+            p += put_varint(p, e->c[c]);
+        }
+    }
+    free(names.links);
+
+    b->t_first_ms = b->t_last_ms = ms;
+    b->nframes    = 1;
+    b->used       = p - (unsigned char *)b;
+    __atomic_store_n(&b->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->cur_seq, seq, __ATOMIC_RELEASE);
+    w->blk = b;
+}
+
+// Trame de deltas de 'prev' à 's' (mêmes liens) ; renvoie sa taille
+static size_t ring_put_frame(unsigned char *p, const stat_set_t *prev, const stat_set_t *s,
+                             uint64_t dt_ms)
+{
+    size_t n = put_varint(p, dt_ms);
+    for (int i = 0; i < s->count; i++) {
+        for (int c = 0; c < STAT_COLS; c++) {
+            n += put_varint(p + n, zigzag((int64_t)(s->v[i].c[c] - prev->v[i].c[c])));
         }
     }
-    return prefix_len;
+    return n;
+}
+
+static void ring_append(ring_writer_t *w, int nl, const stat_set_t *s, uint64_t ms) {
+    ring_blk_t *b = w->blk;
+    size_t need = VARINT_MAX + (size_t)s->count * RING_DELTA_MAX;
+
+    if (!b || !same_links(&w->prev, s) || b->used + need > w->hdr->block_size) {
+        ring_keyframe(w, nl, s, ms);
+    } else {
+        unsigned char *p = (unsigned char *)b + b->used;
+        p += ring_put_frame(p, &w->prev, s, ms - w->prev_ms);
+        b->t_last_ms = ms;
+        b->nframes++;
+        // Trame visible des lecteurs seulement une fois complète
+        __atomic_store_n(&b->used, (uint32_t)(p - (unsigned char *)b), __ATOMIC_RELEASE);
+    }
+
+    if (w->prev.cap < s->count) {
+        w->prev.cap = s->cap;
+        w->prev.v = realloc(w->prev.v, w->prev.cap * sizeof(*w->prev.v));
+        if (!w->prev.v) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(w->prev.v, s->v, s->count * sizeof(*s->v));
+    w->prev.count = s->count;
+    w->prev_ms = ms;
 }
 
 /*
- * Affiche l'adresse (IPv4 ou IPv6) et le préfixe sous la forme d.d.d.d/p
- * ou d:d:d:d:d:d:d:d/p.
+ * Ne garde que les 'max' premiers liens du relevé : un fichier dimensionné
+ * pour moins de liens continue d'enregistrer ceux qui tiennent (un seul
+ * avertissement) au lieu de s'arrêter en cours de route.
  */
-static void print_address_with_prefix(int family, 
-                                      const void *addr, 
-                                      const void *netmask) 
-{
-    char addr_str[INET6_ADDRSTRLEN] = {0};
-    char mask_str[INET6_ADDRSTRLEN] = {0};
-
-    // Convertit l'adresse en chaîne lisible
-    inet_ntop(family, addr, addr_str, sizeof(addr_str));
-
-    // Convertit le masque en chaîne binaire (pour calcul du préfixe)
-    // inet_ntop n'est utile que pour l'affichage, mais nous voulons surtout
-    // son contenu binaire brut (pour count_prefix_len).
-    // On reconvertit netmask sous forme de tableau d'octets pour calculer le /p.
-    
-    if (netmask == NULL) {
-        // Si le masque n'est pas défini pour cette interface, on ne l'affiche pas
-        // (c'est parfois le cas pour des interfaces virtuelles ou sans IP).
-        printf("%s (prefix inconnu)\n", addr_str);
+static void fit_links(stat_set_t *s, int max) {
+    static int warned;
+    if (s->count <= max) {
         return;
     }
+    if (!warned) {
+        fprintf(stderr, "%d liens, blocs prévus pour %d : les suivants ne sont pas "
+                "enregistrés (recréer le fichier)\n", s->count, max);
+        warned = 1;
+    }
+    s->count = max;
+}
 
-    // On compte la taille en bits du préfixe
-    int prefix_len = 0;
+/*
+ * Octets d'une trame de deltas, mesurés sur deux relevés pris à un
+ * intervalle d'écart (au pire, si les liens ont changé entre-temps).
+ */
+static size_t measure_frame(int nl, stat_set_t *s, unsigned int interval_ms) {
+    stat_set_t first = { NULL, 0, 0 };
+    sample_stats(nl, &first);
+    struct timespec pause = { interval_ms / 1000, (long)(interval_ms % 1000) * 1000000 };
+    while (nanosleep(&pause, &pause) < 0 && errno == EINTR && !stop_requested) {
+    }
+    sample_stats(nl, s);
 
-    if (family == AF_INET) {
-        // 4 octets pour IPv4
-        prefix_len = count_prefix_len((const unsigned char *)netmask, 4);
-    } else if (family == AF_INET6) {
-        // 16 octets pour IPv6
-        prefix_len = count_prefix_len((const unsigned char *)netmask, 16);
+    size_t n = VARINT_MAX + (size_t)s->count * RING_DELTA_MAX;
+    if (same_links(&first, s)) {
+        unsigned char *buf = malloc(n);
+        if (!buf) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        n = ring_put_frame(buf, &first, s, interval_ms);
+        free(buf);
     }
+    free(first.v);
+    return n;
+}
 
-    printf("%s/%d\n", addr_str, prefix_len);
+/*
+ * Trames par bloc, image clé comprise, pour des trames de 'frame' octets
+ * (doublés : marge pour les pointes de trafic).
+ */
+static uint64_t frames_per_block(uint32_t block_size, int links, size_t frame) {
+    size_t key = sizeof(ring_blk_t) + VARINT_MAX + (size_t)links * RING_KEY_MAX;
+    return key < block_size ? 1 + (block_size - key) / (2 * frame) : 1;
 }
 
 /*
- * Affiche les adresses IPv4 et IPv6 d'une interface donnée.
+ * ifshow --record fichier [-interval ms] [-retention durée | -size Mio]
+ * Un fichier anneau existant est repris avec sa géométrie ; un fichier
+ * vide ou absent est créé avec des blocs dimensionnés sur le nombre de
+ * liens actuel (le double, pour ceux qui apparaîtront), en nombre assez
+ * grand pour couvrir 'retention_s' à la taille de trame mesurée, ou pour
+ * occuper 'size_mb' Mio si cette taille est imposée (non nulle).
  */
-static void show_interface(const char *ifname_filter) {
-    struct ifaddrs *ifaddr, *ifa;
+static void record_stats(const char *path, unsigned int interval_ms,
+                         uint64_t retention_s, unsigned int size_mb) {
+    int nl = nl_open(0);
+    if (nl < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Sans SA_RESTART : le signal interrompt l'attente
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
 
-    if (getifaddrs(&ifaddr) == -1) {
-        perror("getifaddrs");
+    stat_set_t s = { NULL, 0, 0 };
+    size_t frame = measure_frame(nl, &s, interval_ms);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
         exit(EXIT_FAILURE);
     }
 
-    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-        // On ignore les interfaces sans nom ou sans adresse
-        if (!ifa->ifa_name || !ifa->ifa_addr) {
-            continue;
+    ring_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (st.st_size == 0) {
+        // ~8 trames de deltas pleines par bloc au pire, bien plus en pratique
+        size_t bs = sizeof(ring_blk_t) + VARINT_MAX + (size_t)2 * s.count * RING_KEY_MAX +
+                    8 * (VARINT_MAX + (size_t)s.count * RING_DELTA_MAX);
+        bs = (bs + 4095) & ~(size_t)4095;
+        if (bs < RING_MIN_BLOCK) {
+            bs = RING_MIN_BLOCK;
+        }
+        uint64_t nblocks;
+        if (size_mb) {
+            nblocks = ((uint64_t)size_mb << 20) / bs;
+        } else {
+            // Un bloc de plus : celui en réécriture ne compte pas
+            uint64_t frames = retention_s * 1000 / interval_ms + 1;
+            uint64_t per    = frames_per_block(bs, s.count, frame);
+            nblocks = (frames + per - 1) / per + 1;
+        }
+        if (nblocks < 4) {
+            nblocks = size_mb ? 0 : 4;
         }
+        if (nblocks == 0 || nblocks > UINT32_MAX ||
+            RING_HDR_SIZE + nblocks * bs > ((uint64_t)1 << 40)) {
+            fprintf(stderr, "%s : taille impossible pour %d liens\n", path, s.count);
+            unlink(path);
+            exit(EXIT_FAILURE);
+        }
+        memcpy(hdr.magic, RING_MAGIC, sizeof(hdr.magic));
+        hdr.block_size = bs;
+        hdr.nblocks    = nblocks;
+        if (ftruncate(fd, RING_HDR_SIZE + (off_t)hdr.nblocks * bs) < 0 ||
+            pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+    } else if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+               memcmp(hdr.magic, RING_MAGIC, sizeof(hdr.magic)) != 0 ||
+               hdr.nblocks == 0 || hdr.block_size < RING_MIN_BLOCK ||
+               st.st_size != RING_HDR_SIZE + (off_t)hdr.nblocks * hdr.block_size) {
+        // Jamais d'écrasement d'un fichier qui n'est pas un anneau
+        fprintf(stderr, "%s : n'est pas un fichier d'enregistrement\n", path);
+        exit(EXIT_FAILURE);
+    }
 
-        // Filtrage sur le nom d'interface si ifname_filter != NULL
-        if (ifname_filter && strcmp(ifname_filter, ifa->ifa_name) != 0) {
-            continue;
+    size_t maplen = RING_HDR_SIZE + (size_t)hdr.nblocks * hdr.block_size;
+    ring_writer_t w;
+    memset(&w, 0, sizeof(w));
+    w.hdr = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (w.hdr == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    w.hdr->interval_ms = interval_ms;
+
+    int max_links = ring_max_links(w.hdr->block_size);
+    fit_links(&s, max_links);
+    uint64_t kept = (uint64_t)(w.hdr->nblocks - 1) *
+                    frames_per_block(w.hdr->block_size, s.count, frame) * interval_ms / 1000;
+    fprintf(stderr, "Enregistrement dans %s : %u blocs de %u Kio, toutes les %u ms\n",
+            path, w.hdr->nblocks, w.hdr->block_size >> 10, interval_ms);
+    fprintf(stderr, "Rétention effective : ~%lluh%02llu (trames de %zu octets, %d liens)\n",
+            (unsigned long long)(kept / 3600), (unsigned long long)(kept % 3600 / 60),
+            frame, s.count);
+
+    // Échéances absolues : pas de dérive, quelle que soit la durée d'un relevé
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop_requested) {
+        ring_append(&w, nl, &s, wall_ms());
+
+        next.tv_sec  += interval_ms / 1000;
+        next.tv_nsec += (long)(interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (!stop_requested &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+        if (!stop_requested) {
+            sample_stats(nl, &s);
+            fit_links(&s, max_links);
         }
+    }
+
+    msync(w.hdr, maplen, MS_SYNC);
+    munmap(w.hdr, maplen);
+    free(w.prev.v);
+    free(s.v);
+    close(nl);
+}
+
+/*
+ * Décode une copie du bloc et affiche les relevés de [from_ms, to_ms].
+ * Renvoie -1 si le bloc est corrompu.
+ */
+static int print_ring_block(const ring_blk_t *b, int64_t from_ms, int64_t to_ms,
+                            const char *ifname)
+{
+    const unsigned char *p = (const unsigned char *)(b + 1);
+    const unsigned char *end = (const unsigned char *)b + b->used;
+    uint64_t count;
+    if (!(p = get_varint(p, end, &count)) || count > b->used) {
+        return -1;
+    }
 
-        int family = ifa->ifa_addr->sa_family;
-        if (family == AF_INET || family == AF_INET6) {
-            // On récupère l'adresse
-            void *addr_ptr = NULL;
-            void *mask_ptr = NULL;
+    struct ring_col {
+        char     name[IF_NAMESIZE];
+        int      shown;
+        uint64_t c[STAT_COLS];
+    } *cols = calloc(count ? count : 1, sizeof(*cols));
+    if (!cols) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int rc = 0;
+    for (uint64_t i = 0; i < count && rc == 0; i++) {
+        uint64_t ifindex;
+        if (!(p = get_varint(p, end, &ifindex)) || p >= end || *p >= IF_NAMESIZE ||
+            end - p < 1 + *p) {
+            rc = -1;
+            break;
+        }
+        size_t len = *p++;
+        memcpy(cols[i].name, p, len);
+        p += len;
+        cols[i].shown = !ifname || strcmp(ifname, cols[i].name) == 0;
+        for (int c = 0; c < STAT_COLS && rc == 0; c++) {
+            if (!(p = get_varint(p, end, &cols[i].c[c]))) {
+                rc = -1;
+            }
+        }
+    }
 
-            if (family == AF_INET) {
-                struct sockaddr_in *sin = (struct sockaddr_in*)ifa->ifa_addr;
-                struct sockaddr_in *msk = (struct sockaddr_in*)ifa->ifa_netmask;
-                addr_ptr = &(sin->sin_addr);
-                if (msk) {
-                    mask_ptr = &(msk->sin_addr);
+    int64_t t = b->t_first_ms;
+    while (rc == 0 && t <= to_ms) {
+        if (t >= from_ms) {
+            time_t sec = t / 1000;
+            struct tm tm;
+            char when[32];
+            localtime_r(&sec, &tm);
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+            for (uint64_t i = 0; i < count; i++) {
+                if (!cols[i].shown) {
+                    continue;
+                }
+                printf("%s.%03d %s", when, (int)(t % 1000), cols[i].name);
+                for (int c = 0; c < STAT_COLS; c++) {
+                    printf(" %llu", (unsigned long long)cols[i].c[c]);
                 }
-            } else { // AF_INET6
-                struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)ifa->ifa_addr;
-                struct sockaddr_in6 *msk6 = (struct sockaddr_in6*)ifa->ifa_netmask;
-                addr_ptr = &(sin6->sin6_addr);
-                if (msk6) {
-                    mask_ptr = &(msk6->sin6_addr);
+                printf("\n");
+            }
+        }
+        if (p == end) {
+            break;
+        }
+        // Trame suivante
+        uint64_t dt, d;
+        if (!(p = get_varint(p, end, &dt))) {
+            rc = -1;
+            break;
+        }
+        t += dt;
+        for (uint64_t i = 0; i < count && rc == 0; i++) {
+            for (int c = 0; c < STAT_COLS; c++) {
+                if (!(p = get_varint(p, end, &d))) {
+                    rc = -1;
+                    break;
                 }
+                cols[i].c[c] += (uint64_t)unzigzag(d);
             }
+        }
+    }
+    free(cols);
+    return rc;
+}
 
-            // Affichage
-            // Si ifname_filter est défini, on n'affiche pas le nom de l'interface
-            // à chaque adresse. Sinon, on indique l'interface.
-            if (ifname_filter) {
-                // On n'affiche pas le nom (car on sait déjà sur quelle interface on est)
-                print_address_with_prefix(family, addr_ptr, mask_ptr);
-            } else {
-                // On affiche le nom de l'interface, puis l'adresse
-                printf("%s: ", ifa->ifa_name);
-                print_address_with_prefix(family, addr_ptr, mask_ptr);
+/*
+ * ifshow --read fichier [-from t] [-to t] [ifname]
+ * Lecture possible pendant l'enregistrement : chaque bloc est copié puis
+ * son numéro revérifié, un bloc écrasé entre-temps est ignoré.
+ */
+static void read_stats(const char *path, int64_t from_ms, int64_t to_ms, const char *ifname) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    const ring_hdr_t *h = NULL;
+    if (st.st_size >= RING_HDR_SIZE) {
+        h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (!h || h == MAP_FAILED || memcmp(h->magic, RING_MAGIC, sizeof(h->magic)) != 0 ||
+        h->nblocks == 0 || h->block_size < RING_MIN_BLOCK ||
+        st.st_size != RING_HDR_SIZE + (off_t)h->nblocks * h->block_size) {
+        fprintf(stderr, "%s : n'est pas un fichier d'enregistrement\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t cur = __atomic_load_n(&h->cur_seq, __ATOMIC_ACQUIRE);
+    if (cur == 0) {
+        return;
+    }
+    uint64_t oldest = cur >= h->nblocks ? cur - h->nblocks + 1 : 1;
+
+    // Dichotomie : dernier bloc commencé avant 'from' (un bloc en cours de
+    // réécriture compte comme le plus ancien)
+    uint64_t start = oldest, lo = oldest, hi = cur;
+    while (lo <= hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const ring_blk_t *b = ring_block(h, mid);
+        uint64_t t = __atomic_load_n(&b->seq, __ATOMIC_ACQUIRE) == mid ? b->t_first_ms : 0;
+        if ((int64_t)t <= from_ms) {
+            start = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    static char obuf[1 << 20];
+    setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+    printf("# heure lien");
+    for (int c = 0; c < STAT_COLS; c++) {
+        printf(" %s", stat_names[c]);
+    }
+    printf("\n");
+
+    ring_blk_t *copy = malloc(h->block_size);
+    if (!copy) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (uint64_t seq = start; seq <= cur; seq++) {
+        const ring_blk_t *b = ring_block(h, seq);
+        if (__atomic_load_n(&b->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+        }
+        uint32_t used = __atomic_load_n(&b->used, __ATOMIC_ACQUIRE);
+        if (used < sizeof(*b) || used > h->block_size) {
+            continue;
+        }
+        memcpy(copy, b, used);
+        copy->used = used;
+        // La copie est lue avant la revérification du numéro
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&b->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue; // écrasé pendant la copie
+        }
+        if ((int64_t)copy->t_first_ms > to_ms) {
+            break;
+        }
+        if (print_ring_block(copy, from_ms, to_ms, ifname) < 0) {
+            fprintf(stderr, "%s : bloc %llu corrompu\n", path, (unsigned long long)seq);
+        }
+    }
+    fflush(stdout);
+    free(copy);
+    munmap((void *)h, st.st_size);
+}
+
+// Durée pour -retention : secondes, ou nombre suivi de s, m, h ou d ; -1 si invalide
+static int64_t parse_duration(const char *arg) {
+    char *end;
+    long long v = strtoll(arg, &end, 10);
+    if (end == arg || v <= 0) {
+        return -1;
+    }
+    int64_t unit = 1;
+    switch (*end) {
+    case '\0': case 's': break;
+    case 'm': unit = 60; break;
+    case 'h': unit = 3600; break;
+    case 'd': unit = 86400; break;
+    default: return -1;
+    }
+    if (*end && end[1]) {
+        return -1;
+    }
+    return v > INT64_MAX / unit ? -1 : v * unit;
+}
+
+/*
+ * Instant pour -from / -to : secondes depuis l'epoch, "-N" (N secondes
+ * avant maintenant) ou "AAAA-MM-JJ HH:MM:SS" (heure locale).
+ */
+static int64_t parse_when(const char *arg) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(arg, "%Y-%m-%d %H:%M:%S", &tm);
+    if (!end || *end) {
+        memset(&tm, 0, sizeof(tm));
+        end = strptime(arg, "%Y-%m-%dT%H:%M:%S", &tm);
+    }
+    if (end && !*end) {
+        tm.tm_isdst = -1;
+        return (int64_t)mktime(&tm) * 1000;
+    }
+    char *e;
+    long long v = strtoll(arg, &e, 10);
+    if (!*arg || *e) {
+        return INT64_MIN;
+    }
+    return v < 0 ? (int64_t)wall_ms() + v * 1000 : v * 1000;
+}
+
+/*
+ * Vue en direct (--top) : débits par lien, triés, rafraîchis à chaque
+ * intervalle. Les deux relevés successifs sont triés par ifindex et joints
+ * en un passage ; seuls les K premiers sont sélectionnés (quickselect,
+ * O(n)) puis triés. Sur un terminal, seules les cellules modifiées depuis
+ * l'affichage précédent sont réécrites.
+ */
+#define TOP_CELL_W 16
+#define TOP_COLS   5  // lien, rx bit/s, tx bit/s, rx paquets/s, tx paquets/s
+
+typedef struct {
+    double key;      // critère de tri
+    int    ifindex;
+    double rate[4];  // rx bit/s, tx bit/s, rx paquets/s, tx paquets/s
+} top_row_t;
+
+static volatile sig_atomic_t top_resized = 1;
+
+static void on_winch(int sig) {
+    (void)sig;
+    top_resized = 1;
+}
+
+// Ordre total : débit décroissant, puis ifindex (sélection stable d'un
+// rafraîchissement à l'autre entre liens à égalité)
+static int top_before(const top_row_t *a, const top_row_t *b) {
+    return a->key > b->key || (a->key == b->key && a->ifindex < b->ifindex);
+}
+
+// Réordonne v pour que ses k premiers éléments soient les k premiers
+// dans l'ordre top_before()
+static void top_select(top_row_t *v, int n, int k) {
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        // Pivot médian de trois
+        const top_row_t *a = &v[lo], *b = &v[lo + (hi - lo) / 2], *c = &v[hi];
+        top_row_t pivot = top_before(a, b) ? (top_before(b, c) ? *b : (top_before(a, c) ? *c : *a))
+                                           : (top_before(a, c) ? *a : (top_before(b, c) ? *c : *b));
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (top_before(&v[i], &pivot)) {
+                i++;
+            }
+            while (top_before(&pivot, &v[j])) {
+                j--;
             }
+            if (i <= j) {
+                top_row_t tmp = v[i];
+                v[i++] = v[j];
+                v[j--] = tmp;
+            }
+        }
+        if (k - 1 <= j) {
+            hi = j;
+        } else if (k - 1 >= i) {
+            lo = i;
+        } else {
+            break;
         }
     }
+}
+
+static int cmp_top_desc(const void *a, const void *b) {
+    return top_before(a, b) ? -1 : top_before(b, a);
+}
 
-    freeifaddrs(ifaddr);
+// 1234567 -> "1.23M"
+static void human_rate(double v, char *out, size_t outlen) {
+    static const char units[] = " kMGTP";
+    int u = 0;
+    while (v >= 1000 && u < (int)sizeof(units) - 2) {
+        v /= 1000;
+        u++;
+    }
+    if (u == 0) {
+        snprintf(out, outlen, "%.0f", v);
+    } else {
+        snprintf(out, outlen, "%.*f%c", v < 10 ? 2 : v < 100 ? 1 : 0, v, units[u]);
+    }
 }
 
 /*
- * Affiche la liste de *toutes* les interfaces réseau (noms) avec leur(s) 
- * adresse(s) + préfixes.
+ * ifshow --top [-interval ms] [-n K] [-sort bps|pps]
+ * Hors terminal (sortie redirigée), chaque tableau est écrit en entier.
  */
-static void show_all_interfaces() {
-    // On appelle show_interface() sans filtre pour toutes les interfaces
-    show_interface(NULL);
+static void show_top(unsigned int interval_ms, int top_n, int sort_pps) {
+    int nl = nl_open(0);
+    if (nl < 0) {
+        exit(EXIT_FAILURE);
+    }
+    int tty = isatty(STDOUT_FILENO);
+
+    stat_set_t cur = { NULL, 0, 0 }, prev = { NULL, 0, 0 };
+    top_row_t *rows = NULL;
+    int rows_cap = 0;
+
+    // Écran précédent : une cellule par (ligne, colonne) ; "" = à redessiner
+    char (*screen)[TOP_COLS][TOP_CELL_W + 1] = NULL;
+    int screen_rows = 0;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = on_winch;
+    sigaction(SIGWINCH, &sa, NULL);
+
+    static char obuf[1 << 20];
+    setvbuf(stdout, obuf, _IOFBF, sizeof(obuf));
+    if (tty) {
+        printf("\033[?25l"); // curseur masqué
+    }
+
+    struct timespec prev_ts, now_ts, next;
+    sample_stats(nl, &prev);
+    clock_gettime(CLOCK_MONOTONIC, &prev_ts);
+    next = prev_ts;
+
+    while (!stop_requested) {
+        next.tv_sec  += interval_ms / 1000;
+        next.tv_nsec += (long)(interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (!stop_requested &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+        if (stop_requested) {
+            break;
+        }
+        sample_stats(nl, &cur);
+        clock_gettime(CLOCK_MONOTONIC, &now_ts);
+        double dt = (now_ts.tv_sec - prev_ts.tv_sec) +
+                    (now_ts.tv_nsec - prev_ts.tv_nsec) / 1e9;
+
+        // Jointure des deux relevés triés par ifindex
+        if (rows_cap < cur.count) {
+            rows_cap = cur.cap;
+            rows = realloc(rows, rows_cap * sizeof(*rows));
+            if (!rows) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+        int n = 0;
+        for (int i = 0, j = 0; i < cur.count; i++) {
+            while (j < prev.count && prev.v[j].ifindex < cur.v[i].ifindex) {
+                j++;
+            }
+            const uint64_t *c = cur.v[i].c;
+            const uint64_t *p = j < prev.count && prev.v[j].ifindex == cur.v[i].ifindex
+                                ? prev.v[j].c : c;
+            top_row_t *r = &rows[n++];
+            r->ifindex = cur.v[i].ifindex;
+            // Compteur revenu en arrière (lien recréé) : débit nul
+            r->rate[0] = c[ST_RX_BYTES] >= p[ST_RX_BYTES] ? (c[ST_RX_BYTES] - p[ST_RX_BYTES]) * 8 / dt : 0;
+            r->rate[1] = c[ST_TX_BYTES] >= p[ST_TX_BYTES] ? (c[ST_TX_BYTES] - p[ST_TX_BYTES]) * 8 / dt : 0;
+            r->rate[2] = c[ST_RX_PACKETS] >= p[ST_RX_PACKETS] ? (c[ST_RX_PACKETS] - p[ST_RX_PACKETS]) / dt : 0;
+            r->rate[3] = c[ST_TX_PACKETS] >= p[ST_TX_PACKETS] ? (c[ST_TX_PACKETS] - p[ST_TX_PACKETS]) / dt : 0;
+            r->key = sort_pps ? r->rate[2] + r->rate[3] : r->rate[0] + r->rate[1];
+        }
+        stat_set_t tmp = prev;
+        prev = cur;
+        cur = tmp;
+        prev_ts = now_ts;
+
+        // Nombre de lignes affichées : -n, sinon la hauteur du terminal
+        int k = top_n;
+        if (k <= 0) {
+            struct winsize ws;
+            k = tty && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 3
+                ? ws.ws_row - 3 : 20;
+        }
+        if (k > n) {
+            k = n;
+        }
+        if (k > 0 && k < n) {
+            top_select(rows, n, k);
+        }
+        qsort(rows, k, sizeof(*rows), cmp_top_desc);
+
+        if (!tty) {
+            printf("%d liens, tri %s\n", n, sort_pps ? "pps" : "bps");
+            for (int i = 0; i < k; i++) {
+                char cell[4][TOP_CELL_W + 1];
+                for (int c = 0; c < 4; c++) {
+                    human_rate(rows[i].rate[c], cell[c], sizeof(cell[c]));
+                }
+                printf("%-16s %10s %10s %10s %10s\n", cached_ifname(rows[i].ifindex),
+                       cell[0], cell[1], cell[2], cell[3]);
+            }
+            printf("\n");
+            fflush(stdout);
+            continue;
+        }
+
+        // Terminal redimensionné : tout est redessiné
+        if (top_resized || screen_rows < k) {
+            top_resized = 0;
+            free(screen);
+            screen_rows = k + 64;
+            screen = calloc(screen_rows, sizeof(*screen));
+            if (!screen) {
+                perror("calloc");
+                exit(EXIT_FAILURE);
+            }
+            printf("\033[H\033[2J%-16s %10s %10s %10s %10s\n", "lien",
+                   "rx bit/s", "tx bit/s", "rx pq/s", "tx pq/s");
+        }
+        printf("\033[2;1H%d liens, intervalle %u ms, tri %s\033[K",
+               n, interval_ms, sort_pps ? "pps" : "bps");
+
+        // Cellules modifiées seulement (ligne 3 = premier lien)
+        static const int col_x[TOP_COLS]  = { 1, 18, 29, 40, 51 };
+        static const int col_w[TOP_COLS]  = { -16, 10, 10, 10, 10 };
+        for (int i = 0; i < screen_rows; i++) {
+            for (int c = 0; c < TOP_COLS; c++) {
+                char cell[TOP_CELL_W + 1] = "";
+                if (i < k && c == 0) {
+                    snprintf(cell, sizeof(cell), "%s", cached_ifname(rows[i].ifindex));
+                } else if (i < k) {
+                    human_rate(rows[i].rate[c - 1], cell, sizeof(cell));
+                } else if (!screen[i][c][0]) {
+                    continue; // déjà vide
+                }
+                if (i < k && strcmp(cell, screen[i][c]) == 0) {
+                    continue;
+                }
+                printf("\033[%d;%dH%*s", i + 3, col_x[c], col_w[c], cell);
+                memcpy(screen[i][c], cell, sizeof(cell));
+            }
+        }
+        fflush(stdout);
+    }
+
+    if (tty) {
+        printf("\033[?25h\n");
+        fflush(stdout);
+    }
+    free(screen);
+    free(rows);
+    free(cur.v);
+    free(prev.v);
+    close(nl);
 }
 
 /*
@@ -140,6 +2023,23 @@ static void usage(const char *progname) {
     fprintf(stderr, "Usage:\n");
     fprintf(stderr, "  %s -a              # Affiche toutes les interfaces + adresses/prefixes\n", progname);
     fprintf(stderr, "  %s -i <ifname>     # Affiche les adresses/prefixes de l'interface <ifname>\n", progname);
+    fprintf(stderr, "        [-format text|json|bin]  # -a / -i : format de sortie\n");
+    fprintf(stderr, "  %s -l [-s] [ifname] # Liens : état, MTU, MAC, maître (+ vitesse avec -s)\n", progname);
+    fprintf(stderr, "  %s -l -tree [-s]   # Idem, en arbre maître / lien inférieur\n", progname);
+    fprintf(stderr, "        [--stable-only] [-scope global|link|host|site|N]\n");
+    fprintf(stderr, "                     # -l : adresses stables seulement / d'une portée\n");
+    fprintf(stderr, "  %s -r [-t table|all] [-p proto] [-f prefix/len]\n", progname);
+    fprintf(stderr, "                     # Table de routage (main par défaut), filtrée\n");
+    fprintf(stderr, "  %s --snapshot <f>  # Instantané binaire trié des liens et adresses\n", progname);
+    fprintf(stderr, "  %s --diff <A> <B>  # Différences entre deux instantanés (+ ajouté, - retiré, ~ modifié)\n", progname);
+    fprintf(stderr, "  %s --record <f> [-interval ms] [-retention 24h|90m|7d|s | -size Mio]\n", progname);
+    fprintf(stderr, "                     # Compteurs des liens dans un fichier anneau (1 s, 24 h)\n");
+    fprintf(stderr, "  %s --read <f> [-from t] [-to t] [ifname]\n", progname);
+    fprintf(stderr, "                     # Relevés enregistrés entre deux instants (epoch, -N s, date)\n");
+    fprintf(stderr, "  %s --top [-interval ms] [-n K] [-sort bps|pps]\n", progname);
+    fprintf(stderr, "                     # Débits par lien en direct, les K plus chargés\n");
+    fprintf(stderr, "  %s --owner <ip>... # Interface qui possède ou dessert <ip>\n", progname);
+    fprintf(stderr, "  %s --owner -       # Idem, une adresse par ligne sur l'entrée standard\n", progname);
     exit(EXIT_FAILURE);
 }
 
@@ -149,16 +2049,185 @@ int main(int argc, char *argv[]) {
     }
 
     // Gestion des arguments
-    if (strcmp(argv[1], "-a") == 0) {
-        // ifshow -a
-        show_all_interfaces();
+    if (strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "-i") == 0) {
+        // ifshow -a [-format f] | ifshow -i ifname [-format f]
+        int first = strcmp(argv[1], "-i") == 0 ? 3 : 2;
+        if (argc < first) {
+            usage(argv[0]);
+        }
+        ifsnap_render_fn render = ifsnap_render_text;
+        if (argc == first + 2 && strcmp(argv[first], "-format") == 0) {
+            render = ifsnap_renderer(argv[first + 1]);
+        } else if (argc != first) {
+            render = NULL;
+        }
+        if (!render) {
+            usage(argv[0]);
+        }
+        show_interface(first == 3 ? argv[2] : NULL, render);
+    }
+    else if (strcmp(argv[1], "-l") == 0) {
+        // ifshow -l [-s] [--stable-only] [-scope s] [-tree | ifname]
+        int with_speed = 0, tree = 0;
+        addr_filter_t filter = { 0, -1 };
+        const char *ifname = NULL;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-s") == 0) {
+                with_speed = 1;
+            } else if (strcmp(argv[i], "-tree") == 0) {
+                tree = 1;
+            } else if (strcmp(argv[i], "--stable-only") == 0) {
+                filter.stable_only = 1;
+            } else if (strcmp(argv[i], "-scope") == 0) {
+                if (i + 1 >= argc ||
+                    (filter.scope = parse_route_name(scope_names, argv[++i])) < -1 ||
+                    filter.scope > 255) {
+                    usage(argv[0]);
+                }
+            } else if (!ifname) {
+                ifname = argv[i];
+            } else {
+                usage(argv[0]);
+            }
+        }
+        if (tree && ifname) {
+            usage(argv[0]);
+        }
+        show_links(ifname, with_speed, tree, &filter);
+    }
+    else if (strcmp(argv[1], "-r") == 0) {
+        // ifshow -r [-t table] [-p proto] [-f prefix/len]
+        route_filter_t f = { RT_TABLE_MAIN, -1, AF_UNSPEC, {0}, -1 };
+        for (int i = 2; i < argc; i++) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            if (strcmp(argv[i], "-t") == 0) {
+                f.table = parse_route_name(route_tables, argv[++i]);
+            } else if (strcmp(argv[i], "-p") == 0) {
+                f.protocol = parse_route_name(route_protocols, argv[++i]);
+            } else if (strcmp(argv[i], "-f") == 0) {
+                char pfx[INET6_ADDRSTRLEN + 4];
+                snprintf(pfx, sizeof(pfx), "%s", argv[++i]);
+                char *slash = strchr(pfx, '/');
+                if (slash) {
+                    *slash = '\0';
+                }
+                f.family = strchr(pfx, ':') ? AF_INET6 : AF_INET;
+                if (inet_pton(f.family, pfx, f.prefix) != 1) {
+                    usage(argv[0]);
+                }
+                f.prefixlen = slash ? atoi(slash + 1) : (f.family == AF_INET ? 32 : 128);
+                if (f.prefixlen < 0 || f.prefixlen > (f.family == AF_INET ? 32 : 128)) {
+                    usage(argv[0]);
+                }
+            } else {
+                usage(argv[0]);
+            }
+            if (f.table == -2 || f.protocol == -2 || f.protocol > 255) {
+                usage(argv[0]);
+            }
+        }
+        show_routes(&f);
+    }
+    else if (strcmp(argv[1], "--snapshot") == 0) {
+        // ifshow --snapshot fichier
+        if (argc != 3) {
+            usage(argv[0]);
+        }
+        write_snapshot(argv[2]);
+    }
+    else if (strcmp(argv[1], "--diff") == 0) {
+        // ifshow --diff A B
+        if (argc != 4) {
+            usage(argv[0]);
+        }
+        return diff_snapshots(argv[2], argv[3]);
+    }
+    else if (strcmp(argv[1], "--record") == 0) {
+        // ifshow --record fichier [-interval ms] [-retention durée | -size Mio]
+        if (argc < 3) {
+            usage(argv[0]);
+        }
+        long interval = 1000, size = 0;
+        int64_t retention = 24 * 3600;
+        for (int i = 3; i < argc; i += 2) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            if (strcmp(argv[i], "-interval") == 0) {
+                interval = atol(argv[i + 1]);
+            } else if (strcmp(argv[i], "-size") == 0) {
+                size = atol(argv[i + 1]);
+                if (size <= 0) {
+                    usage(argv[0]);
+                }
+            } else if (strcmp(argv[i], "-retention") == 0) {
+                retention = parse_duration(argv[i + 1]);
+            } else {
+                usage(argv[0]);
+            }
+        }
+        if (interval <= 0 || size < 0 || size > 1 << 20 || retention <= 0) {
+            usage(argv[0]);
+        }
+        record_stats(argv[2], interval, (uint64_t)retention, size);
+    }
+    else if (strcmp(argv[1], "--read") == 0) {
+        // ifshow --read fichier [-from t] [-to t] [ifname]
+        if (argc < 3) {
+            usage(argv[0]);
+        }
+        int64_t from = INT64_MIN, to = INT64_MAX;
+        const char *ifname = NULL;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-from") == 0 && i + 1 < argc) {
+                if ((from = parse_when(argv[++i])) == INT64_MIN) {
+                    usage(argv[0]);
+                }
+            } else if (strcmp(argv[i], "-to") == 0 && i + 1 < argc) {
+                if ((to = parse_when(argv[++i])) == INT64_MIN) {
+                    usage(argv[0]);
+                }
+            } else if (!ifname && argv[i][0] != '-') {
+                ifname = argv[i];
+            } else {
+                usage(argv[0]);
+            }
+        }
+        read_stats(argv[2], from, to, ifname);
+    }
+    else if (strcmp(argv[1], "--top") == 0) {
+        // ifshow --top [-interval ms] [-n K] [-sort bps|pps]
+        long interval = 1000, top_n = 0;
+        int sort_pps = 0;
+        for (int i = 2; i < argc; i += 2) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            if (strcmp(argv[i], "-interval") == 0) {
+                interval = atol(argv[i + 1]);
+            } else if (strcmp(argv[i], "-n") == 0) {
+                top_n = atol(argv[i + 1]);
+            } else if (strcmp(argv[i], "-sort") == 0 && strcmp(argv[i + 1], "bps") == 0) {
+                sort_pps = 0;
+            } else if (strcmp(argv[i], "-sort") == 0 && strcmp(argv[i + 1], "pps") == 0) {
+                sort_pps = 1;
+            } else {
+                usage(argv[0]);
+            }
+        }
+        if (interval <= 0 || top_n < 0 || top_n > 1 << 20) {
+            usage(argv[0]);
+        }
+        show_top(interval, top_n, sort_pps);
     }
-    else if (strcmp(argv[1], "-i") == 0) {
-        // ifshow -i ifname
+    else if (strcmp(argv[1], "--owner") == 0) {
+        // ifshow --owner ip [ip...] | ifshow --owner -
         if (argc < 3) {
             usage(argv[0]);
         }
-        show_interface(argv[2]);
+        show_owner(argv + 2, argc - 2);
     }
     else {
         usage(argv[0]);
@@ -0,0 +1,90 @@
+/****************************************************
+ * busypoll.h
+ *
+ * Mode faible latence (busy polling), partagé par
+ * ifnetshowserv.c, neighbourshowagent.c et netlatbench.c
+ * (simple inclusion).
+ *
+ * Au lieu d'attendre l'interruption de la carte puis le
+ * réveil du thread, le thread qui attend des données
+ * interroge lui-même la file NAPI de la carte pendant au
+ * plus 'usec' microsecondes :
+ *  - busy_poll_socket() : SO_BUSY_POLL (read / recvfrom
+ *    bloquants), SO_PREFER_BUSY_POLL et SO_BUSY_POLL_BUDGET ;
+ *  - busy_poll_epoll() : même chose pour epoll_wait()
+ *    (EPIOCSPARAMS, Linux >= 6.9).
+ *
+ * Dépasser net.core.busy_read / busy_poll demande
+ * CAP_NET_ADMIN. SO_PREFER_BUSY_POLL n'a d'effet que si les
+ * interruptions sont différées sur l'interface :
+ *    echo 2 > /sys/class/net/eth0/napi_defer_hard_irqs
+ *    echo 200000 > /sys/class/net/eth0/gro_flush_timeout
+ * Sans file NAPI (loopback), l'attente reste classique.
+ * Le prix : un cœur occupé à 100 % pendant les attentes.
+ ****************************************************/
+
+#ifndef BUSYPOLL_H
+#define BUSYPOLL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+// Paquets traités par passe d'interrogation (NAPI_POLL_WEIGHT)
+#define BUSY_POLL_BUDGET 64
+
+// linux/eventpoll.h (6.9), absent des anciens en-têtes
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t  prefer_busy_poll;
+    uint8_t  __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+/*
+ * Busy polling des lectures bloquantes de 'fd' pendant 'usec' µs.
+ * Renvoie 0 si SO_BUSY_POLL est accepté (les options annexes sont
+ * facultatives), -1 sinon (message affiché).
+ */
+static inline int busy_poll_socket(int fd, int usec)
+{
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        perror("setsockopt(SO_BUSY_POLL)");
+        return -1;
+    }
+    int one = 1, budget = BUSY_POLL_BUDGET;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &budget, sizeof(budget));
+    return 0;
+}
+
+// Busy polling de epoll_wait() sur 'epfd' ; 0 si OK, -1 sinon (message affiché)
+static inline int busy_poll_epoll(int epfd, int usec)
+{
+    struct epoll_params params = {
+        .busy_poll_usecs  = (uint32_t)usec,
+        .busy_poll_budget = BUSY_POLL_BUDGET,
+        .prefer_busy_poll = 1,
+    };
+    if (ioctl(epfd, EPIOCSPARAMS, &params) < 0) {
+        perror("ioctl(EPIOCSPARAMS)");
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* BUSYPOLL_H */
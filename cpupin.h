@@ -0,0 +1,198 @@
+/****************************************************
+ * cpupin.h
+ *
+ * Placement des workers sur les cœurs, partagé par
+ * ifnetshowserv.c et neighbourshowagent.c (simple inclusion,
+ * compiler avec -pthread, _GNU_SOURCE défini avant toute
+ * inclusion).
+ *
+ * Liste de cœurs ("-cpus") :
+ *    "0-3,8,10-11" ou "auto" (cœurs autorisés au processus)
+ *
+ * Sur une machine à plusieurs sockets :
+ *  - chaque worker est fixé sur un cœur (cpu_pin_self) puis
+ *    alloue et touche lui-même ses buffers : le noyau place
+ *    les pages sur le nœud NUMA de ce cœur (first-touch), sans
+ *    libnuma ;
+ *  - chaque worker a son propre socket dans un groupe
+ *    SO_REUSEPORT, marqué SO_INCOMING_CPU avec son cœur ; un
+ *    programme cBPF attaché au groupe (reuseport_steer) choisit
+ *    le socket du worker fixé sur le cœur qui a traité la
+ *    réception. Avec des interruptions de files RX réparties
+ *    sur ces cœurs, un flux reste sur un seul cœur, de l'IRQ
+ *    à la réponse.
+ ****************************************************/
+
+#ifndef CPUPIN_H
+#define CPUPIN_H
+
+#ifndef _GNU_SOURCE
+#error "cpupin.h : définir _GNU_SOURCE avant toute inclusion"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+/*
+ * Lit une liste de cœurs dans cpus[] (au plus 'max'). Renvoie le nombre
+ * de cœurs, -1 si la liste est invalide ou trop longue.
+ */
+static inline int cpu_list_parse(const char *spec, int *cpus, int max)
+{
+    int n = 0;
+    if (strcmp(spec, "auto") == 0) {
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+            return -1;
+        }
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+            if (CPU_ISSET(c, &set)) {
+                cpus[n++] = c;
+            }
+        }
+        return n;
+    }
+
+    const char *p = spec;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (end == p || lo < 0) {
+            return -1;
+        }
+        if (*end == '-') {
+            p  = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) {
+                return -1;
+            }
+        }
+        if (hi >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long c = lo; c <= hi; c++) {
+            if (n == max) {
+                return -1;
+            }
+            cpus[n++] = (int)c;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            return -1;
+        }
+        p = end;
+    }
+    return n;
+}
+
+// Fixe le thread appelant sur 'cpu' ; 0 si OK
+static inline int cpu_pin_self(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Nœud NUMA de 'cpu' (lien nodeN de sysfs), -1 si inconnu
+static inline int cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *d = opendir(path);
+    if (!d) {
+        return -1;
+    }
+    int node = -1;
+    struct dirent *de;
+    while ((de = readdir(d)) && node < 0) {
+        if (strncmp(de->d_name, "node", 4) == 0 &&
+            de->d_name[4] >= '0' && de->d_name[4] <= '9') {
+            node = atoi(de->d_name + 4);
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+/*
+ * Socket 'type' (SOCK_STREAM ou SOCK_DGRAM) lié au port, membre du groupe
+ * SO_REUSEPORT de ce port, associé au cœur 'cpu' (-1 : aucun). Pour TCP,
+ * l'ordre des listen() donne l'indice du socket dans le groupe ; pour UDP,
+ * celui des bind(). Renvoie -1 en cas d'erreur (message affiché).
+ */
+static inline int reuseport_socket(int type, unsigned short port, int cpu)
+{
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+    // Indicatif (départage des sockets du groupe) : ignoré si non supporté
+    if (cpu >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Attache au groupe de 'fd' un programme cBPF qui renvoie l'indice du
+ * premier socket dont le cœur (cpus[i], dans l'ordre du groupe) est celui
+ * qui traite le paquet ; pour un autre cœur, l'indice renvoyé est hors
+ * groupe et le noyau revient au hachage du flux. 0 si OK.
+ */
+static inline int reuseport_steer(int fd, const int *cpus, int n)
+{
+    struct sock_filter *insns = malloc((2 * n + 2) * sizeof(*insns));
+    if (!insns) {
+        return -1;
+    }
+    int k = 0;
+    insns[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < n; i++) {
+        insns[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1);
+        insns[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    insns[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF);
+
+    struct sock_fprog prog = { (unsigned short)k, insns };
+    int rc = setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    free(insns);
+    return rc;
+}
+
+#endif /* CPUPIN_H */
@@ -0,0 +1,183 @@
+/****************************************************
+ * ifcompress.h
+ *
+ * Compression négociée des réponses entre ifnetshowclient.c
+ * et ifnetshowserv.c (simple inclusion, édition de liens
+ * avec -lz).
+ *
+ * Négociation :
+ *  - le client ajoute " -compress deflate" à sa requête
+ *    "-a" / "-i" ; un ancien serveur (ou netinfod) ignore ce
+ *    mot et répond en clair ;
+ *  - le serveur qui compresse fait précéder la réponse de
+ *    la ligne IFZ_HEADER ("IFZ deflate\n") puis d'un flux
+ *    zlib (deflate) ; les réponses de moins de IFZ_MIN_SIZE
+ *    octets restent en clair ;
+ *  - le client reconnaît l'en-tête sur les premiers octets
+ *    et décompresse au fil de l'eau (ifz_feed), sans jamais
+ *    tenir toute la réponse en mémoire.
+ *
+ * LZ4 n'est pas disponible sur nos images : deflate seul,
+ * le nom de méthode laisse la place à d'autres.
+ ****************************************************/
+
+#ifndef IFCOMPRESS_H
+#define IFCOMPRESS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define IFZ_HEADER     "IFZ deflate\n"
+#define IFZ_HEADER_LEN (sizeof(IFZ_HEADER) - 1)
+#define IFZ_METHOD     "deflate"
+#define IFZ_MIN_SIZE   1024
+#define IFZ_LEVEL      6
+
+// Taille maximale d'une réponse compressée (IFZ_HEADER compris)
+static inline size_t ifz_bound(size_t len) {
+    return IFZ_HEADER_LEN + compressBound(len);
+}
+
+/*
+ * Compresse 'in' (IFZ_HEADER compris) dans 'out', d'au moins
+ * ifz_bound(len) octets. Renvoie la taille, 0 en cas d'échec.
+ */
+static inline size_t ifz_compress_into(const char *in, size_t len, char *out, size_t outcap) {
+    if (outcap < IFZ_HEADER_LEN) {
+        return 0;
+    }
+    uLongf zlen = outcap - IFZ_HEADER_LEN;
+    memcpy(out, IFZ_HEADER, IFZ_HEADER_LEN);
+    if (compress2((Bytef *)out + IFZ_HEADER_LEN, &zlen, (const Bytef *)in, len,
+                  IFZ_LEVEL) != Z_OK) {
+        return 0;
+    }
+    return IFZ_HEADER_LEN + zlen;
+}
+
+/*
+ * Compresse 'in' (IFZ_HEADER compris) dans un buffer alloué, rendu dans
+ * *out. Renvoie la taille, 0 en cas d'échec.
+ */
+static inline size_t ifz_compress(const char *in, size_t len, char **out) {
+    size_t cap = ifz_bound(len);
+    char *buf = malloc(cap);
+    if (!buf) {
+        return 0;
+    }
+    size_t n = ifz_compress_into(in, len, buf, cap);
+    if (n == 0) {
+        free(buf);
+        return 0;
+    }
+    *out = buf;
+    return n;
+}
+
+/* ---------- Lecture côté client ---------- */
+
+// Reçoit les octets en clair, dans l'ordre
+typedef void (*ifz_sink)(const char *data, size_t len, void *ctx);
+
+enum { IFZ_DETECT, IFZ_PLAIN, IFZ_DEFLATE, IFZ_END };
+
+typedef struct {
+    int      mode;
+    char     head[IFZ_HEADER_LEN];  // premiers octets, le temps de reconnaître l'en-tête
+    size_t   headlen;
+    z_stream zs;
+} ifz_reader_t;
+
+static inline void ifz_reader_init(ifz_reader_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->mode = IFZ_DETECT;
+}
+
+static inline void ifz_reader_free(ifz_reader_t *r) {
+    if (r->mode == IFZ_DEFLATE || r->mode == IFZ_END) {
+        inflateEnd(&r->zs);
+    }
+    r->mode = IFZ_DETECT;
+    r->headlen = 0;
+}
+
+static inline int ifz_inflate(ifz_reader_t *r, const char *data, size_t len,
+                              ifz_sink sink, void *ctx)
+{
+    char out[65536];
+    r->zs.next_in  = (Bytef *)data;
+    r->zs.avail_in = len;
+    while (r->mode == IFZ_DEFLATE && (r->zs.avail_in > 0 || r->zs.avail_out == 0)) {
+        r->zs.next_out  = (Bytef *)out;
+        r->zs.avail_out = sizeof(out);
+        int rc = inflate(&r->zs, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            return -1;
+        }
+        if (sizeof(out) - r->zs.avail_out > 0) {
+            sink(out, sizeof(out) - r->zs.avail_out, ctx);
+        }
+        if (rc == Z_STREAM_END) {
+            r->mode = IFZ_END; // octets suivants ignorés
+        } else if (rc == Z_BUF_ERROR) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Fournit les octets reçus ; les octets en clair sont passés à sink().
+ * Renvoie -1 si le flux compressé est invalide.
+ */
+static inline int ifz_feed(ifz_reader_t *r, const char *data, size_t len,
+                           ifz_sink sink, void *ctx)
+{
+    if (r->mode == IFZ_DETECT) {
+        size_t n = IFZ_HEADER_LEN - r->headlen;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(r->head + r->headlen, data, n);
+        r->headlen += n;
+        data += n;
+        len  -= n;
+        if (memcmp(r->head, IFZ_HEADER, r->headlen) != 0) {
+            // Réponse en clair : les octets mis de côté d'abord
+            r->mode = IFZ_PLAIN;
+            sink(r->head, r->headlen, ctx);
+        } else if (r->headlen == IFZ_HEADER_LEN) {
+            if (inflateInit(&r->zs) != Z_OK) {
+                return -1;
+            }
+            r->mode = IFZ_DEFLATE;
+        } else {
+            return 0; // en-tête encore incomplet
+        }
+    }
+    if (len == 0) {
+        return 0;
+    }
+    if (r->mode == IFZ_PLAIN) {
+        sink(data, len, ctx);
+        return 0;
+    }
+    return r->mode == IFZ_DEFLATE ? ifz_inflate(r, data, len, sink, ctx) : 0;
+}
+
+/*
+ * Fin de la réponse. Renvoie -1 si le flux compressé est tronqué.
+ */
+static inline int ifz_finish(ifz_reader_t *r, ifz_sink sink, void *ctx) {
+    int rc = 0;
+    if (r->mode == IFZ_DETECT && r->headlen > 0) {
+        sink(r->head, r->headlen, ctx); // réponse courte, en clair
+    } else if (r->mode == IFZ_DEFLATE) {
+        rc = -1;
+    }
+    ifz_reader_free(r);
+    return rc;
+}
+
+#endif /* IFCOMPRESS_H */
@@ -1,58 +1,102 @@
-/* ifnetshow.c */
+/****************************************************
+ * ifnetshow.c
+ *
+ * Compilation :
+ *    gcc -O2 ifnetshowclient.c -o ifnetshow -lz
+ *
+ * Exécution (exemples) :
+ *    ./ifnetshow -n 10.0.0.1 -a
+ *    ./ifnetshow -n 10.0.0.1 -i eth0
+ *    ./ifnetshow -n 10.0.0.1 -o 10.0.0.42 10.0.1.7
+ *    ./ifnetshow -n 10.0.0.1 -stats
+ *    ./ifnetshow -agg hosts.txt -index parc.idx
+ *    ./ifnetshow -lookup parc.idx 10.0.0.42
+ *    ./ifnetshow -lookup parc.idx - < adresses.txt
+ *
+ * Explications :
+ *  - -n : une requête ("-a", "-i ifname", "-o ip..." ou "-stats") vers un
+ *    serveur (ifnetshowserv ou netinfod, TCP 9999) ; la réponse est lue
+ *    jusqu'à la fermeture de la connexion, quelle que soit sa taille.
+ *    ("-format json" ou "bin" : autre rendu de -a / -i, cf. ifsnapshot.h ;
+ *    "-stats" : compteurs mémoire des workers d'ifnetshowserv)
+ *  - -a, -i et -agg proposent la compression deflate au serveur
+ *    (ifcompress.h) et décompressent au fil de l'eau ; -compress none
+ *    la désactive.
+ *  - -agg : interroge en parallèle (-c connexions simultanées, -timeout
+ *    par hôte) tous les serveurs listés dans le fichier ("ip [nom]" par
+ *    ligne, "-" pour l'entrée standard). Les réponses "-a" complètes sont
+ *    jointes dans une table de hachage adresse -> hôtes (celle d'un hôte
+ *    en échec ou hors délai est écartée en entier, même commencée) :
+ *       "Doublon"       : la même adresse sur deux hôtes/interfaces ;
+ *       "Chevauchement" : deux préfixes différents qui se recouvrent
+ *                         (p.ex. 10.0.0.0/23 et 10.0.0.0/24), trouvés
+ *                         avec un arbre d'intervalles.
+ *    Boucle locale et adresses lien-local sont ignorées.
+ *  - -index : écrit l'index trié adresse -> (hôte, interface), projetable
+ *    en mémoire ; -lookup y cherche des adresses par dichotomie, sans
+ *    réseau ni rechargement.
+ ****************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <net/if.h>
+
+#include "ifcompress.h"
 
 #define SERVER_PORT 9999
 
+#define AGG_CONCURRENCY 64    // connexions simultanées par défaut
+#define AGG_TIMEOUT_MS  3000  // délai par hôte par défaut
+#define LINE_SIZE       512
+
+#define INDEX_MAGIC "IFIDX01"  // 8 octets avec le '\0' final
+
 static void usage(const char *prog) {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "  %s -n <server_ip> -a\n", prog);
-    fprintf(stderr, "  %s -n <server_ip> -i <ifname>\n", prog);
+    fprintf(stderr, "  %s -n <server_ip> -a [-format text|json|bin] [-compress deflate|none]\n", prog);
+    fprintf(stderr, "  %s -n <server_ip> -i <ifname> [-format text|json|bin] [-compress deflate|none]\n", prog);
+    fprintf(stderr, "  %s -n <server_ip> -o <ip> [ip...]\n", prog);
+    fprintf(stderr, "  %s -n <server_ip> -stats\n", prog);
+    fprintf(stderr, "  %s -agg <hosts|-> [-index <fichier>] [-c n] [-timeout ms] [-compress deflate|none]\n", prog);
+    fprintf(stderr, "  %s -lookup <fichier> <ip|->...\n", prog);
     exit(EXIT_FAILURE);
 }
 
-int main(int argc, char *argv[])
-{
-    if (argc < 4) {
-        usage(argv[0]);
-    }
-
-    // Parsing ultra simple
-    char *server_ip = NULL;
-    int show_all = 0;
-    char *ifname = NULL;
-
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
-            server_ip = argv[++i];
-        } else if (strcmp(argv[i], "-a") == 0) {
-            show_all = 1;
-        } else if (strcmp(argv[i], "-i") == 0 && i+1 < argc) {
-            ifname = argv[++i];
-        }
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
     }
+    return p;
+}
 
-    if (!server_ip || (!show_all && !ifname)) {
-        usage(argv[0]);
-    }
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    // On crée la requête qu'on enverra au serveur
-    // => agent attend "-a" ou "-i <ifname>"
-    char request[256];
-    memset(request, 0, sizeof(request));
+/* ---------- Requête simple ---------- */
 
-    if (show_all) {
-        strcpy(request, "-a");
-    } else {
-        snprintf(request, sizeof(request), "-i %s", ifname);
-    }
+static void write_stdout(const char *data, size_t len, void *ctx) {
+    (void)ctx;
+    fwrite(data, 1, len, stdout);
+}
 
+static int single_request(const char *server_ip, const char *request) {
     // Création de la socket
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) {
@@ -86,23 +130,876 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    // Lecture de la réponse
-    char buffer[4096];
-    memset(buffer, 0, sizeof(buffer));
-
-    // On lit en une ou plusieurs fois
-    // Pour faire simple, on lit une première fois, 
-    // en supposant que tout tient dans 4096 octets.
-    ssize_t n = read(sockfd, buffer, sizeof(buffer) - 1);
+    // Lecture de la réponse, jusqu'à ce que le serveur ferme la connexion,
+    // décompressée au fil de l'eau si le serveur l'a compressée
+    ifz_reader_t z;
+    ifz_reader_init(&z);
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(sockfd, buffer, sizeof(buffer))) > 0) {
+        if (ifz_feed(&z, buffer, n, write_stdout, NULL) < 0) {
+            fprintf(stderr, "Réponse compressée invalide\n");
+            ifz_reader_free(&z);
+            close(sockfd);
+            return 1;
+        }
+    }
     if (n < 0) {
         perror("read");
+        ifz_reader_free(&z);
+        close(sockfd);
+        return 1;
+    }
+    if (ifz_finish(&z, write_stdout, NULL) < 0) {
+        fprintf(stderr, "Réponse compressée tronquée\n");
         close(sockfd);
         return 1;
     }
-
-    // Affichage
-    printf("%s", buffer);
 
     close(sockfd);
     return 0;
 }
+
+/* ---------- Tables de hachage du mode agrégé ---------- */
+
+/*
+ * Ensemble à adressage ouvert d'éléments de taille 'stride', dont les
+ * 'keylen' premiers octets forment la clé. Comme dans neighbourshow.c,
+ * la table double quand elle est à moitié pleine.
+ */
+typedef struct {
+    char  *items;
+    size_t stride;
+    size_t keylen;
+    int    count;
+    int    cap;
+    int   *slots;      // indice d'élément + 1, 0 = libre
+    size_t nslots;
+} keyset_t;
+
+static uint32_t hash_bytes(const void *key, size_t len) {
+    const unsigned char *p = key;
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void *keyset_at(const keyset_t *ks, int idx) {
+    return ks->items + (size_t)idx * ks->stride;
+}
+
+static void keyset_rehash(keyset_t *ks, size_t nslots) {
+    free(ks->slots);
+    ks->slots  = calloc(nslots, sizeof(int));
+    ks->nslots = nslots;
+    if (!ks->slots) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ks->count; i++) {
+        size_t h = hash_bytes(keyset_at(ks, i), ks->keylen) & (nslots - 1);
+        while (ks->slots[h]) {
+            h = (h + 1) & (nslots - 1);
+        }
+        ks->slots[h] = i + 1;
+    }
+}
+
+// Renvoie l'indice de l'élément de clé 'key', créé (mis à zéro) s'il est nouveau.
+static int keyset_intern(keyset_t *ks, const void *key, int *created) {
+    if ((size_t)(ks->count + 1) * 2 > ks->nslots) {
+        keyset_rehash(ks, ks->nslots ? ks->nslots * 2 : 1024);
+    }
+    size_t h = hash_bytes(key, ks->keylen) & (ks->nslots - 1);
+    while (ks->slots[h]) {
+        int idx = ks->slots[h] - 1;
+        if (memcmp(keyset_at(ks, idx), key, ks->keylen) == 0) {
+            *created = 0;
+            return idx;
+        }
+        h = (h + 1) & (ks->nslots - 1);
+    }
+    if (ks->count == ks->cap) {
+        ks->cap   = ks->cap ? ks->cap * 2 : 1024;
+        ks->items = xrealloc(ks->items, ks->cap * ks->stride);
+    }
+    void *item = keyset_at(ks, ks->count);
+    memset(item, 0, ks->stride);
+    memcpy(item, key, ks->keylen);
+    ks->slots[h] = ks->count + 1;
+    *created = 1;
+    return ks->count++;
+}
+
+/* ---------- État du mode agrégé ---------- */
+
+// Clé adresse (len = 0) ou préfixe (adresse du réseau + longueur)
+typedef struct {
+    uint8_t family;    // 4 ou 6, comme dans l'inventaire de découverte
+    uint8_t len;
+    uint8_t addr[16];
+} ipkey_t;
+
+typedef struct {
+    ipkey_t key;
+    int     first;     // premier propriétaire (indice dans owners), chaîné par next
+    int     count;
+} addr_item_t;
+
+typedef struct {
+    int  host;
+    int  prefixlen;
+    int  next;
+    char ifname[IF_NAMESIZE];
+} owner_t;
+
+typedef struct {
+    ipkey_t key;
+    int     hosts;       // hôtes distincts portant ce préfixe
+    int     first_host;
+} prefix_item_t;
+
+typedef struct {
+    int prefix;
+    int host;
+} prefix_host_t;
+
+typedef struct {
+    char ip[INET_ADDRSTRLEN];
+    char name[64];
+    int  ok;
+} host_t;
+
+static host_t  *hosts;
+static int      host_count;
+
+static keyset_t addr_set   = { .stride = sizeof(addr_item_t),   .keylen = sizeof(ipkey_t) };
+static keyset_t prefix_set = { .stride = sizeof(prefix_item_t), .keylen = sizeof(ipkey_t) };
+static keyset_t ph_set     = { .stride = sizeof(prefix_host_t), .keylen = sizeof(prefix_host_t) };
+
+static owner_t *owners;
+static int      owner_count, owner_cap;
+static long     ignored_count;
+
+static int is_ignored(int family, const uint8_t *a) {
+    if (family == AF_INET) {
+        return a[0] == 127 || (a[0] == 169 && a[1] == 254);
+    }
+    static const uint8_t loop6[16] = { [15] = 1 };
+    return memcmp(a, loop6, 16) == 0 || (a[0] == 0xfe && (a[1] & 0xc0) == 0x80);
+}
+
+/*
+ * Intègre une ligne "ifname: addr/prefix" de l'hôte 'host' : jointure
+ * adresse -> propriétaires et préfixe -> hôtes.
+ */
+static void agg_line(int host, char *line) {
+    char *sep = strstr(line, ": ");
+    if (!sep || sep == line) {
+        return;
+    }
+    *sep = '\0';
+    char *addr_str = sep + 2;
+    size_t alen = strcspn(addr_str, "/ ");
+    int prefixlen = -1;
+    if (addr_str[alen] == '/') {
+        prefixlen = atoi(addr_str + alen + 1);
+    }
+    addr_str[alen] = '\0';
+
+    uint8_t a[16] = {0};
+    int family = strchr(addr_str, ':') ? AF_INET6 : AF_INET;
+    if (inet_pton(family, addr_str, a) != 1) {
+        return;
+    }
+    int bits = family == AF_INET ? 32 : 128;
+    if (prefixlen < 0 || prefixlen > bits) {
+        prefixlen = bits;
+    }
+    if (is_ignored(family, a)) {
+        ignored_count++;
+        return;
+    }
+
+    // Adresse -> propriétaires
+    ipkey_t k;
+    memset(&k, 0, sizeof(k));
+    k.family = family == AF_INET ? 4 : 6;
+    memcpy(k.addr, a, sizeof(a));
+
+    int created;
+    int ai = keyset_intern(&addr_set, &k, &created);
+    if (owner_count == owner_cap) {
+        owner_cap = owner_cap ? owner_cap * 2 : 1024;
+        owners = xrealloc(owners, owner_cap * sizeof(*owners));
+    }
+    owner_t *o = &owners[owner_count];
+    o->host      = host;
+    o->prefixlen = prefixlen;
+    snprintf(o->ifname, sizeof(o->ifname), "%s", line);
+    addr_item_t *item = keyset_at(&addr_set, ai);
+    o->next     = created ? -1 : item->first;
+    item->first = owner_count++;
+    item->count++;
+
+    // Préfixe -> hôtes distincts
+    for (int i = 0; i < 16; i++) {
+        int keep = prefixlen - 8 * i;
+        k.addr[i] &= keep >= 8 ? 0xff : (keep <= 0 ? 0 : (uint8_t)(0xff << (8 - keep)));
+    }
+    k.len = prefixlen;
+    int pi = keyset_intern(&prefix_set, &k, &created);
+    prefix_item_t *p = keyset_at(&prefix_set, pi);
+    if (created) {
+        p->first_host = host;
+    }
+    prefix_host_t ph = { pi, host };
+    keyset_intern(&ph_set, &ph, &created);
+    if (created) {
+        p->hosts++;
+    }
+}
+
+/* ---------- Interrogation parallèle ---------- */
+
+typedef struct {
+    int      fd;          // -1 = case libre
+    int      host;
+    int      sent;
+    uint64_t deadline;
+    char     line[LINE_SIZE];
+    size_t   linelen;
+    char    *text;        // lignes complètes ('\0' final), jointes à la fin
+    size_t   textlen, textcap;
+    ifz_reader_t z;
+} agg_conn_t;
+
+static int offer_compress = 1;
+
+static void load_hosts(const char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    int cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char ip[INET_ADDRSTRLEN], name[64];
+        int n = sscanf(line, "%15s %63s", ip, name);
+        if (n < 1 || ip[0] == '#') {
+            continue;
+        }
+        if (host_count == cap) {
+            cap = cap ? cap * 2 : 256;
+            hosts = xrealloc(hosts, cap * sizeof(*hosts));
+        }
+        host_t *h = &hosts[host_count++];
+        snprintf(h->ip, sizeof(h->ip), "%s", ip);
+        snprintf(h->name, sizeof(h->name), "%s", n == 2 ? name : ip);
+        h->ok = 0;
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+}
+
+static void agg_feed(const char *data, size_t len, void *ctx);
+
+static void conn_finish(int epfd, agg_conn_t *c, const char *error) {
+    if (!error && ifz_finish(&c->z, agg_feed, c) < 0) {
+        error = "réponse compressée tronquée";
+    }
+    ifz_reader_free(&c->z);
+    if (error) {
+        // Réponse partielle : rien n'entre dans les tables
+        fprintf(stderr, "[Agg] %s (%s) : %s\n", hosts[c->host].name, hosts[c->host].ip, error);
+    } else {
+        for (size_t off = 0; off < c->textlen; off += strlen(c->text + off) + 1) {
+            agg_line(c->host, c->text + off);
+        }
+        if (c->linelen > 0) {
+            c->line[c->linelen] = '\0';
+            agg_line(c->host, c->line);
+        }
+        hosts[c->host].ok = 1;
+    }
+    c->textlen = 0;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static int conn_start(int epfd, agg_conn_t *c, int host, int timeout_ms) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port   = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, hosts[host].ip, &sa.sin_addr) != 1) {
+        fprintf(stderr, "[Agg] %s : adresse invalide\n", hosts[host].ip);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS) {
+        fprintf(stderr, "[Agg] %s (%s) : %s\n", hosts[host].name, hosts[host].ip, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    c->fd       = fd;
+    c->host     = host;
+    c->sent     = 0;
+    c->linelen  = 0;
+    c->textlen  = 0;
+    c->deadline = now_ms() + timeout_ms;
+    ifz_reader_init(&c->z);
+
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = c };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    return 0;
+}
+
+static void conn_event(int epfd, agg_conn_t *c) {
+    if (!c->sent) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        const char *req = offer_compress ? "-a -compress " IFZ_METHOD : "-a";
+        if (err || write(c->fd, req, strlen(req)) != (ssize_t)strlen(req)) {
+            conn_finish(epfd, c, strerror(err ? err : errno));
+            return;
+        }
+        c->sent = 1;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        return;
+    }
+
+    char buf[16384];
+    for (;;) {
+        ssize_t n = read(c->fd, buf, sizeof(buf));
+        if (n == 0) {
+            conn_finish(epfd, c, NULL);
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                conn_finish(epfd, c, strerror(errno));
+            }
+            return;
+        }
+        if (ifz_feed(&c->z, buf, n, agg_feed, c) < 0) {
+            conn_finish(epfd, c, "réponse compressée invalide");
+            return;
+        }
+    }
+}
+
+/*
+ * Découpage en lignes, la fin incomplète attend la lecture suivante. Les
+ * lignes complètes sont mises de côté jusqu'à la fin de la réponse.
+ */
+static void agg_feed(const char *data, size_t len, void *ctx) {
+    agg_conn_t *c = ctx;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\n') {
+            if (c->textlen + c->linelen + 1 > c->textcap) {
+                c->textcap = (c->textcap ? c->textcap : LINE_SIZE) * 2 + c->linelen;
+                c->text    = xrealloc(c->text, c->textcap);
+            }
+            memcpy(c->text + c->textlen, c->line, c->linelen);
+            c->textlen += c->linelen;
+            c->text[c->textlen++] = '\0';
+            c->linelen = 0;
+        } else if (c->linelen < LINE_SIZE - 1) {
+            c->line[c->linelen++] = data[i];
+        }
+    }
+}
+
+static void agg_collect(int concurrency, int timeout_ms) {
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+    agg_conn_t *conns = calloc(concurrency, sizeof(*conns));
+    if (!conns) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < concurrency; i++) {
+        conns[i].fd = -1;
+    }
+
+    int next = 0, active = 0;
+    while (next < host_count || active > 0) {
+        // Remplit les cases libres
+        active = 0;
+        for (int i = 0; i < concurrency; i++) {
+            while (conns[i].fd < 0 && next < host_count) {
+                conn_start(epfd, &conns[i], next++, timeout_ms);
+            }
+            active += conns[i].fd >= 0;
+        }
+        if (active == 0) {
+            break;
+        }
+
+        struct epoll_event evs[64];
+        int n = epoll_wait(epfd, evs, 64, 100);
+        for (int i = 0; i < n; i++) {
+            conn_event(epfd, evs[i].data.ptr);
+        }
+
+        uint64_t now = now_ms();
+        for (int i = 0; i < concurrency; i++) {
+            if (conns[i].fd >= 0 && now >= conns[i].deadline) {
+                conn_finish(epfd, &conns[i], "délai dépassé");
+            }
+        }
+    }
+    for (int i = 0; i < concurrency; i++) {
+        free(conns[i].text);
+    }
+    free(conns);
+    close(epfd);
+}
+
+/* ---------- Rapport ---------- */
+
+static void key_to_str(const ipkey_t *k, char *out, size_t outlen) {
+    inet_ntop(k->family == 4 ? AF_INET : AF_INET6, k->addr, out, outlen);
+}
+
+static void report_duplicates(void) {
+    for (int i = 0; i < addr_set.count; i++) {
+        const addr_item_t *a = keyset_at(&addr_set, i);
+        if (a->count < 2) {
+            continue;
+        }
+        char s[INET6_ADDRSTRLEN];
+        key_to_str(&a->key, s, sizeof(s));
+        printf("Doublon %s :", s);
+        for (int o = a->first; o >= 0; o = owners[o].next) {
+            printf(" %s (%s)%s", hosts[owners[o].host].name, owners[o].ifname,
+                   owners[o].next >= 0 ? "," : "\n");
+        }
+    }
+}
+
+/*
+ * Arbre d'intervalles implicite : intervalles triés par début, le nœud
+ * d'un sous-tableau [lo, hi) est son milieu, et max_end[mid] est la plus
+ * grande fin de ce sous-tableau. Une requête élague tout sous-arbre dont
+ * max_end est avant le début cherché.
+ */
+typedef unsigned __int128 u128;
+
+typedef struct {
+    u128 start, end;
+    int  prefix;       // indice dans prefix_set
+} interval_t;
+
+static int cmp_interval(const void *a, const void *b) {
+    const interval_t *x = a, *y = b;
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+    return (x->end > y->end) - (x->end < y->end);
+}
+
+static u128 itree_build(const interval_t *iv, u128 *max_end, int lo, int hi) {
+    if (lo >= hi) {
+        return 0;
+    }
+    int mid = lo + (hi - lo) / 2;
+    u128 m = iv[mid].end;
+    u128 l = itree_build(iv, max_end, lo, mid);
+    u128 r = itree_build(iv, max_end, mid + 1, hi);
+    if (mid > lo && l > m) m = l;
+    if (mid + 1 < hi && r > m) m = r;
+    max_end[mid] = m;
+    return m;
+}
+
+static void print_prefix(const prefix_item_t *p) {
+    char s[INET6_ADDRSTRLEN];
+    key_to_str(&p->key, s, sizeof(s));
+    printf("%s/%d (%d hôte%s, ex. %s)", s, p->key.len, p->hosts,
+           p->hosts > 1 ? "s" : "", hosts[p->first_host].name);
+}
+
+// Signale les intervalles d'indice > self qui recouvrent iv[self].
+static long itree_report(const interval_t *iv, const u128 *max_end, int lo, int hi, int self) {
+    if (lo >= hi || max_end[lo + (hi - lo) / 2] < iv[self].start) {
+        return 0;
+    }
+    int mid = lo + (hi - lo) / 2;
+    long found = itree_report(iv, max_end, lo, mid, self);
+    if (iv[mid].start <= iv[self].end) {
+        if (mid > self && iv[mid].end >= iv[self].start) {
+            printf("Chevauchement ");
+            print_prefix(keyset_at(&prefix_set, iv[self].prefix));
+            printf(" / ");
+            print_prefix(keyset_at(&prefix_set, iv[mid].prefix));
+            printf("\n");
+            found++;
+        }
+        found += itree_report(iv, max_end, mid + 1, hi, self);
+    }
+    return found;
+}
+
+static long report_overlaps(int family) {
+    interval_t *iv = malloc((prefix_set.count + 1) * sizeof(*iv));
+    u128 *max_end  = malloc((prefix_set.count + 1) * sizeof(*max_end));
+    if (!iv || !max_end) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int n = 0;
+    int bits = family == 4 ? 32 : 128;
+    for (int i = 0; i < prefix_set.count; i++) {
+        const prefix_item_t *p = keyset_at(&prefix_set, i);
+        if (p->key.family != family) {
+            continue;
+        }
+        u128 v = 0;
+        for (int b = 0; b < bits / 8; b++) {
+            v = (v << 8) | p->key.addr[b];
+        }
+        u128 span = p->key.len >= bits ? 0 : (((u128)1 << (bits - p->key.len)) - 1);
+        iv[n].start  = v;
+        iv[n].end    = v | span;
+        iv[n].prefix = i;
+        n++;
+    }
+    qsort(iv, n, sizeof(*iv), cmp_interval);
+    itree_build(iv, max_end, 0, n);
+
+    long found = 0;
+    for (int i = 0; i < n; i++) {
+        found += itree_report(iv, max_end, 0, n, i);
+    }
+    free(iv);
+    free(max_end);
+    return found;
+}
+
+/* ---------- Index projetable en mémoire ---------- */
+
+typedef struct {
+    char     magic[8];
+    uint32_t count;        // enregistrements, triés par (famille, adresse)
+    uint32_t strings_len;  // noms d'hôtes, terminés par '\0', après les enregistrements
+} index_hdr_t;
+
+typedef struct {
+    uint8_t  family;       // 4 ou 6
+    uint8_t  prefixlen;
+    uint16_t reserved;
+    uint32_t host_off;     // décalage du nom d'hôte dans la zone de chaînes
+    uint8_t  addr[16];
+    char     ifname[IF_NAMESIZE];
+} index_rec_t;
+
+static int cmp_index_rec(const void *a, const void *b) {
+    const index_rec_t *x = a, *y = b;
+    if (x->family != y->family) {
+        return x->family - y->family;
+    }
+    return memcmp(x->addr, y->addr, sizeof(x->addr));
+}
+
+static int write_index(const char *path) {
+    index_rec_t *recs = calloc(owner_count + 1, sizeof(*recs));
+    uint32_t *host_off = calloc(host_count + 1, sizeof(*host_off));
+    if (!recs || !host_off) {
+        perror("calloc");
+        return -1;
+    }
+
+    // Noms d'hôtes : une seule copie chacun
+    uint32_t strings_len = 0;
+    for (int h = 0; h < host_count; h++) {
+        host_off[h] = strings_len;
+        strings_len += strlen(hosts[h].name) + 1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < addr_set.count; i++) {
+        const addr_item_t *a = keyset_at(&addr_set, i);
+        for (int o = a->first; o >= 0; o = owners[o].next) {
+            recs[n].family    = a->key.family;
+            recs[n].prefixlen = owners[o].prefixlen;
+            recs[n].host_off  = host_off[owners[o].host];
+            memcpy(recs[n].addr, a->key.addr, sizeof(recs[n].addr));
+            memcpy(recs[n].ifname, owners[o].ifname, sizeof(recs[n].ifname));
+            n++;
+        }
+    }
+    qsort(recs, n, sizeof(*recs), cmp_index_rec);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    index_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.count       = n;
+    hdr.strings_len = strings_len;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(recs, sizeof(*recs), n, fp);
+    for (int h = 0; h < host_count; h++) {
+        fwrite(hosts[h].name, 1, strlen(hosts[h].name) + 1, fp);
+    }
+    int ret = fclose(fp) == 0 ? 0 : -1;
+    if (ret < 0) {
+        perror(path);
+    }
+    free(recs);
+    free(host_off);
+    return ret;
+}
+
+static int agg_mode(const char *hosts_path, const char *index_path,
+                    int concurrency, int timeout_ms)
+{
+    load_hosts(hosts_path);
+    if (host_count == 0) {
+        fprintf(stderr, "[Agg] Aucun hôte dans %s\n", hosts_path);
+        return 1;
+    }
+
+    uint64_t t0 = now_ms();
+    agg_collect(concurrency, timeout_ms);
+    int ok = 0;
+    for (int h = 0; h < host_count; h++) {
+        ok += hosts[h].ok;
+    }
+    printf("[Agg] %d hôtes interrogés, %d réponses, %d échecs en %.3f s : "
+           "%d adresses (%ld ignorées), %d préfixes\n",
+           host_count, ok, host_count - ok, (now_ms() - t0) / 1e3,
+           owner_count, ignored_count, prefix_set.count);
+
+    report_duplicates();
+    long overlaps = report_overlaps(4) + report_overlaps(6);
+    int dups = 0;
+    for (int i = 0; i < addr_set.count; i++) {
+        dups += ((const addr_item_t *)keyset_at(&addr_set, i))->count > 1;
+    }
+    printf("[Agg] %d adresses en doublon, %ld chevauchements de préfixes\n", dups, overlaps);
+
+    if (index_path) {
+        if (write_index(index_path) < 0) {
+            return 1;
+        }
+        printf("[Agg] Index : %s (%d enregistrements)\n", index_path, owner_count);
+    }
+    return 0;
+}
+
+/* ---------- Recherche hors ligne dans l'index ---------- */
+
+static void lookup_one(const index_hdr_t *hdr, const index_rec_t *recs,
+                       const char *strings, const char *ip)
+{
+    index_rec_t key;
+    memset(&key, 0, sizeof(key));
+    int family = strchr(ip, ':') ? AF_INET6 : AF_INET;
+    if (inet_pton(family, ip, key.addr) != 1) {
+        printf("%s: adresse invalide\n", ip);
+        return;
+    }
+    key.family = family == AF_INET ? 4 : 6;
+
+    // Premier enregistrement >= clé
+    uint32_t lo = 0, hi = hdr->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cmp_index_rec(&recs[mid], &key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == hdr->count || cmp_index_rec(&recs[lo], &key) != 0) {
+        printf("%s: inconnue\n", ip);
+        return;
+    }
+    for (; lo < hdr->count && cmp_index_rec(&recs[lo], &key) == 0; lo++) {
+        const index_rec_t *r = &recs[lo];
+        const char *host = r->host_off < hdr->strings_len ? strings + r->host_off : "?";
+        printf("%s: %s %.*s %s/%d\n", ip, host, IF_NAMESIZE, r->ifname, ip, r->prefixlen);
+    }
+}
+
+static int lookup_mode(const char *path, char **ips, int count) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(index_hdr_t)) {
+        fprintf(stderr, "%s : index trop court\n", path);
+        return 1;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    const index_hdr_t *hdr = (const index_hdr_t *)map;
+    if (memcmp(hdr->magic, INDEX_MAGIC, sizeof(hdr->magic)) != 0 ||
+        sizeof(*hdr) + (size_t)hdr->count * sizeof(index_rec_t) + hdr->strings_len >
+        (size_t)st.st_size) {
+        fprintf(stderr, "%s : index invalide\n", path);
+        return 1;
+    }
+    const index_rec_t *recs = (const index_rec_t *)(map + sizeof(*hdr));
+    const char *strings = (const char *)(recs + hdr->count);
+
+    if (count == 1 && strcmp(ips[0], "-") == 0) {
+        char line[256];
+        while (fgets(line, sizeof(line), stdin)) {
+            line[strcspn(line, " \t\r\n")] = '\0';
+            if (line[0]) {
+                lookup_one(hdr, recs, strings, line);
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            lookup_one(hdr, recs, strings, ips[i]);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        usage(argv[0]);
+    }
+
+    // Parsing ultra simple
+    char *server_ip = NULL;
+    int show_all = 0;
+    char *ifname = NULL;
+    char **owner_ips = NULL;  // "-o ip [ip...]" : arguments suivants jusqu'à la prochaine option
+    int owner_count = 0;
+    int show_stats = 0;
+    char *agg_hosts = NULL;
+    char *index_path = NULL;
+    char *format = NULL;
+    int concurrency = AGG_CONCURRENCY;
+    int timeout_ms = AGG_TIMEOUT_MS;
+
+    if (strcmp(argv[1], "-lookup") == 0) {
+        // -lookup <index> ip... : tout le reste de la ligne est à chercher
+        if (argc < 4) {
+            usage(argv[0]);
+        }
+        return lookup_mode(argv[2], argv + 3, argc - 3);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            server_ip = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0) {
+            show_all = 1;
+        } else if (strcmp(argv[i], "-i") == 0 && i+1 < argc) {
+            ifname = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc && argv[i+1][0] != '-') {
+            owner_ips = argv + i + 1;
+            while (i+1 < argc && argv[i+1][0] != '-') {
+                owner_count++;
+                i++;
+            }
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "-format") == 0 && i+1 < argc) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "-compress") == 0 && i+1 < argc) {
+            i++;
+            if (strcmp(argv[i], "none") == 0) {
+                offer_compress = 0;
+            } else if (strcmp(argv[i], IFZ_METHOD) != 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-agg") == 0 && i+1 < argc) {
+            agg_hosts = argv[++i];
+        } else if (strcmp(argv[i], "-index") == 0 && i+1 < argc) {
+            index_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i+1 < argc) {
+            concurrency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-timeout") == 0 && i+1 < argc) {
+            timeout_ms = atoi(argv[++i]);
+        } else {
+            // Option inconnue, valeur manquante ou argument orphelin
+            usage(argv[0]);
+        }
+    }
+
+    if (agg_hosts) {
+        if (concurrency < 1 || timeout_ms < 1) {
+            usage(argv[0]);
+        }
+        return agg_mode(agg_hosts, index_path, concurrency, timeout_ms);
+    }
+
+    if (!server_ip || (!show_all && !ifname && !owner_count && !show_stats)) {
+        usage(argv[0]);
+    }
+
+    // On crée la requête qu'on enverra au serveur
+    // => agent attend "-a", "-i <ifname>", "-o <ip>..." ou "-s"
+    char request[256];
+    memset(request, 0, sizeof(request));
+    char *owner_request = NULL;
+
+    if (show_all) {
+        strcpy(request, "-a");
+    } else if (ifname) {
+        snprintf(request, sizeof(request), "-i %s", ifname);
+    }
+    if (format && (show_all || ifname)) {
+        snprintf(request + strlen(request), sizeof(request) - strlen(request),
+                 " -format %s", format);
+    }
+    if (offer_compress && (show_all || ifname)) {
+        snprintf(request + strlen(request), sizeof(request) - strlen(request),
+                 " -compress %s", IFZ_METHOD);
+    }
+    if (!show_all && !ifname) {
+        if (owner_count) {
+            // Toutes les adresses dans une seule requête, sans limite de taille ici
+            size_t len = 3;
+            for (int k = 0; k < owner_count; k++) {
+                len += strlen(owner_ips[k]) + 1;
+            }
+            owner_request = xrealloc(NULL, len);
+            strcpy(owner_request, "-o");
+            for (int k = 0; k < owner_count; k++) {
+                strcat(strcat(owner_request, " "), owner_ips[k]);
+            }
+        } else {
+            strcpy(request, "-s");
+        }
+    }
+
+    int ret = single_request(server_ip, owner_request ? owner_request : request);
+    free(owner_request);
+    return ret;
+}
@@ -1,186 +1,1028 @@
+/****************************************************
+ * ifnetshowserv.c
+ *
+ * Compilation :
+ *    gcc -O2 -pthread ifnetshowserv.c -o ifnetshowserv -lz
+ *
+ * Exécution (exemples) :
+ *    ./ifnetshowserv            # un worker par CPU
+ *    ./ifnetshowserv -w 8
+ *    ./ifnetshowserv -cpus 0-7   # un worker fixé par cœur listé
+ *    ./ifnetshowserv -cpus 0-7 -busypoll 50
+ *
+ * Explications :
+ *  - Écoute TCP 9999, une requête par connexion : "-a", "-i ifname"
+ *    (suivies ou non de "-format text|json|bin"), "-o ip..." ou "-s".
+ *  - Un thread de rafraîchissement énumère les adresses (ifsnapshot.h)
+ *    et construit l'arbre des préfixes de "-o" (iftrie.h) à chaque
+ *    notification rtnetlink de changement (rafale regroupée), au plus
+ *    tard toutes les REFRESH_MS. Il publie un instantané immuable par
+ *    échange atomique du pointeur courant, à la manière de RCU.
+ *  - Les workers ne font jamais d'énumération : ils lisent l'instantané
+ *    courant, protégé par un pointeur de danger (hazard pointer) par
+ *    worker ; un ancien instantané n'est libéré qu'une fois qu'aucun
+ *    worker ne le tient plus.
+ *  - Rendus "-a" en single-flight : le premier demandeur d'un format
+ *    le calcule, les requêtes simultanées attendent ce même résultat,
+ *    gardé ensuite avec l'instantané. 500 "-a" simultanés coûtent une
+ *    énumération (déjà faite) et un rendu.
+ *  - Compression négociée (ifcompress.h) : avec " -compress deflate",
+ *    les réponses de plus de IFZ_MIN_SIZE octets sont compressées. Le
+ *    rendu "-a" compressé est lui aussi gardé avec l'instantané : une
+ *    compression par génération et par format, pas par requête.
+ *  - Envoi sans copie : chaque rendu "-a" gardé est recopié une fois
+ *    dans un memfd scellé (plus aucune écriture possible) et envoyé par
+ *    sendfile() ; le coût d'une requête ne dépend plus de la taille de
+ *    la réponse. Les grosses réponses propres à une requête ("-i") partent
+ *    en MSG_ZEROCOPY ; le buffer du worker n'est réutilisé qu'après les
+ *    notifications de fin d'envoi de la file d'erreurs du socket.
+ *  - -cpus : chaque worker est fixé sur un cœur de la liste, alloue ses
+ *    buffers sur le nœud NUMA local et a son propre socket d'écoute
+ *    SO_REUSEPORT ; une connexion est acceptée par le worker du cœur
+ *    qui a reçu le SYN (cpupin.h). Sans -cpus, tous les workers
+ *    acceptent sur un même socket, sans placement.
+ *  - -busypoll usec : mode faible latence (busypoll.h). Les workers
+ *    attendent les connexions par epoll en busy polling, et les sockets
+ *    acceptés héritent de SO_BUSY_POLL pour la lecture de la requête.
+ *    Mesure : latbench.sh (avec et sans).
+ *  - Mémoire par worker, sans malloc par requête en régime établi : les
+ *    connexions viennent d'un slab, la requête est lue dans un buffer
+ *    d'E/S recyclé, et tout ce qu'elle alloue (vue "-i", rendu, version
+ *    compressée, réponse "-o") vient d'une arène remise à zéro en O(1)
+ *    à la fin de la requête, et réduite après une pointe passée. "-s"
+ *    donne les plus hauts niveaux atteints. Un worker ne sert encore
+ *    qu'une connexion à la fois : slab et buffers n'ont qu'un élément en
+ *    service et ne servent vraiment qu'avec un worker qui multiplexe
+ *    ses connexions ; l'arène, elle, évite déjà les malloc de rendu.
+ ****************************************************/
+
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <pthread.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
 #include <signal.h>
-#include <ifaddrs.h>
 #include <net/if.h>
 
+#include "nlutil.h"
+#include "iftrie.h"
+#include "ifsnapshot.h"
+#include "ifcompress.h"
+#include "cpupin.h"
+#include "busypoll.h"
+
 #define SERVER_PORT 9999
 #define BUF_SIZE 4096
+#define MAX_WORKERS 256
+#define REFRESH_MS  30000  // filet de sécurité si une notification est perdue
+#define DEBOUNCE_MS 20     // regroupe une rafale de changements
+#define DEBOUNCE_MAX_MS 200 // au plus, après le premier événement
+#define CLIENT_TIMEOUT_S 5
+#define ARENA_SIZE  (64 * 1024)   // arène initiale d'un worker
+#define ARENA_SHRINK_AFTER 1024   // requêtes sous la taille agrandie avant réduction
+#define IOBUF_SIZE  BUF_SIZE      // buffer de lecture d'une requête
+#define OWNER_SIZE  (BUF_SIZE * 4)
+#define CONN_SLAB   16            // connexions allouées d'un coup
+#define ZEROCOPY_MIN (64 * 1024)  // en deçà, la copie coûte moins que les notifications
+
+#define RENDER_KINDS (sizeof(ifsnap_renderers) / sizeof(ifsnap_renderers[0]))
+
+/*
+ * Rendu "-a" d'un format, en clair ou compressé, calculé une seule fois
+ * par instantané. Avec un memfd (fd >= 0), 'buf' en est la projection
+ * en lecture seule ; sinon un buffer alloué.
+ */
+typedef struct {
+    int    state;  // RENDER_EMPTY, RENDER_BUSY ou RENDER_READY
+    char  *buf;
+    size_t len;
+    int    fd;
+} render_slot_t;
+
+enum { RENDER_EMPTY, RENDER_BUSY, RENDER_READY };
+
+/*
+ * Instantané immuable une fois publié (hors rendus paresseux, protégés
+ * par 'lock').
+ */
+typedef struct snapshot {
+    ifsnap_t         snap;
+    iftrie_t         trie;
+    unsigned long    gen;
+    pthread_mutex_t  lock;
+    pthread_cond_t   ready;
+    render_slot_t    all[RENDER_KINDS * 2];  // [format * 2 + compressé]
+    struct snapshot *retired_next;
+} snapshot_t;
+
+/*
+ * Pointeur de danger d'un worker, seul sur sa ligne de cache : écrit à
+ * chaque requête, il ne doit pas faire aller et venir la ligne d'un
+ * worker voisin (éventuellement sur l'autre socket).
+ */
+typedef struct {
+    snapshot_t *s;
+} __attribute__((aligned(64))) hazard_t;
+
+static snapshot_t *current;               // publié par le rafraîchisseur
+static hazard_t    hazard[MAX_WORKERS];   // instantané tenu par chaque worker
+static int         nworkers;
+static int         busy_poll_usec;        // -busypoll, 0 : attente classique
+static snapshot_t *retired;               // en attente de libération (rafraîchisseur seul)
+
+/* ---------- Mémoire des workers ---------- */
+
+/*
+ * Arène d'une requête : allocations par simple incrément, toutes rendues
+ * d'un coup en fin de requête (arena_reset, O(1)). Une requête qui
+ * déborde passe par malloc ; l'arène est alors agrandie à ce qu'elle a
+ * demandé, pour que la suivante de même taille tienne dedans. Après
+ * ARENA_SHRINK_AFTER requêtes sans débordement, une arène agrandie revient
+ * à la plus forte demande de cette période (ARENA_SIZE au moins) : une
+ * seule grosse réponse ne la garde pas grosse pour toujours.
+ */
+typedef struct arena_big {
+    struct arena_big *next;
+} __attribute__((aligned(16))) arena_big_t;
+
+typedef struct {
+    char          *base;
+    size_t         cap;
+    size_t         off;
+    size_t         used;       // demandé par la requête en cours, débordements compris
+    size_t         high;       // plus forte demande d'une requête
+    size_t         min_cap;    // taille initiale, plancher des réductions
+    size_t         recent;     // plus forte demande depuis le dernier redimensionnement
+    unsigned long  calm;       // requêtes sans débordement depuis
+    unsigned long  overflows;  // requêtes qui ont débordé
+    arena_big_t   *big;        // débordements de la requête en cours
+} arena_t;
 
 /*
- * Compte les bits à 1 dans buf (pour calculer le prefix length).
+ * Buffers d'E/S (lecture des requêtes), recyclés : jamais rendus au
+ * système, jamais remis à zéro.
  */
-static int count_prefix_len(const unsigned char *buf, size_t buflen) {
-    int prefix_len = 0;
-    for (size_t i = 0; i < buflen; i++) {
-        unsigned char c = buf[i];
-        while (c) {
-            prefix_len += (c & 1);
-            c >>= 1;
+typedef struct iobuf {
+    struct iobuf *next;
+    char          data[IOBUF_SIZE];
+} iobuf_t;
+
+typedef struct {
+    iobuf_t       *free;
+    unsigned long  total;
+    unsigned long  in_use;
+    unsigned long  high;
+} iobuf_pool_t;
+
+// Connexion en cours, prise dans le slab du worker
+typedef struct conn {
+    struct conn *next;
+    int          fd;
+    iobuf_t     *in;
+} conn_t;
+
+typedef struct {
+    conn_t        *free;
+    unsigned long  total;
+    unsigned long  in_use;
+    unsigned long  high;
+} conn_slab_t;
+
+/*
+ * Contexte d'un worker : arène, buffers et connexions, alloués par le
+ * worker lui-même après placement sur son cœur ('cpu', -1 : aucun).
+ * 'stats' est publié en fin de requête pour la requête "-s".
+ */
+typedef struct {
+    unsigned long requests;
+    size_t        arena_cap, arena_high;
+    unsigned long arena_overflows;
+    unsigned long conn_high, conn_total;
+    unsigned long iobuf_high, iobuf_total;
+} worker_stats_t;
+
+typedef struct {
+    int            id;
+    int            cpu;
+    int            listenfd;
+    arena_t        arena;
+    iobuf_pool_t   pool;
+    conn_slab_t    conns;
+    worker_stats_t stats;
+} __attribute__((aligned(64))) worker_t;
+
+static worker_t workers[MAX_WORKERS];
+
+static int arena_init(arena_t *a, size_t cap)
+{
+    memset(a, 0, sizeof(*a));
+    a->base = malloc(cap);
+    if (!a->base) {
+        return -1;
+    }
+    memset(a->base, 0, cap); // first-touch : pages sur le nœud du worker
+    a->cap     = cap;
+    a->min_cap = cap;
+    return 0;
+}
+
+// 'size' octets alignés sur 16, NULL si la mémoire manque
+static void *arena_alloc(arena_t *a, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    a->used += size;
+    if (size <= a->cap - a->off) {
+        void *p = a->base + a->off;
+        a->off += size;
+        return p;
+    }
+    arena_big_t *big = malloc(sizeof(*big) + size);
+    if (!big) {
+        return NULL;
+    }
+    big->next = a->big;
+    a->big    = big;
+    return big + 1;
+}
+
+static void arena_reset(arena_t *a)
+{
+    if (a->used > a->high) {
+        a->high = a->used;
+    }
+    if (a->big) {
+        // Débordement : l'arène grandit à la demande de cette requête
+        while (a->big) {
+            arena_big_t *next = a->big->next;
+            free(a->big);
+            a->big = next;
+        }
+        a->overflows++;
+        char *base = malloc(a->used);
+        if (base) {
+            free(a->base);
+            a->base = base;
+            a->cap  = a->used;
+        }
+        a->recent = 0;
+        a->calm   = 0;
+    } else if (a->cap > a->min_cap) {
+        // Arène agrandie : réduite si les requêtes récentes n'en ont plus besoin
+        if (a->used > a->recent) {
+            a->recent = a->used;
+        }
+        if (++a->calm >= ARENA_SHRINK_AFTER) {
+            size_t cap = a->recent > a->min_cap ? a->recent : a->min_cap;
+            char *base = cap < a->cap ? malloc(cap) : NULL;
+            if (base) {
+                memset(base, 0, cap); // first-touch, comme arena_init
+                free(a->base);
+                a->base = base;
+                a->cap  = cap;
+            }
+            a->recent = 0;
+            a->calm   = 0;
+        }
+    }
+    a->off  = 0;
+    a->used = 0;
+}
+
+// Texte formaté dans l'arène ; renvoie sa longueur, *out = "" si la mémoire manque
+static size_t arena_printf(arena_t *a, char **out, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    *out = n < 0 ? NULL : arena_alloc(a, n + 1);
+    if (!*out) {
+        *out = "";
+        return 0;
+    }
+    va_start(ap, fmt);
+    vsnprintf(*out, n + 1, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+static iobuf_t *iobuf_get(iobuf_pool_t *p)
+{
+    iobuf_t *b = p->free;
+    if (b) {
+        p->free = b->next;
+    } else if ((b = malloc(sizeof(*b))) != NULL) {
+        p->total++;
+    } else {
+        return NULL;
+    }
+    if (++p->in_use > p->high) {
+        p->high = p->in_use;
+    }
+    return b;
+}
+
+static void iobuf_put(iobuf_pool_t *p, iobuf_t *b)
+{
+    b->next = p->free;
+    p->free = b;
+    p->in_use--;
+}
+
+static conn_t *conn_get(conn_slab_t *s)
+{
+    if (!s->free) {
+        // Nouvelle tranche de CONN_SLAB connexions, chaînées dans la liste libre
+        conn_t *slab = calloc(CONN_SLAB, sizeof(*slab));
+        if (!slab) {
+            return NULL;
         }
+        for (int i = 0; i < CONN_SLAB; i++) {
+            slab[i].next = i + 1 < CONN_SLAB ? &slab[i + 1] : NULL;
+        }
+        s->free   = slab;
+        s->total += CONN_SLAB;
+    }
+    conn_t *c = s->free;
+    s->free = c->next;
+    if (++s->in_use > s->high) {
+        s->high = s->in_use;
     }
-    return prefix_len;
+    return c;
+}
+
+static void conn_put(conn_slab_t *s, conn_t *c)
+{
+    c->next = s->free;
+    s->free = c;
+    s->in_use--;
+}
+
+// Publie les compteurs du worker (lus par "-s" depuis un autre worker)
+static void worker_publish_stats(worker_t *w)
+{
+    worker_stats_t *st = &w->stats;
+    __atomic_store_n(&st->requests, st->requests + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->arena_cap, w->arena.cap, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->arena_high, w->arena.high, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->arena_overflows, w->arena.overflows, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->conn_high, w->conns.high, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->conn_total, w->conns.total, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->iobuf_high, w->pool.high, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->iobuf_total, w->pool.total, __ATOMIC_RELAXED);
+}
+
+/* ---------- Instantanés ---------- */
+
+static void snapshot_free(snapshot_t *s)
+{
+    for (size_t k = 0; k < RENDER_KINDS * 2; k++) {
+        render_slot_t *slot = &s->all[k];
+        if (slot->fd >= 0) {
+            munmap(slot->buf, slot->len);
+            close(slot->fd);
+        } else {
+            free(slot->buf);
+        }
+    }
+    iftrie_free(&s->trie);
+    free(s->snap.recs);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->ready);
+    free(s);
+}
+
+// Nouvel instantané, ou NULL en cas d'erreur (l'ancien reste publié)
+static snapshot_t *snapshot_build(const snapshot_t *prev)
+{
+    snapshot_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    // Arène dimensionnée sur l'instantané précédent : un seul dump en général
+    if (prev && prev->snap.count > 0) {
+        s->snap.cap  = prev->snap.count + prev->snap.count / 4 + 16;
+        s->snap.recs = malloc(s->snap.cap * sizeof(*s->snap.recs));
+        if (!s->snap.recs) {
+            s->snap.cap = 0;
+        }
+    }
+    if (ifsnap_collect_alloc(&s->snap, NULL) < 0) {
+        free(s->snap.recs);
+        free(s);
+        return NULL;
+    }
+    iftrie_init(&s->trie);
+    ifsnap_to_trie(&s->snap, &s->trie);
+    iftrie_build(&s->trie);
+    s->gen = prev ? prev->gen + 1 : 1;
+    for (size_t k = 0; k < RENDER_KINDS * 2; k++) {
+        s->all[k].fd = -1;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->ready, NULL);
+    return s;
 }
 
 /*
- * Ajoute à outbuf la chaîne "addr/prefix" ou "addr (prefix inconnu)".
+ * Lecture de l'instantané courant par le worker 'w' : le pointeur de
+ * danger est posé puis revérifié, le rafraîchisseur ne peut donc plus
+ * libérer cet instantané avant snapshot_release().
  */
-static void append_address_with_prefix(int family,
-                                       const void *addr,
-                                       const void *netmask,
-                                       char *outbuf,
-                                       size_t outbuf_len) 
+static snapshot_t *snapshot_acquire(int w)
 {
-    char addr_str[INET6_ADDRSTRLEN] = {0};
+    snapshot_t *s;
+    do {
+        s = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&hazard[w].s, s, __ATOMIC_SEQ_CST);
+    } while (s != __atomic_load_n(&current, __ATOMIC_SEQ_CST));
+    return s;
+}
 
-    if (!addr) return;
+static void snapshot_release(int w)
+{
+    __atomic_store_n(&hazard[w].s, NULL, __ATOMIC_RELEASE);
+}
 
-    // Convertit l'adresse en chaîne
-    inet_ntop(family, addr, addr_str, sizeof(addr_str));
+// Libère les instantanés retirés qu'aucun worker ne tient plus
+static void snapshot_reclaim(void)
+{
+    snapshot_t **pp = &retired;
+    while (*pp) {
+        snapshot_t *r = *pp;
+        int held = 0;
+        for (int w = 0; w < nworkers && !held; w++) {
+            held = __atomic_load_n(&hazard[w].s, __ATOMIC_SEQ_CST) == r;
+        }
+        if (held) {
+            pp = &r->retired_next;
+        } else {
+            *pp = r->retired_next;
+            snapshot_free(r);
+        }
+    }
+}
 
-    // Si pas de netmask => pas de prefix
-    if (!netmask) {
-        snprintf(outbuf + strlen(outbuf),
-                 outbuf_len - strlen(outbuf),
-                 "%s (prefix inconnu)\n", addr_str);
-        return;
+static void snapshot_publish(snapshot_t *s)
+{
+    snapshot_t *old = __atomic_exchange_n(&current, s, __ATOMIC_SEQ_CST);
+    if (old) {
+        old->retired_next = retired;
+        retired = old;
     }
+    snapshot_reclaim();
+}
 
-    // Calcul du prefix (en supposant un masque contigu)
-    int prefix_len = 0;
-    if (family == AF_INET) {
-        prefix_len = count_prefix_len(netmask, 4);
+/*
+ * Recopie le rendu 'buf' (alloué) dans un memfd scellé et rend sa
+ * projection, 'buf' étant libéré ; *fd reste à -1 et 'buf' est rendu
+ * tel quel si le memfd est impossible.
+ */
+static char *render_seal(char *buf, size_t len, int *fd)
+{
+    *fd = -1;
+    if (len == 0) {
+        return buf;
+    }
+    int mfd = memfd_create("ifnetshow-all", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0) {
+        return buf;
+    }
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = write(mfd, buf + off, len - off);
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
+    char *map = MAP_FAILED;
+    if (off == len &&
+        fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0) {
+        map = mmap(NULL, len, PROT_READ, MAP_SHARED, mfd, 0);
+    }
+    if (map == MAP_FAILED) {
+        close(mfd);
+        return buf;
+    }
+    free(buf);
+    *fd = mfd;
+    return map;
+}
+
+/*
+ * Rendu "-a" au format 'kind', compressé si 'deflate' : calculé par le
+ * premier demandeur, les requêtes simultanées attendent le même résultat
+ * (single-flight).
+ */
+static const render_slot_t *render_all(snapshot_t *s, size_t kind, int deflate)
+{
+    const render_slot_t *plain = NULL;
+    if (deflate) {
+        // La version compressée part du rendu en clair ; petite : pas compressée
+        plain = render_all(s, kind, 0);
+        if (!plain->buf || plain->len < IFZ_MIN_SIZE) {
+            return plain;
+        }
+    }
+
+    render_slot_t *slot = &s->all[kind * 2 + deflate];
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == RENDER_READY) {
+        return slot;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    while (slot->state == RENDER_BUSY) {
+        pthread_cond_wait(&s->ready, &s->lock);
+    }
+    if (slot->state == RENDER_READY) {
+        pthread_mutex_unlock(&s->lock);
+        return slot;
+    }
+    __atomic_store_n(&slot->state, RENDER_BUSY, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s->lock);
+
+    // Rendu hors verrou : les autres formats restent disponibles
+    char *buf = NULL;
+    size_t len;
+    if (deflate) {
+        len = ifz_compress(plain->buf, plain->len, &buf);
     } else {
-        prefix_len = count_prefix_len(netmask, 16);
+        ifsnap_render_fn render = ifsnap_renderers[kind].fn;
+        len = render(&s->snap, 1, NULL, 0);
+        buf = malloc(len + 1);
+        if (buf) {
+            render(&s->snap, 1, buf, len + 1);
+        }
+    }
+    if (!buf && plain) {
+        pthread_mutex_lock(&s->lock);
+        __atomic_store_n(&slot->state, RENDER_EMPTY, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&s->ready);
+        pthread_mutex_unlock(&s->lock);
+        return plain; // compression impossible : réponse en clair
     }
 
-    // Ajout au buffer
-    snprintf(outbuf + strlen(outbuf),
-             outbuf_len - strlen(outbuf),
-             "%s/%d\n", addr_str, prefix_len);
+    int fd = -1;
+    if (buf) {
+        buf = render_seal(buf, len, &fd);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    slot->buf = buf;
+    slot->len = buf ? len : 0;
+    slot->fd  = fd;
+    __atomic_store_n(&slot->state, RENDER_READY, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+    return slot;
 }
 
 /*
- * Récupère toutes les interfaces, formate le résultat dans 'outbuf'.
+ * "-i ifname" : adresses de l'interface, extraites de l'instantané dans
+ * une vue à leur taille puis rendues, le tout dans l'arène de la requête.
+ * Renvoie la longueur, la réponse dans *out.
  */
-static void get_all_interfaces(char *outbuf, size_t outbuf_len)
+static size_t get_one_interface(arena_t *a, const snapshot_t *s, const char *ifname,
+                                ifsnap_render_fn render, char **out)
 {
-    struct ifaddrs *ifaddr, *ifa;
-    if (getifaddrs(&ifaddr) == -1) {
-        snprintf(outbuf, outbuf_len, "Erreur getifaddrs\n");
-        return;
+    size_t count = 0;
+    for (size_t i = 0; i < s->snap.count; i++) {
+        count += strncmp(s->snap.recs[i].ifname, ifname, IF_NAMESIZE) == 0;
+    }
+
+    // Si rien n'a été trouvé => interface introuvable ou sans IP
+    if (count == 0 && render == ifsnap_render_text) {
+        return arena_printf(a, out, "Aucune adresse pour l'interface %s\n", ifname);
     }
 
-    outbuf[0] = '\0';
+    ifsnap_t v = { .recs = arena_alloc(a, count * sizeof(*v.recs)), .cap = count };
+    if (!v.recs) {
+        return arena_printf(a, out, "Réponse trop volumineuse\n");
+    }
+    for (size_t i = 0; i < s->snap.count && v.count < count; i++) {
+        if (strncmp(s->snap.recs[i].ifname, ifname, IF_NAMESIZE) == 0) {
+            v.recs[v.count++] = s->snap.recs[i];
+        }
+    }
+    v.needed = v.count;
 
-    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
-        if (!ifa->ifa_name || !ifa->ifa_addr) continue;
+    size_t len = render(&v, 0, NULL, 0);
+    *out = arena_alloc(a, len + 1);
+    if (!*out) {
+        return arena_printf(a, out, "Réponse trop volumineuse\n");
+    }
+    render(&v, 0, *out, len + 1);
+    return len;
+}
 
-        int family = ifa->ifa_addr->sa_family;
-        if (family == AF_INET || family == AF_INET6) {
-            void *addr_ptr = NULL;
-            void *mask_ptr = NULL;
+/*
+ * "-o ip [ip...]" : interface qui possède ou dessert chaque adresse,
+ * une ligne par adresse (format : iftrie.h).
+ */
+static void get_owner(const iftrie_t *trie, const char *ips, char *outbuf, size_t outbuf_len)
+{
+    size_t off = 0;
+    while (*ips) {
+        ips += strspn(ips, " \t\r\n");
+        size_t len = strcspn(ips, " \t\r\n");
+        if (len == 0) {
+            break;
+        }
+        size_t n = iftrie_answer(trie, ips, len, outbuf + off, outbuf_len - off);
+        if (n == 0) {
+            break; // réponse pleine
+        }
+        off += n;
+        ips += len;
+    }
+    outbuf[off] = '\0';
 
-            if (family == AF_INET) {
-                struct sockaddr_in *sin = (struct sockaddr_in*)ifa->ifa_addr;
-                struct sockaddr_in *msk = (struct sockaddr_in*)ifa->ifa_netmask;
-                addr_ptr = &sin->sin_addr;
-                mask_ptr = msk ? &msk->sin_addr : NULL;
+    if (off == 0) {
+        snprintf(outbuf, outbuf_len, "Aucune adresse demandée\n");
+    }
+}
+
+/* ---------- Rafraîchissement ---------- */
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Vide le socket de notifications ; 1 si un changement (ou une perte) a eu lieu
+static int drain_events(int evfd)
+{
+    char buf[NL_BUFSIZE];
+    ssize_t len;
+    int changed = 0;
+    while ((len = recv(evfd, buf, sizeof(buf), MSG_DONTWAIT)) > 0 ||
+           (len < 0 && errno == ENOBUFS)) {
+        changed = 1;
+    }
+    return changed;
+}
+
+static void *refresher(void *arg)
+{
+    int evfd = *(int *)arg;
+    uint64_t last = now_ms();
+
+    for (;;) {
+        // Sans notifications : rafraîchissement chaque seconde
+        int timeout = evfd < 0 ? 1000 : retired ? 1000 : REFRESH_MS;
+        int changed = 0;
+        if (evfd < 0) {
+            poll(NULL, 0, timeout);
+            changed = 1;
+        } else {
+            struct pollfd pfd = { evfd, POLLIN, 0 };
+            if (poll(&pfd, 1, timeout) > 0) {
+                // Rafale (script qui ajoute mille adresses) : un seul
+                // rafraîchissement, mais au plus DEBOUNCE_MAX_MS après le
+                // premier événement même si le flot ne s'arrête jamais
+                uint64_t first = now_ms();
+                do {
+                    changed |= drain_events(evfd);
+                } while (now_ms() - first < DEBOUNCE_MAX_MS &&
+                         poll(&pfd, 1, DEBOUNCE_MS) > 0);
+            }
+            changed |= now_ms() - last >= REFRESH_MS;
+        }
+
+        if (changed) {
+            snapshot_t *s = snapshot_build(current);
+            if (s) {
+                snapshot_publish(s);
             } else {
-                struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)ifa->ifa_addr;
-                struct sockaddr_in6 *msk6 = (struct sockaddr_in6*)ifa->ifa_netmask;
-                addr_ptr = &sin6->sin6_addr;
-                mask_ptr = msk6 ? &msk6->sin6_addr : NULL;
+                perror("rtnetlink");
             }
+            last = now_ms();
+        }
+        snapshot_reclaim();
+    }
+    return NULL;
+}
 
-            // On écrit "ifname: addr/prefix" (ou ...prefix inconnu)
-            snprintf(outbuf + strlen(outbuf),
-                     outbuf_len - strlen(outbuf),
-                     "%s: ", ifa->ifa_name);
+/* ---------- Workers ---------- */
 
-            append_address_with_prefix(family, addr_ptr, mask_ptr,
-                                       outbuf, outbuf_len);
+static void send_all(int connfd, const char *buf, size_t len)
+{
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = write(connfd, buf + off, len - off);
+        if (n <= 0) {
+            break;
         }
+        off += n;
     }
+}
 
-    freeifaddrs(ifaddr);
+// Rendu gardé dans un memfd : le noyau envoie directement ses pages
+static void send_file(int connfd, int fd, size_t len)
+{
+    off_t off = 0;
+    while ((size_t)off < len) {
+        if (sendfile(connfd, fd, &off, len - off) <= 0) {
+            break;
+        }
+    }
 }
 
 /*
- * Récupère uniquement l'interface nommée 'ifname'.
+ * Envoi en MSG_ZEROCOPY : le noyau lit 'buf' jusqu'à l'acquittement
+ * des données, on attend donc que tous les envois soient notifiés
+ * terminés sur la file d'erreurs avant de rendre la main (le buffer
+ * du worker sert à la requête suivante). Repli sur write() si le
+ * socket ne le permet pas.
  */
-static void get_one_interface(const char *ifname, char *outbuf, size_t outbuf_len)
+static void send_zerocopy(int connfd, const char *buf, size_t len)
 {
-    struct ifaddrs *ifaddr, *ifa;
-    if (getifaddrs(&ifaddr) == -1) {
-        snprintf(outbuf, outbuf_len, "Erreur getifaddrs\n");
+    int one = 1;
+    if (setsockopt(connfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        send_all(connfd, buf, len);
         return;
     }
 
-    outbuf[0] = '\0';
-
-    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
-        if (!ifa->ifa_name || !ifa->ifa_addr) continue;
+    // Le noyau numérote 0, 1, ... chaque send() MSG_ZEROCOPY accepté
+    uint32_t sent = 0, done = 0;
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = send(connfd, buf + off, len - off, MSG_ZEROCOPY);
+        if (n < 0 && errno == ENOBUFS) {
+            // Trop de notifications en attente : ce morceau est copié
+            n = send(connfd, buf + off, len - off, 0);
+        } else if (n > 0) {
+            sent++;
+        }
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
 
-        if (strcmp(ifa->ifa_name, ifname) != 0) {
+    uint64_t deadline = now_ms() + CLIENT_TIMEOUT_S * 1000;
+    while (done < sent) {
+        uint64_t now = now_ms();
+        struct pollfd pfd = { connfd, 0, 0 }; // POLLERR toujours rapporté
+        if (now >= deadline || poll(&pfd, 1, deadline - now) <= 0) {
+            break;
+        }
+        char control[128];
+        struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof(control) };
+        if (recvmsg(connfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            // Erreur du socket (connexion coupée) et non notification : on l'acquitte
+            int err;
+            socklen_t errlen = sizeof(err);
+            getsockopt(connfd, SOL_SOCKET, SO_ERROR, &err, &errlen);
             continue;
         }
-
-        int family = ifa->ifa_addr->sa_family;
-        if (family == AF_INET || family == AF_INET6) {
-            void *addr_ptr = NULL;
-            void *mask_ptr = NULL;
-
-            if (family == AF_INET) {
-                struct sockaddr_in *sin = (struct sockaddr_in*)ifa->ifa_addr;
-                struct sockaddr_in *msk = (struct sockaddr_in*)ifa->ifa_netmask;
-                addr_ptr = &sin->sin_addr;
-                mask_ptr = msk ? &msk->sin_addr : NULL;
-            } else {
-                struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)ifa->ifa_addr;
-                struct sockaddr_in6 *msk6 = (struct sockaddr_in6*)ifa->ifa_netmask;
-                addr_ptr = &sin6->sin6_addr;
-                mask_ptr = msk6 ? &msk6->sin6_addr : NULL;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                done += ee->ee_data - ee->ee_info + 1; // envois ee_info..ee_data terminés
             }
-
-            append_address_with_prefix(family, addr_ptr, mask_ptr,
-                                       outbuf, outbuf_len);
         }
     }
+    if (done < sent) {
+        // Client muet : RST, la file d'envoi est purgée et le buffer relâché
+        struct linger lg = { 1, 0 };
+        setsockopt(connfd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    }
+}
 
-    freeifaddrs(ifaddr);
+// "-s" : compteurs mémoire de chaque worker, une ligne chacun
+#define STATS_LINE 192
 
-    // Si rien n'a été écrit => interface introuvable ou sans IP
-    if (strlen(outbuf) == 0) {
-        snprintf(outbuf, outbuf_len,
-                 "Aucune adresse pour l'interface %s\n", ifname);
+static size_t get_stats(arena_t *a, char **out)
+{
+    size_t cap = (size_t)nworkers * STATS_LINE, len = 0;
+    *out = arena_alloc(a, cap);
+    if (!*out) {
+        return arena_printf(a, out, "Réponse trop volumineuse\n");
     }
+    for (int i = 0; i < nworkers && len < cap; i++) {
+        const worker_stats_t *st = &workers[i].stats;
+        int n = snprintf(*out + len, cap - len,
+            "worker %d : %lu requêtes, arène %zu o (max %zu o, %lu débordements), "
+            "connexions max %lu/%lu, buffers E/S max %lu/%lu\n", i,
+            __atomic_load_n(&st->requests, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->arena_cap, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->arena_high, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->arena_overflows, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->conn_high, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->conn_total, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->iobuf_high, __ATOMIC_RELAXED),
+            __atomic_load_n(&st->iobuf_total, __ATOMIC_RELAXED));
+        if (n < 0) {
+            break;
+        }
+        len += (size_t)n < cap - len ? (size_t)n : cap - len - 1;
+    }
+    return len;
 }
 
 /*
- * Le serveur TCP qui reçoit une requête, ex: "-a" ou "-i eth0",
- * exécute localement la logique (get_all_interfaces ou get_one_interface)
- * et renvoie le résultat.
+ * Traite une connexion : lit la requête, exécute la logique sur
+ * l'instantané courant et renvoie le résultat. Tout ce que la requête
+ * alloue vient de l'arène du worker, rendue par l'appelant.
  */
-int main(void)
+static void handle_client(worker_t *w, conn_t *c)
 {
-    int listenfd, connfd;
-    struct sockaddr_in servaddr, cliaddr;
-    socklen_t cli_len = sizeof(cliaddr);
+    arena_t *a = &w->arena;
+    int connfd = c->fd;
+    char *request = c->in->data;
 
-    // Ignorer SIGPIPE (si le client ferme brutalement)
-    signal(SIGPIPE, SIG_IGN);
+    // On lit la requête du client
+    ssize_t r = read(connfd, request, IOBUF_SIZE - 1);
+    if (r <= 0) {
+        return;
+    }
+    request[r] = '\0';
+
+    // request peut être "-a", "-i <ifname>" ou "-o <ip>...",
+    // "-a" et "-i" suivis ou non de "-format <f>" et "-compress <méthodes>"
+    size_t kind = 0; // text
+    int deflate = 0;
+    char fmt_name[16] = "";
+    char *fmt = NULL, *cz = NULL;
+    if (strncmp(request, "-o ", 3) != 0) {
+        fmt = strstr(request, " -format ");
+        cz  = strstr(request, " -compress ");
+    }
+    if (cz) {
+        // Liste de méthodes acceptées par le client, p.ex. "lz4,deflate"
+        char methods[64] = "";
+        sscanf(cz + 11, "%63s", methods);
+        char *save = NULL;
+        for (char *m = strtok_r(methods, ",", &save); m; m = strtok_r(NULL, ",", &save)) {
+            deflate |= strcmp(m, IFZ_METHOD) == 0;
+        }
+    }
+    if (fmt) {
+        sscanf(fmt + 9, "%15s", fmt_name);
+        for (kind = 0; kind < RENDER_KINDS; kind++) {
+            if (strcmp(ifsnap_renderers[kind].name, fmt_name) == 0) {
+                break;
+            }
+        }
+    }
+    if (fmt) {
+        *fmt = '\0';
+    }
+    if (cz) {
+        *cz = '\0';
+    }
+
+    snapshot_t *s = snapshot_acquire(w->id);
+    char *out;
+    int outfd = -1;
+    size_t len;
+    if (kind == RENDER_KINDS) {
+        len = arena_printf(a, &out, "Format inconnu: %s\n", fmt_name);
+    }
+    else if (strncmp(request, "-a", 2) == 0) {
+        // Liste de TOUTES les interfaces : rendu partagé de l'instantané
+        const render_slot_t *slot = render_all(s, kind, deflate);
+        if (slot->buf) {
+            out   = slot->buf;
+            len   = slot->len;
+            outfd = slot->fd;
+        } else {
+            len = arena_printf(a, &out, "Réponse trop volumineuse\n");
+        }
+    }
+    else if (strncmp(request, "-i ", 3) == 0) {
+        // -i ifname
+        char ifn[128];
+        memset(ifn, 0, sizeof(ifn));
+        sscanf(request + 3, "%127s", ifn);
+        len = get_one_interface(a, s, ifn, ifsnap_renderers[kind].fn, &out);
+        // Réponse propre à la requête : compressée à la volée
+        char *zbuf;
+        size_t zlen;
+        if (deflate && len >= IFZ_MIN_SIZE &&
+            (zbuf = arena_alloc(a, ifz_bound(len))) != NULL &&
+            (zlen = ifz_compress_into(out, len, zbuf, ifz_bound(len))) > 0) {
+            out = zbuf;
+            len = zlen;
+        }
+    }
+    else if (strncmp(request, "-o ", 3) == 0) {
+        // -o ip [ip...]
+        out = arena_alloc(a, OWNER_SIZE);
+        if (out) {
+            get_owner(&s->trie, request + 3, out, OWNER_SIZE);
+            len = strlen(out);
+        } else {
+            len = arena_printf(a, &out, "Réponse trop volumineuse\n");
+        }
+    }
+    else if (strcmp(request, "-s") == 0) {
+        len = get_stats(a, &out);
+    }
+    else {
+        len = arena_printf(a, &out, "Requête invalide: %s\n", request);
+    }
+
+    // On renvoie la réponse (l'instantané reste tenu jusque-là)
+    if (outfd >= 0) {
+        send_file(connfd, outfd, len);
+    } else if (len >= ZEROCOPY_MIN) {
+        send_zerocopy(connfd, out, len);
+    } else {
+        send_all(connfd, out, len);
+    }
+    snapshot_release(w->id);
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    struct timeval tv = { CLIENT_TIMEOUT_S, 0 };
 
-    listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    // Placement d'abord : les buffers touchés ensuite sont sur le nœud local
+    if (w->cpu >= 0 && cpu_pin_self(w->cpu) != 0) {
+        fprintf(stderr, "Worker %d : placement sur le cœur %d impossible\n", w->id, w->cpu);
+    }
+    if (arena_init(&w->arena, ARENA_SIZE) < 0) {
+        perror("malloc");
+        exit(1);
+    }
+
+    // Faible latence : socket d'écoute non bloquant, attente par epoll en busy polling
+    int epfd = -1;
+    if (busy_poll_usec > 0) {
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE };
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, w->listenfd, &ev) < 0) {
+            perror("epoll");
+            exit(1);
+        }
+        busy_poll_epoll(epfd, busy_poll_usec);
+    }
+
+    // Boucle: accepte un client, lit une requête, répond, ferme.
+    for (;;) {
+        if (epfd >= 0) {
+            struct epoll_event ev;
+            if (epoll_wait(epfd, &ev, 1, -1) <= 0) {
+                continue;
+            }
+        }
+        int connfd = accept(w->listenfd, NULL, NULL);
+        if (connfd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                perror("accept");
+            }
+            continue;
+        }
+        // Un client lent n'immobilise pas le worker indéfiniment
+        setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        conn_t *c = conn_get(&w->conns);
+        iobuf_t *in = c ? iobuf_get(&w->pool) : NULL;
+        if (in) {
+            c->fd = connfd;
+            c->in = in;
+            handle_client(w, c);
+            iobuf_put(&w->pool, in);
+        }
+        if (c) {
+            conn_put(&w->conns, c);
+        }
+
+        // Ferme la connexion, rend la mémoire de la requête
+        close(connfd);
+        arena_reset(&w->arena);
+        worker_publish_stats(w);
+    }
+    return NULL;
+}
+
+// Socket d'écoute partagé par tous les workers (sans -cpus)
+static int listen_shared(void)
+{
+    struct sockaddr_in servaddr;
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
     if (listenfd < 0) {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     // Autorise la réutilisation du port
@@ -195,64 +1037,148 @@ int main(void)
     if (bind(listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
         perror("bind");
         close(listenfd);
-        return 1;
+        return -1;
     }
 
-    if (listen(listenfd, 5) < 0) {
+    // File d'attente large : un balayage du parc arrive d'un coup
+    if (listen(listenfd, SOMAXCONN) < 0) {
         perror("listen");
         close(listenfd);
-        return 1;
+        return -1;
     }
+    return listenfd;
+}
 
-    printf("Agent ifshow-like en écoute sur le port %d...\n", SERVER_PORT);
-
-    // Boucle: accepte un client, lit une requête, répond, ferme.
-    while (1) {
-        connfd = accept(listenfd, (struct sockaddr*)&cliaddr, &cli_len);
-        if (connfd < 0) {
-            perror("accept");
-            continue;
+/*
+ * Un socket d'écoute SO_REUSEPORT par worker, dans l'ordre des workers
+ * (indices du groupe), puis le programme d'aiguillage par cœur.
+ */
+static int listen_per_cpu(worker_t *workers, const int *cpus)
+{
+    for (int i = 0; i < nworkers; i++) {
+        int fd = reuseport_socket(SOCK_STREAM, SERVER_PORT, cpus[i]);
+        if (fd < 0) {
+            return -1;
+        }
+        if (listen(fd, SOMAXCONN) < 0) {
+            perror("listen");
+            close(fd);
+            return -1;
         }
+        workers[i].listenfd = fd;
+    }
+    if (reuseport_steer(workers[0].listenfd, cpus, nworkers) < 0) {
+        perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)"); // hachage du flux à la place
+    }
+    return 0;
+}
 
-        char request[BUF_SIZE];
-        memset(request, 0, sizeof(request));
+/*
+ * Le serveur TCP : un thread de rafraîchissement et 'nworkers' workers,
+ * sur un socket d'écoute commun ou un par cœur (-cpus).
+ */
+int main(int argc, char *argv[])
+{
+    static int cpus[MAX_WORKERS];
+    int ncpus = 0;
 
-        // On lit la requête du client
-        ssize_t r = read(connfd, request, sizeof(request)-1);
-        if (r <= 0) {
-            close(connfd);
-            continue;
+    nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-cpus") == 0 && i + 1 < argc) {
+            ncpus = cpu_list_parse(argv[++i], cpus, MAX_WORKERS);
+            if (ncpus <= 0) {
+                fprintf(stderr, "Liste de cœurs invalide: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-busypoll") == 0 && i + 1 < argc) {
+            busy_poll_usec = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-w workers] [-cpus liste|auto] [-busypoll usec]\n",
+                    argv[0]);
+            return 1;
         }
+    }
+    // Avec -cpus : un worker par cœur listé
+    if (ncpus > 0) {
+        nworkers = ncpus;
+    }
+    if (nworkers < 1) {
+        nworkers = 1;
+    }
+    if (nworkers > MAX_WORKERS) {
+        nworkers = MAX_WORKERS;
+    }
 
-        // request peut être "-a" ou "-i <ifname>"
-        // On prépare la réponse
-        char response[BUF_SIZE * 4]; // plus grand si besoin
-        memset(response, 0, sizeof(response));
+    // Ignorer SIGPIPE (si le client ferme brutalement)
+    signal(SIGPIPE, SIG_IGN);
 
-        // On regarde le début de la requête
-        if (strncmp(request, "-a", 2) == 0) {
-            // Liste de TOUTES les interfaces
-            get_all_interfaces(response, sizeof(response));
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].id  = i;
+        workers[i].cpu = ncpus > 0 ? cpus[i] : -1;
+    }
+    if (ncpus > 0) {
+        if (listen_per_cpu(workers, cpus) < 0) {
+            return 1;
         }
-        else if (strncmp(request, "-i ", 3) == 0) {
-            // -i ifname
-            char ifn[128];
-            memset(ifn, 0, sizeof(ifn));
-            sscanf(request + 3, "%127s", ifn);
-            get_one_interface(ifn, response, sizeof(response));
+    } else {
+        int listenfd = listen_shared();
+        if (listenfd < 0) {
+            return 1;
         }
-        else {
-            snprintf(response, sizeof(response),
-                     "Requête invalide: %s\n", request);
+        for (int i = 0; i < nworkers; i++) {
+            workers[i].listenfd = listenfd;
         }
+    }
+    if (busy_poll_usec > 0) {
+        for (int i = 0; i < nworkers; i++) {
+            if (i > 0 && workers[i].listenfd == workers[0].listenfd) {
+                break; // socket commun, déjà réglé
+            }
+            if (busy_poll_socket(workers[i].listenfd, busy_poll_usec) < 0) {
+                return 1;
+            }
+            fcntl(workers[i].listenfd, F_SETFL, O_NONBLOCK);
+        }
+    }
 
-        // On renvoie la réponse
-        write(connfd, response, strlen(response));
+    // Abonnement avant le premier instantané : aucun changement perdu entre les deux
+    static int evfd;
+    evfd = nl_open(RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR);
 
-        // Ferme la connexion
-        close(connfd);
+    snapshot_t *first = snapshot_build(NULL);
+    if (!first) {
+        perror("rtnetlink");
+        return 1;
+    }
+    snapshot_publish(first);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, refresher, &evfd) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+
+    for (int i = 0; i < nworkers; i++) {
+        pthread_t wtid;
+        if (pthread_create(&wtid, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+        if (workers[i].cpu >= 0) {
+            printf("Worker %d : cœur %d (nœud %d)\n", i, workers[i].cpu,
+                   cpu_node(workers[i].cpu));
+        }
+    }
+
+    printf("Agent ifshow-like en écoute sur le port %d (%d workers)...\n",
+           SERVER_PORT, nworkers);
+    if (busy_poll_usec > 0) {
+        printf("Busy polling : %d µs\n", busy_poll_usec);
     }
+    fflush(stdout);
 
-    close(listenfd);
+    pthread_join(tid, NULL);
     return 0;
 }
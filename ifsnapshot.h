@@ -0,0 +1,336 @@
+/****************************************************
+ * ifsnapshot.h
+ *
+ * Énumération des adresses des interfaces, partagée par
+ * Ifshow.c et ifnetshowserv.c (simple inclusion, après
+ * nlutil.h).
+ *
+ *  - ifsnap_collect() : un dump RTM_GETLINK (noms) puis un
+ *    dump RTM_GETADDR sur le même socket. Pour une seule
+ *    interface, le noyau filtre lui-même le dump d'adresses
+ *    (NETLINK_GET_STRICT_CHK + ifa_index) et le dump des
+ *    liens est inutile.
+ *  - une adresse IPv4 avec une étiquette (alias "eth0:1",
+ *    IFA_LABEL) porte cette étiquette comme nom, comme
+ *    getifaddrs() ; le filtre "eth0:1" ne retient qu'elle,
+ *    le filtre "eth0" ne la retient pas.
+ *  - les adresses sont rangées, dans l'ordre du dump, dans
+ *    une arène fournie par l'appelant : un tableau compact
+ *    d'enregistrements de taille fixe, réutilisable d'un
+ *    appel à l'autre, sans allocation par adresse.
+ *  - rendus interchangeables (ifsnap_renderer("text"),
+ *    "json", "bin") qui écrivent dans un buffer de
+ *    l'appelant et renvoient la taille nécessaire, comme
+ *    snprintf() :
+ *      text : "eth0: 10.0.0.5/24" (ou "10.0.0.5/24" sans
+ *             nom), le format historique de -a / -i ;
+ *      json : [{"ifname":"eth0","family":"inet",...}] ;
+ *      bin  : en-tête "IFADDR1\0", u32 nombre, u32 taille
+ *             d'un enregistrement, puis les enregistrements
+ *             tels quels (ordre des octets de l'émetteur).
+ ****************************************************/
+
+#ifndef IFSNAPSHOT_H
+#define IFSNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <net/if.h>
+
+#define IFSNAP_MAGIC "IFADDR1"  // 8 octets avec le '\0' final
+
+typedef struct {
+    char          ifname[IF_NAMESIZE];
+    uint32_t      ifindex;
+    uint8_t       family;     // AF_INET ou AF_INET6
+    uint8_t       prefixlen;
+    uint8_t       scope;      // RT_SCOPE_*
+    uint8_t       reserved;
+    uint32_t      flags;      // IFA_F_*
+    unsigned char addr[16];
+} ifsnap_rec_t;
+
+typedef struct {
+    ifsnap_rec_t *recs;    // arène de l'appelant
+    size_t        cap;     // en enregistrements
+    size_t        count;   // enregistrements rangés (<= cap)
+    size_t        needed;  // adresses rencontrées : > cap si l'arène est trop petite
+} ifsnap_t;
+
+typedef struct {
+    char      magic[8];
+    uint32_t  count;
+    uint32_t  rec_size;
+} ifsnap_bin_hdr_t;
+
+/* ---------- Énumération ---------- */
+
+typedef struct {
+    ifsnap_t *snap;
+    char    (*names)[IF_NAMESIZE];  // indexé par ifindex
+    int       names_cap;
+    int       ifindex;              // filtre, 0 = toutes
+    const char *ifname;             // nom du filtre (étiquette éventuelle comprise)
+    char      link[IF_NAMESIZE];    // nom du lien filtré (avant le ':')
+} ifsnap_ctx_t;
+
+static int ifsnap_link_cb(struct nlmsghdr *nh, void *ctx) {
+    ifsnap_ctx_t *c = ctx;
+    if (nh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtattr *tb[IFLA_MAX + 1];
+    nl_parse_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(nh));
+    if (ifi->ifi_index <= 0 || !tb[IFLA_IFNAME]) {
+        return 0;
+    }
+    if (ifi->ifi_index >= c->names_cap) {
+        int cap = c->names_cap ? c->names_cap : 64;
+        while (cap <= ifi->ifi_index) {
+            cap *= 2;
+        }
+        char (*names)[IF_NAMESIZE] = realloc(c->names, cap * sizeof(*names));
+        if (!names) {
+            return -1;
+        }
+        memset(names + c->names_cap, 0, (cap - c->names_cap) * sizeof(*names));
+        c->names     = names;
+        c->names_cap = cap;
+    }
+    snprintf(c->names[ifi->ifi_index], IF_NAMESIZE, "%s", (char *)RTA_DATA(tb[IFLA_IFNAME]));
+    return 0;
+}
+
+static int ifsnap_addr_cb(struct nlmsghdr *nh, void *ctx) {
+    ifsnap_ctx_t *c = ctx;
+    if (nh->nlmsg_type != RTM_NEWADDR) {
+        return 0;
+    }
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    // Le filtre noyau peut manquer (noyau < 4.20) : vérifié ici aussi
+    if ((ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6) ||
+        (c->ifindex && (int)ifa->ifa_index != c->ifindex)) {
+        return 0;
+    }
+    struct rtattr *tb[IFA_MAX + 1];
+    nl_parse_attrs(tb, IFA_MAX, IFA_RTA(ifa), IFA_PAYLOAD(nh));
+    // IFA_LOCAL est l'adresse locale (IFA_ADDRESS est le pair en point à point)
+    struct rtattr *a = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+    if (!a) {
+        return 0;
+    }
+
+    // Nom : étiquette de l'adresse, sinon celui du lien
+    char name[IF_NAMESIZE] = {0}; // octets après le nul compris : copiés tels quels
+    if (tb[IFA_LABEL] && *(char *)RTA_DATA(tb[IFA_LABEL])) {
+        snprintf(name, sizeof(name), "%s", (char *)RTA_DATA(tb[IFA_LABEL]));
+    } else if (c->ifindex) {
+        memcpy(name, c->link, IF_NAMESIZE);
+    } else if ((int)ifa->ifa_index < c->names_cap && c->names[ifa->ifa_index][0]) {
+        memcpy(name, c->names[ifa->ifa_index], IF_NAMESIZE);
+    } else {
+        snprintf(name, sizeof(name), "if%u", ifa->ifa_index);
+    }
+    // Filtre par nom : "eth0" et "eth0:1" partagent le même ifindex
+    if (c->ifindex && strncmp(name, c->ifname, IF_NAMESIZE) != 0) {
+        return 0;
+    }
+
+    ifsnap_t *s = c->snap;
+    if (s->needed++ >= s->cap) {
+        return 0; // arène pleine : on compte seulement
+    }
+    ifsnap_rec_t *r = &s->recs[s->count++];
+    memset(r, 0, sizeof(*r));
+    memcpy(r->ifname, name, IF_NAMESIZE);
+    r->ifindex   = ifa->ifa_index;
+    r->family    = ifa->ifa_family;
+    r->prefixlen = ifa->ifa_prefixlen;
+    r->scope     = ifa->ifa_scope;
+    r->flags     = tb[IFA_FLAGS] ? *(uint32_t *)RTA_DATA(tb[IFA_FLAGS]) : ifa->ifa_flags;
+    memcpy(r->addr, RTA_DATA(a), r->family == AF_INET ? 4 : 16);
+    return 0;
+}
+
+/*
+ * Remplit l'arène s->recs (s->cap enregistrements) avec les adresses de
+ * toutes les interfaces, ou de 'ifname' seulement (un lien, ou une
+ * étiquette "lien:alias"). Renvoie 0 si le dump
+ * est complet (s->needed > s->cap : arène trop petite, à agrandir),
+ * -1 en cas d'erreur netlink. Interface inconnue : 0 adresse.
+ */
+static inline int ifsnap_collect(ifsnap_t *s, const char *ifname) {
+    s->count = s->needed = 0;
+
+    ifsnap_ctx_t c;
+    memset(&c, 0, sizeof(c));
+    c.snap = s;
+    if (ifname) {
+        snprintf(c.link, sizeof(c.link), "%.*s", (int)strcspn(ifname, ":"), ifname);
+        c.ifindex = if_nametoindex(c.link);
+        c.ifname  = ifname;
+        if (c.ifindex == 0) {
+            return 0;
+        }
+    }
+
+    int fd = nl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+    int rc = 0;
+    if (ifname) {
+        // Dump filtré par le noyau : seulement les adresses de ce lien
+        int one = 1;
+        setsockopt(fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &one, sizeof(one));
+        struct ifaddrmsg req;
+        memset(&req, 0, sizeof(req));
+        req.ifa_family = AF_UNSPEC;
+        req.ifa_index  = c.ifindex;
+        rc = nl_dump(fd, RTM_GETADDR, AF_UNSPEC, &req, sizeof(req), ifsnap_addr_cb, &c);
+    } else {
+        rc = nl_dump(fd, RTM_GETLINK, AF_UNSPEC, NULL, 0, ifsnap_link_cb, &c);
+        if (rc == 0) {
+            rc = nl_dump(fd, RTM_GETADDR, AF_UNSPEC, NULL, 0, ifsnap_addr_cb, &c);
+        }
+    }
+    close(fd);
+    free(c.names);
+    return rc;
+}
+
+/*
+ * Idem avec une arène sur le tas, agrandie au besoin et gardée d'un appel
+ * à l'autre (s->recs à libérer par l'appelant).
+ */
+static inline int ifsnap_collect_alloc(ifsnap_t *s, const char *ifname) {
+    for (;;) {
+        if (ifsnap_collect(s, ifname) < 0) {
+            return -1;
+        }
+        if (s->needed <= s->cap) {
+            return 0;
+        }
+        // Marge : des adresses peuvent apparaître entre deux dumps
+        size_t cap = s->needed + s->needed / 4 + 16;
+        ifsnap_rec_t *recs = realloc(s->recs, cap * sizeof(*recs));
+        if (!recs) {
+            return -1;
+        }
+        s->recs = recs;
+        s->cap  = cap;
+    }
+}
+
+/* ---------- Rendus ---------- */
+
+// Tous les rendus : au plus 'outlen' octets écrits (terminés par '\0' pour
+// le texte et le JSON), taille complète renvoyée, comme snprintf()
+typedef size_t (*ifsnap_render_fn)(const ifsnap_t *s, int with_name,
+                                   char *out, size_t outlen);
+
+static inline size_t ifsnap_put(char *out, size_t outlen, size_t off,
+                                const char *src, size_t len)
+{
+    if (off < outlen) {
+        size_t n = len < outlen - off ? len : outlen - off;
+        memcpy(out + off, src, n);
+    }
+    return off + len;
+}
+
+static inline void ifsnap_terminate(char *out, size_t outlen, size_t off) {
+    if (outlen > 0) {
+        out[off < outlen ? off : outlen - 1] = '\0';
+    }
+}
+
+static size_t ifsnap_render_text(const ifsnap_t *s, int with_name, char *out, size_t outlen) {
+    size_t off = 0;
+    for (size_t i = 0; i < s->count; i++) {
+        const ifsnap_rec_t *r = &s->recs[i];
+        char line[IF_NAMESIZE + INET6_ADDRSTRLEN + 16];
+        size_t n = 0;
+        if (with_name) {
+            n = strnlen(r->ifname, IF_NAMESIZE);
+            memcpy(line, r->ifname, n);
+            line[n++] = ':';
+            line[n++] = ' ';
+        }
+        inet_ntop(r->family, r->addr, line + n, INET6_ADDRSTRLEN);
+        n += strlen(line + n);
+        n += snprintf(line + n, sizeof(line) - n, "/%u\n", r->prefixlen);
+        off = ifsnap_put(out, outlen, off, line, n);
+    }
+    ifsnap_terminate(out, outlen, off);
+    return off;
+}
+
+static size_t ifsnap_render_json(const ifsnap_t *s, int with_name, char *out, size_t outlen) {
+    (void)with_name; // le nom fait toujours partie de l'objet
+    size_t off = ifsnap_put(out, outlen, 0, "[", 1);
+    for (size_t i = 0; i < s->count; i++) {
+        const ifsnap_rec_t *r = &s->recs[i];
+        char addr_str[INET6_ADDRSTRLEN];
+        inet_ntop(r->family, r->addr, addr_str, sizeof(addr_str));
+        // Noms d'interface : ni guillemet ni contrôle possibles (dev_valid_name)
+        char obj[IF_NAMESIZE + INET6_ADDRSTRLEN + 128];
+        int n = snprintf(obj, sizeof(obj),
+                         "%s{\"ifname\":\"%.*s\",\"ifindex\":%u,\"family\":\"%s\","
+                         "\"address\":\"%s\",\"prefixlen\":%u,\"scope\":%u,\"flags\":%u}",
+                         i ? "," : "", IF_NAMESIZE, r->ifname, r->ifindex,
+                         r->family == AF_INET ? "inet" : "inet6",
+                         addr_str, r->prefixlen, r->scope, r->flags);
+        off = ifsnap_put(out, outlen, off, obj, n);
+    }
+    off = ifsnap_put(out, outlen, off, "]\n", 2);
+    ifsnap_terminate(out, outlen, off);
+    return off;
+}
+
+static size_t ifsnap_render_bin(const ifsnap_t *s, int with_name, char *out, size_t outlen) {
+    (void)with_name;
+    ifsnap_bin_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, IFSNAP_MAGIC, sizeof(hdr.magic));
+    hdr.count    = s->count;
+    hdr.rec_size = sizeof(ifsnap_rec_t);
+    size_t off = ifsnap_put(out, outlen, 0, (const char *)&hdr, sizeof(hdr));
+    return ifsnap_put(out, outlen, off, (const char *)s->recs, s->count * sizeof(ifsnap_rec_t));
+}
+
+static const struct {
+    const char       *name;
+    ifsnap_render_fn  fn;
+} ifsnap_renderers[] = {
+    { "text", ifsnap_render_text },
+    { "json", ifsnap_render_json },
+    { "bin",  ifsnap_render_bin },
+};
+
+// Rendu par son nom ("text", "json", "bin") ; NULL si inconnu
+static inline ifsnap_render_fn ifsnap_renderer(const char *name) {
+    for (size_t i = 0; i < sizeof(ifsnap_renderers) / sizeof(ifsnap_renderers[0]); i++) {
+        if (strcmp(ifsnap_renderers[i].name, name) == 0) {
+            return ifsnap_renderers[i].fn;
+        }
+    }
+    return NULL;
+}
+
+#ifdef IFTRIE_H
+// Alimente l'arbre des préfixes (iftrie.h) à partir d'un instantané
+static inline void ifsnap_to_trie(const ifsnap_t *s, iftrie_t *t) {
+    for (size_t i = 0; i < s->count; i++) {
+        const ifsnap_rec_t *r = &s->recs[i];
+        iftrie_add(t, r->ifname, r->family, r->addr, r->prefixlen);
+    }
+}
+#endif
+
+#endif /* IFSNAPSHOT_H */
@@ -0,0 +1,411 @@
+/****************************************************
+ * iftrie.h
+ *
+ * Recherche de l'interface qui possède ou dessert une
+ * adresse IP (plus long préfixe), partagée par Ifshow.c,
+ * ifnetshowserv.c et netinfod.c (simple inclusion).
+ *
+ * Arbre binaire compressé à la manière de poptrie :
+ *  - chaque nœud consomme 6 bits de l'adresse (64 fils) ;
+ *  - deux bitmaps 64 bits par nœud : 'vector' (quels fils
+ *    sont des nœuds) et 'leafvec' (où commence une nouvelle
+ *    plage de feuilles identiques) ;
+ *  - les fils d'un nœud sont contigus, ses feuilles aussi :
+ *    l'indice se calcule par popcount, sans pointeur.
+ * Un nœud fait 24 octets ; une recherche IPv4 visite au
+ * plus 6 nœuds, une recherche IPv6 au plus 22.
+ *
+ * Chaque adresse d'interface insère son préfixe réseau et
+ * son adresse exacte (/32 ou /128) : on distingue ainsi une
+ * adresse locale d'une adresse simplement sur le lien.
+ *
+ * Réponse (une ligne par adresse demandée) :
+ *    "10.0.0.5: eth0 10.0.0.5/24 (locale)"
+ *    "10.0.0.7: eth0 10.0.0.5/24"
+ *    "8.8.8.8: aucune interface"
+ *
+ * Compiler avec -march=native (ou -mpopcnt) pour que
+ * __builtin_popcountll soit une seule instruction.
+ ****************************************************/
+
+#ifndef IFTRIE_H
+#define IFTRIE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <net/if.h>
+
+#define IFTRIE_STRIDE 6
+#define IFTRIE_LABEL  (IF_NAMESIZE + INET6_ADDRSTRLEN + 8)
+
+typedef unsigned __int128 iftrie_key_t; // adresse alignée sur les bits de poids fort
+
+typedef struct {
+    uint64_t vector;   // bit i : le fils i est un nœud
+    uint64_t leafvec;  // bit i : une nouvelle plage de feuilles commence en i
+    uint32_t base0;    // première feuille du nœud
+    uint32_t base1;    // premier fils du nœud
+} iftrie_node_t;
+
+typedef struct {
+    iftrie_node_t *nodes;   // nodes[0] est la racine
+    uint32_t      *leaves;  // (propriétaire << 1) | locale ; 0 = aucun
+    uint32_t       nnodes;
+    uint32_t       nleaves;
+} iftrie_fam_t;
+
+typedef struct {
+    char label[IFTRIE_LABEL]; // "eth0 10.0.0.5/24", prêt à recopier
+    int  label_len;
+    int  family;
+    unsigned char addr[16];
+    int  prefixlen;
+} iftrie_owner_t;
+
+typedef struct {
+    iftrie_fam_t    v4, v6;
+    iftrie_owner_t *owners;   // owners[0] inutilisé (0 = aucun)
+    uint32_t        nowners;
+    uint32_t        owners_cap;
+} iftrie_t;
+
+/* ---------- Construction ---------- */
+
+// Nœud de construction, non compressé : 64 fils et 64 feuilles
+typedef struct iftrie_bnode {
+    struct iftrie_bnode *child[1 << IFTRIE_STRIDE];
+    uint32_t             leaf[1 << IFTRIE_STRIDE];
+} iftrie_bnode_t;
+
+typedef struct {
+    iftrie_key_t key;
+    int          len;
+    uint32_t     value;
+    uint32_t     seq;  // ordre d'ajout, pour un tri stable
+} iftrie_prefix_t;
+
+static inline iftrie_key_t iftrie_key(int family, const void *addr) {
+    const unsigned char *a = addr;
+    int n = family == AF_INET ? 4 : 16;
+    iftrie_key_t k = 0;
+    for (int i = 0; i < n; i++) {
+        k = (k << 8) | a[i];
+    }
+    return k << (128 - 8 * n);
+}
+
+static inline void iftrie_init(iftrie_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+static inline void iftrie_free(iftrie_t *t) {
+    free(t->v4.nodes);
+    free(t->v4.leaves);
+    free(t->v6.nodes);
+    free(t->v6.leaves);
+    free(t->owners);
+    iftrie_init(t);
+}
+
+static inline void *iftrie_xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// Déclare une adresse d'interface ; prise en compte au prochain iftrie_build().
+static inline void iftrie_add(iftrie_t *t, const char *ifname, int family,
+                              const void *addr, int prefixlen)
+{
+    if (family != AF_INET && family != AF_INET6) {
+        return;
+    }
+    if (t->nowners + 1 >= t->owners_cap) {
+        t->owners_cap = t->owners_cap ? t->owners_cap * 2 : 64;
+        t->owners = iftrie_xrealloc(t->owners, t->owners_cap * sizeof(*t->owners));
+    }
+    iftrie_owner_t *o = &t->owners[++t->nowners];
+    memset(o, 0, sizeof(*o));
+    o->family    = family;
+    o->prefixlen = prefixlen;
+    memcpy(o->addr, addr, family == AF_INET ? 4 : 16);
+
+    char addr_str[INET6_ADDRSTRLEN];
+    inet_ntop(family, addr, addr_str, sizeof(addr_str));
+    o->label_len = snprintf(o->label, sizeof(o->label), "%s %s/%d",
+                            ifname, addr_str, prefixlen);
+    if (o->label_len >= (int)sizeof(o->label)) {
+        o->label_len = sizeof(o->label) - 1;
+    }
+}
+
+// Ajoute toutes les adresses IPv4/IPv6 renvoyées par getifaddrs().
+static inline void iftrie_add_ifaddrs(iftrie_t *t, const struct ifaddrs *ifaddr) {
+    for (const struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_name || !ifa->ifa_addr) {
+            continue;
+        }
+        int family = ifa->ifa_addr->sa_family;
+        const unsigned char *addr, *mask = NULL;
+        int n;
+        if (family == AF_INET) {
+            addr = (const unsigned char *)&((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
+            if (ifa->ifa_netmask) {
+                mask = (const unsigned char *)&((struct sockaddr_in *)ifa->ifa_netmask)->sin_addr;
+            }
+            n = 4;
+        } else if (family == AF_INET6) {
+            addr = (const unsigned char *)&((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr;
+            if (ifa->ifa_netmask) {
+                mask = (const unsigned char *)&((struct sockaddr_in6 *)ifa->ifa_netmask)->sin6_addr;
+            }
+            n = 16;
+        } else {
+            continue;
+        }
+        int prefixlen = 8 * n;
+        if (mask) {
+            prefixlen = 0;
+            for (int i = 0; i < n; i++) {
+                prefixlen += __builtin_popcount(mask[i]);
+            }
+        }
+        iftrie_add(t, ifa->ifa_name, family, addr, prefixlen);
+    }
+}
+
+static void iftrie_bfill(iftrie_bnode_t *n, uint32_t value) {
+    for (int i = 0; i < (1 << IFTRIE_STRIDE); i++) {
+        n->leaf[i] = value;
+        if (n->child[i]) {
+            iftrie_bfill(n->child[i], value);
+        }
+    }
+}
+
+static void iftrie_bfree(iftrie_bnode_t *n) {
+    for (int i = 0; i < (1 << IFTRIE_STRIDE); i++) {
+        if (n->child[i]) {
+            iftrie_bfree(n->child[i]);
+        }
+    }
+    free(n);
+}
+
+/*
+ * Insertion par longueur de préfixe croissante : un préfixe écrase tout
+ * ce qu'il recouvre (feuilles et sous-arbres), puisque rien de plus
+ * spécifique n'y a encore été placé.
+ */
+static void iftrie_binsert(iftrie_bnode_t *n, iftrie_key_t k, int len, uint32_t value) {
+    for (;;) {
+        unsigned idx = (unsigned)(k >> (128 - IFTRIE_STRIDE));
+        if (len <= IFTRIE_STRIDE) {
+            unsigned span = 1u << (IFTRIE_STRIDE - len);
+            idx &= ~(span - 1);
+            for (unsigned i = idx; i < idx + span; i++) {
+                n->leaf[i] = value;
+                if (n->child[i]) {
+                    iftrie_bfill(n->child[i], value);
+                }
+            }
+            return;
+        }
+        if (!n->child[idx]) {
+            iftrie_bnode_t *c = calloc(1, sizeof(*c));
+            if (!c) {
+                perror("calloc");
+                exit(EXIT_FAILURE);
+            }
+            // Poussée des feuilles : le fils hérite du préfixe qui le couvre
+            for (int i = 0; i < (1 << IFTRIE_STRIDE); i++) {
+                c->leaf[i] = n->leaf[idx];
+            }
+            n->child[idx] = c;
+        }
+        n = n->child[idx];
+        k <<= IFTRIE_STRIDE;
+        len -= IFTRIE_STRIDE;
+    }
+}
+
+// Aplatit l'arbre de construction, en largeur : les fils d'un nœud se suivent.
+static void iftrie_compress(iftrie_fam_t *f, iftrie_bnode_t *root) {
+    uint32_t cap = 64, lcap = 256;
+    iftrie_bnode_t **queue = iftrie_xrealloc(NULL, cap * sizeof(*queue));
+    f->nodes  = iftrie_xrealloc(NULL, cap * sizeof(*f->nodes));
+    f->leaves = iftrie_xrealloc(NULL, lcap * sizeof(*f->leaves));
+    f->nleaves = 0;
+    f->nnodes  = 1;
+    queue[0]   = root;
+
+    for (uint32_t i = 0; i < f->nnodes; i++) {
+        iftrie_bnode_t *b = queue[i];
+        iftrie_node_t node = { 0, 0, f->nleaves, f->nnodes };
+        uint32_t prev = 0;
+
+        for (int idx = 0; idx < (1 << IFTRIE_STRIDE); idx++) {
+            uint32_t value;
+            if (b->child[idx]) {
+                node.vector |= 1ULL << idx;
+                if (f->nnodes == cap) {
+                    cap *= 2;
+                    queue    = iftrie_xrealloc(queue, cap * sizeof(*queue));
+                    f->nodes = iftrie_xrealloc(f->nodes, cap * sizeof(*f->nodes));
+                }
+                queue[f->nnodes++] = b->child[idx];
+                value = prev; // un fils ne coupe pas la plage de feuilles
+            } else {
+                value = b->leaf[idx];
+            }
+            if (idx == 0 || value != prev) {
+                node.leafvec |= 1ULL << idx;
+                if (f->nleaves == lcap) {
+                    lcap *= 2;
+                    f->leaves = iftrie_xrealloc(f->leaves, lcap * sizeof(*f->leaves));
+                }
+                f->leaves[f->nleaves++] = value;
+            }
+            prev = value;
+        }
+        f->nodes[i] = node;
+    }
+    free(queue);
+}
+
+static int iftrie_prefix_cmp(const void *a, const void *b) {
+    const iftrie_prefix_t *x = a, *y = b;
+    if (x->len != y->len) {
+        return x->len - y->len;
+    }
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static void iftrie_build_family(iftrie_t *t, iftrie_fam_t *f, int family) {
+    free(f->nodes);
+    free(f->leaves);
+    memset(f, 0, sizeof(*f));
+
+    int bits = family == AF_INET ? 32 : 128;
+    iftrie_prefix_t *pfx = iftrie_xrealloc(NULL, (2 * t->nowners + 1) * sizeof(*pfx));
+    uint32_t n = 0;
+    for (uint32_t i = 1; i <= t->nowners; i++) {
+        const iftrie_owner_t *o = &t->owners[i];
+        if (o->family != family) {
+            continue;
+        }
+        int len = o->prefixlen < 0 ? 0 : (o->prefixlen > bits ? bits : o->prefixlen);
+        iftrie_key_t k = iftrie_key(family, o->addr);
+        iftrie_key_t mask = len ? ~(iftrie_key_t)0 << (128 - len) : 0;
+
+        // Le réseau, puis l'adresse elle-même
+        pfx[n] = (iftrie_prefix_t){ k & mask, len,  i << 1,       n };
+        n++;
+        pfx[n] = (iftrie_prefix_t){ k,        bits, (i << 1) | 1, n };
+        n++;
+    }
+    qsort(pfx, n, sizeof(*pfx), iftrie_prefix_cmp);
+
+    iftrie_bnode_t *root = calloc(1, sizeof(*root));
+    if (!root) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        iftrie_binsert(root, pfx[i].key, pfx[i].len, pfx[i].value);
+    }
+    free(pfx);
+
+    iftrie_compress(f, root);
+    iftrie_bfree(root);
+}
+
+// (Re)construit les deux arbres à partir des adresses déclarées.
+static inline void iftrie_build(iftrie_t *t) {
+    iftrie_build_family(t, &t->v4, AF_INET);
+    iftrie_build_family(t, &t->v6, AF_INET6);
+}
+
+/* ---------- Recherche ---------- */
+
+// Renvoie (propriétaire << 1) | locale, ou 0 si aucun préfixe ne couvre la clé.
+static inline uint32_t iftrie_lookup_key(const iftrie_fam_t *f, iftrie_key_t k) {
+    const iftrie_node_t *n = f->nodes;
+    if (!n) {
+        return 0;
+    }
+    for (;;) {
+        unsigned idx = (unsigned)(k >> (128 - IFTRIE_STRIDE));
+        uint64_t below = (2ULL << idx) - 1; // bits 0..idx
+        if ((n->vector >> idx) & 1) {
+            n = &f->nodes[n->base1 + __builtin_popcountll(n->vector & below) - 1];
+            k <<= IFTRIE_STRIDE;
+        } else {
+            return f->leaves[n->base0 + __builtin_popcountll(n->leafvec & below) - 1];
+        }
+    }
+}
+
+static inline uint32_t iftrie_lookup(const iftrie_t *t, int family, const void *addr) {
+    return iftrie_lookup_key(family == AF_INET ? &t->v4 : &t->v6, iftrie_key(family, addr));
+}
+
+/*
+ * Écrit dans 'out' la ligne de réponse pour l'adresse texte 'ip'
+ * (longueur 'iplen', sans fin de ligne). Renvoie le nombre d'octets
+ * écrits, ou 0 si 'out' est trop petit.
+ */
+static inline size_t iftrie_answer(const iftrie_t *t, const char *ip, size_t iplen,
+                                   char *out, size_t outlen)
+{
+    char tmp[INET6_ADDRSTRLEN];
+    unsigned char addr[16];
+    const char *tail = ": adresse invalide\n";
+    const iftrie_owner_t *o = NULL;
+    uint32_t v = 0;
+
+    if (iplen < sizeof(tmp)) {
+        memcpy(tmp, ip, iplen);
+        tmp[iplen] = '\0';
+        int family = memchr(tmp, ':', iplen) ? AF_INET6 : AF_INET;
+        if (inet_pton(family, tmp, addr) == 1) {
+            v = iftrie_lookup(t, family, addr);
+            tail = ": aucune interface\n";
+            if (v) {
+                o = &t->owners[v >> 1];
+            }
+        }
+    }
+
+    size_t need = iplen + (o ? 2 + (size_t)o->label_len + 10 : strlen(tail));
+    if (need >= outlen) {
+        return 0;
+    }
+    memcpy(out, ip, iplen);
+    size_t off = iplen;
+    if (o) {
+        memcpy(out + off, ": ", 2);
+        off += 2;
+        memcpy(out + off, o->label, o->label_len);
+        off += o->label_len;
+        if (v & 1) {
+            memcpy(out + off, " (locale)", 9);
+            off += 9;
+        }
+        out[off++] = '\n';
+    } else {
+        memcpy(out + off, tail, strlen(tail));
+        off += strlen(tail);
+    }
+    return off;
+}
+
+#endif /* IFTRIE_H */
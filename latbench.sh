@@ -0,0 +1,146 @@
+#!/bin/bash
+#####################################################
+# latbench.sh
+#
+# Latence de queue d'ifnetshowserv (TCP) et de
+# neighbourshowagent (UDP), avec et sans busy polling.
+#
+# Exécution (root, iproute2) :
+#    sudo ./latbench.sh
+#    sudo ./latbench.sh -mode udp -n 20000 -busypoll 100
+#    sudo ./latbench.sh -cpus 2-3 -keep
+#
+# Deux namespaces reliés par une paire veth : "lbsrv"
+# (10.77.0.1) fait tourner le démon, "lbcli" (10.77.0.2)
+# lance netlatbench. Pour chaque démon : une mesure sans
+# -busypoll puis une avec (démon et client), une ligne
+# min / p50 / p90 / p99 / p99.9 / max chacune.
+#
+# Le client UDP fait tourner sa source sur 10.77.1.0/24
+# pour rester sous les seaux de jetons par IP de l'agent.
+#
+# La veth n'a de file NAPI qu'avec GRO activé (ethtool) :
+# sans, le busy polling ne change rien et les deux lignes
+# se ressemblent. Les vrais chiffres se mesurent entre deux
+# machines, avec netlatbench directement.
+#####################################################
+
+set -u
+
+MODE=both
+COUNT=10000
+BUSY=50
+CPUS=
+SERVER=./ifnetshowserv
+AGENT=./neighbourshowagent
+BENCH=./netlatbench
+KEEP=0
+SRV_NS=lbsrv
+CLI_NS=lbcli
+
+usage() {
+    echo "Usage: $0 [-mode tcp|udp|both] [-n requêtes] [-busypoll usec] [-cpus liste]" >&2
+    echo "          [-server binaire] [-agent binaire] [-bench binaire] [-keep]" >&2
+    exit 1
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -mode)     MODE=$2; shift ;;
+        -n)        COUNT=$2; shift ;;
+        -busypoll) BUSY=$2; shift ;;
+        -cpus)     CPUS=$2; shift ;;
+        -server)   SERVER=$2; shift ;;
+        -agent)    AGENT=$2; shift ;;
+        -bench)    BENCH=$2; shift ;;
+        -keep)     KEEP=1 ;;
+        *)         usage ;;
+    esac
+    shift
+done
+
+case "$MODE" in
+    tcp|udp|both) ;;
+    *) usage ;;
+esac
+[ "$BUSY" -gt 0 ] 2>/dev/null || usage
+
+[ "$(id -u)" -eq 0 ] || { echo "Il faut être root." >&2; exit 1; }
+SERVER=$(readlink -f "$SERVER")
+AGENT=$(readlink -f "$AGENT")
+BENCH=$(readlink -f "$BENCH")
+[ -x "$SERVER" ] && [ -x "$AGENT" ] && [ -x "$BENCH" ] ||
+    { echo "Binaires introuvables : $SERVER $AGENT $BENCH" >&2; exit 1; }
+
+# ---------- Nettoyage ----------
+DAEMON_PID=
+cleanup() {
+    [ -n "$DAEMON_PID" ] && kill "$DAEMON_PID" 2>/dev/null
+    wait 2>/dev/null
+    if [ "$KEEP" -eq 0 ]; then
+        ip netns del "$SRV_NS" 2>/dev/null
+        ip netns del "$CLI_NS" 2>/dev/null
+    fi
+}
+trap cleanup EXIT INT TERM
+
+# ---------- Banc : deux namespaces, une veth ----------
+ip netns add "$SRV_NS"
+ip netns add "$CLI_NS"
+ip -n "$SRV_NS" link set lo up
+ip -n "$CLI_NS" link set lo up
+ip link add lb0 netns "$SRV_NS" type veth peer name lb1 netns "$CLI_NS"
+ip -n "$SRV_NS" addr add 10.77.0.1/24 dev lb0
+ip -n "$CLI_NS" addr add 10.77.0.2/24 dev lb1
+ip -n "$SRV_NS" link set lb0 up
+ip -n "$CLI_NS" link set lb1 up
+
+# Sources tournantes du client UDP, et leur route retour
+for ((h = 1; h < 255; h++)); do echo "addr add 10.77.1.$h/32 dev lb1"; done |
+    ip -n "$CLI_NS" -batch -
+ip -n "$SRV_NS" route add 10.77.1.0/24 via 10.77.0.2
+
+# File NAPI sur la veth (GRO), sans quoi il n'y a rien à interroger
+if command -v ethtool >/dev/null; then
+    ip netns exec "$SRV_NS" ethtool -K lb0 gro on >/dev/null 2>&1
+    ip netns exec "$CLI_NS" ethtool -K lb1 gro on >/dev/null 2>&1
+else
+    echo "[bench] ethtool absent : pas de NAPI sur la veth, busy polling sans effet" >&2
+fi
+
+# ---------- Mesures ----------
+# run <démon> <tcp|udp> <usec, 0 = sans busy polling>
+run() {
+    local daemon=$1 proto=$2 busy=$3 label=$2
+    local dargs=() bargs=()
+    [ -n "$CPUS" ] && dargs+=(-cpus "$CPUS")
+    if [ "$busy" -gt 0 ]; then
+        dargs+=(-busypoll "$busy")
+        bargs+=(-busypoll "$busy")
+        label="$proto+busy$busy"
+    fi
+    [ "$proto" = udp ] && bargs+=(-src 10.77.1.0/24)
+
+    ip netns exec "$SRV_NS" "$daemon" "${dargs[@]}" >/dev/null 2>&1 &
+    DAEMON_PID=$!
+    sleep 0.5
+    if ! kill -0 "$DAEMON_PID" 2>/dev/null; then
+        echo "[bench] $label : le démon ne démarre pas" >&2
+        DAEMON_PID=
+        return
+    fi
+    ip netns exec "$CLI_NS" "$BENCH" "-$proto" 10.77.0.1 -n "$COUNT" -label "$label" "${bargs[@]}"
+    kill "$DAEMON_PID" 2>/dev/null
+    wait "$DAEMON_PID" 2>/dev/null
+    DAEMON_PID=
+}
+
+echo "[bench] $COUNT requêtes par mesure, busy polling $BUSY µs${CPUS:+, cœurs $CPUS}"
+if [ "$MODE" != udp ]; then
+    run "$SERVER" tcp 0
+    run "$SERVER" tcp "$BUSY"
+fi
+if [ "$MODE" != tcp ]; then
+    run "$AGENT" udp 0
+    run "$AGENT" udp "$BUSY"
+fi
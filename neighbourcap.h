@@ -0,0 +1,124 @@
+/****************************************************
+ * neighbourcap.h
+ *
+ * Format du journal de capture des datagrammes de
+ * découverte (neighbourshowagent -record, relu par
+ * neighbourreplay). Simple inclusion.
+ *
+ * Fichier :
+ *    en-tête  : magic "NSCAP01\0" + u64 heure murale du
+ *               début de capture (ns depuis l'epoch)
+ *    puis des enregistrements consécutifs :
+ *               u64 instant (ns depuis le début)
+ *               u32 IPv4 source, u16 port source
+ *                   (ordre réseau, tels que reçus)
+ *               u16 longueur, puis la charge utile
+ * Les entiers u64 / u16 de longueur sont dans l'ordre
+ * de la machine qui a capturé.
+ ****************************************************/
+
+#ifndef NEIGHBOURCAP_H
+#define NEIGHBOURCAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#define CAP_MAGIC     "NSCAP01"   // 8 octets avec le '\0' final
+#define CAP_FLUSH_NS  1000000000ULL
+
+typedef struct {
+    char     magic[8];
+    uint64_t start_realtime_ns;
+} cap_file_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t ts_ns;
+    uint32_t src_addr;
+    uint16_t src_port;
+    uint16_t len;
+} cap_rec_hdr_t;
+
+typedef struct {
+    FILE    *fp;
+    uint64_t start_ns;      // CLOCK_MONOTONIC au début de la capture
+    uint64_t last_flush_ns;
+    unsigned long records;
+    int      dirty;         // écritures pas encore vidées
+
+} capture_t;
+
+static inline uint64_t cap_clock_ns(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Crée le journal ; renvoie 0 si OK.
+static inline int cap_open(capture_t *cap, const char *path) {
+    memset(cap, 0, sizeof(*cap));
+    cap->fp = fopen(path, "wb");
+    if (!cap->fp) {
+        perror(path);
+        return -1;
+    }
+    // Gros tampon stdio : une écriture disque par 1 Mo, pas par datagramme
+    setvbuf(cap->fp, NULL, _IOFBF, 1 << 20);
+
+    cap_file_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CAP_MAGIC, sizeof(hdr.magic));
+    hdr.start_realtime_ns = cap_clock_ns(CLOCK_REALTIME);
+    cap->start_ns = cap->last_flush_ns = cap_clock_ns(CLOCK_MONOTONIC);
+    return fwrite(&hdr, sizeof(hdr), 1, cap->fp) == 1 ? 0 : -1;
+}
+
+/*
+ * Vide le tampon si des écritures attendent depuis CAP_FLUSH_NS. À appeler
+ * aussi quand rien n'arrive (délai de réception d'une seconde côté agent) :
+ * le dernier datagramme d'une rafale est alors sur disque au plus tard
+ * CAP_FLUSH_NS plus une seconde après sa réception, même si l'agent est tué.
+ */
+static inline void cap_tick(capture_t *cap) {
+    if (!cap->fp || !cap->dirty) {
+        return;
+    }
+    uint64_t now = cap_clock_ns(CLOCK_MONOTONIC);
+    if (now - cap->last_flush_ns >= CAP_FLUSH_NS) {
+        fflush(cap->fp);
+        cap->last_flush_ns = now;
+        cap->dirty = 0;
+    }
+}
+
+// Ajoute un datagramme au journal (vidé par cap_tick).
+static inline void cap_write(capture_t *cap, const struct sockaddr_in *src,
+                             const void *data, size_t len)
+{
+    if (!cap->fp) {
+        return;
+    }
+    uint64_t now = cap_clock_ns(CLOCK_MONOTONIC);
+    cap_rec_hdr_t rec;
+    rec.ts_ns    = now - cap->start_ns;
+    rec.src_addr = src->sin_addr.s_addr;
+    rec.src_port = src->sin_port;
+    rec.len      = (uint16_t)(len > UINT16_MAX ? UINT16_MAX : len);
+
+    fwrite(&rec, sizeof(rec), 1, cap->fp);
+    fwrite(data, rec.len, 1, cap->fp);
+    cap->records++;
+    cap->dirty = 1;
+    cap_tick(cap);
+}
+
+static inline void cap_close(capture_t *cap) {
+    if (cap->fp) {
+        fclose(cap->fp);
+        cap->fp = NULL;
+    }
+}
+
+#endif /* NEIGHBOURCAP_H */
@@ -0,0 +1,290 @@
+/****************************************************
+ * neighbouremu.c
+ *
+ * Compilation :
+ *    gcc -O2 neighbouremu.c -o neighbouremu
+ *
+ * Exécution (exemples) :
+ *    ./neighbouremu -agents 50000 -delay 500
+ *    ./neighbouremu -agents 100000 -loss 0.01 -dup 0.05 -rate 100000
+ *    ./neighbourshow -dest 127.0.0.1 -timeout 500 -stats
+ *
+ * Explications :
+ *  - Émule des milliers d'agents de découverte dans un seul processus,
+ *    pour éprouver la réception, la déduplication et le timeout de
+ *    neighbourshow.c sans namespaces.
+ *  - Écoute UDP 9999 (par défaut sur 127.0.0.1) ; pour chaque requête
+ *    NEIGHBOR_DISCOVERY reçue, planifie une réponse par agent émulé
+ *    ("emu-00042", avec le "path=" reçu comme un vrai agent), à l'adresse
+ *    "reply=" si présente, sinon à l'émetteur.
+ *  - Chaque réponse part après un délai uniforme dans [0, -delay ms],
+ *    peut être perdue (-loss) ou doublée (-dup).
+ *  - Les réponses échues sont envoyées par lots avec sendmmsg(), chaque lot
+ *    depuis l'un des -srcs sockets liés à des adresses consécutives à partir
+ *    de -srcbase (127.x.y.z : toutes locales sur lo ; sur une interface
+ *    dummy, y ajouter les adresses au préalable), éventuellement bridées à
+ *    -rate réponses par seconde.
+ ****************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define AGENT_PORT  9999
+#define BUFFER_SIZE 1024
+#define PATH_SIZE   768
+#define BATCH       64   // messages par appel à sendmmsg
+#define RETRY_NS    100000 // pause avant de renvoyer un lot refusé (ENOBUFS)
+#define MAX_SRCS    256
+
+typedef struct {
+    uint64_t due_ns;  // instant d'envoi (CLOCK_MONOTONIC)
+    uint32_t agent;   // numéro d'agent émulé
+} reply_event_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t_ns) {
+    struct timespec ts = { (time_t)(t_ns / 1000000000ULL), (long)(t_ns % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// Générateur xorshift : rapide et reproductible avec -seed
+static uint64_t rng_state = 88172645463325252ULL;
+static double rng_unit(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int cmp_event(const void *a, const void *b) {
+    const reply_event_t *x = a, *y = b;
+    return (x->due_ns > y->due_ns) - (x->due_ns < y->due_ns);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-listen ip] [-agents n] [-delay ms] [-loss p] [-dup p]\n"
+                    "          [-rate pps] [-srcs n] [-srcbase ip] [-seed n]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *listen_ip = "127.0.0.1";
+    const char *src_base  = "127.0.0.1";
+    long   agents   = 1000;
+    double delay_ms = 100;
+    double loss     = 0;
+    double dup      = 0;
+    double rate     = 0; // 0 = aussi vite que possible
+    int    nsrcs    = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-listen") == 0)       listen_ip = argv[++i];
+        else if (strcmp(argv[i], "-agents") == 0)  agents    = atol(argv[++i]);
+        else if (strcmp(argv[i], "-delay") == 0)   delay_ms  = atof(argv[++i]);
+        else if (strcmp(argv[i], "-loss") == 0)    loss      = atof(argv[++i]);
+        else if (strcmp(argv[i], "-dup") == 0)     dup       = atof(argv[++i]);
+        else if (strcmp(argv[i], "-rate") == 0)    rate      = atof(argv[++i]);
+        else if (strcmp(argv[i], "-srcs") == 0)    nsrcs     = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-srcbase") == 0) src_base  = argv[++i];
+        else if (strcmp(argv[i], "-seed") == 0)    rng_state = strtoull(argv[++i], NULL, 0) | 1;
+        else usage(argv[0]);
+    }
+    if (agents < 1 || agents > 10000000 || nsrcs < 1 || nsrcs > MAX_SRCS ||
+        loss < 0 || loss > 1 || dup < 0 || dup > 1 || delay_ms < 0) {
+        usage(argv[0]);
+    }
+
+    // Socket d'écoute des requêtes
+    int lfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (lfd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct sockaddr_in laddr;
+    memset(&laddr, 0, sizeof(laddr));
+    laddr.sin_family = AF_INET;
+    laddr.sin_port   = htons(AGENT_PORT);
+    if (inet_pton(AF_INET, listen_ip, &laddr.sin_addr) != 1 ||
+        bind(lfd, (struct sockaddr *)&laddr, sizeof(laddr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    // Sockets d'émission, un par adresse source émulée
+    int srcs[MAX_SRCS];
+    struct in_addr base;
+    if (inet_pton(AF_INET, src_base, &base) != 1) {
+        usage(argv[0]);
+    }
+    for (int s = 0; s < nsrcs; s++) {
+        srcs[s] = socket(AF_INET, SOCK_DGRAM, 0);
+        if (srcs[s] < 0) {
+            perror("socket source");
+            return 1;
+        }
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family      = AF_INET;
+        a.sin_addr.s_addr = htonl(ntohl(base.s_addr) + s);
+        int sndbuf = 4 << 20;
+        setsockopt(srcs[s], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        if (bind(srcs[s], (struct sockaddr *)&a, sizeof(a)) < 0) {
+            perror("bind source");
+            return 1;
+        }
+    }
+
+    reply_event_t *events = malloc((size_t)agents * 2 * sizeof(*events));
+    char (*payloads)[BUFFER_SIZE] = malloc(BATCH * sizeof(*payloads));
+    if (!events || !payloads) {
+        perror("malloc");
+        return 1;
+    }
+
+    printf("[Emu] %ld agents émulés, écoute %s:%d (délai <= %.0f ms, perte %.3f, doublons %.3f)\n",
+           agents, listen_ip, AGENT_PORT, delay_ms, loss, dup);
+    fflush(stdout);
+
+    for (;;) {
+        char buffer[BUFFER_SIZE];
+        struct sockaddr_in client;
+        socklen_t clen = sizeof(client);
+        ssize_t n = recvfrom(lfd, buffer, sizeof(buffer) - 1, 0,
+                             (struct sockaddr *)&client, &clen);
+        if (n < 0) {
+            perror("recvfrom");
+            break;
+        }
+        buffer[n] = '\0';
+        if (strncmp(buffer, "NEIGHBOR_DISCOVERY", 18) != 0) {
+            continue;
+        }
+
+        // Mêmes champs optionnels qu'un vrai agent
+        char path[PATH_SIZE] = "";
+        const char *p = strstr(buffer, " path=");
+        if (p) {
+            size_t len = strcspn(p + 6, " ");
+            if (len < sizeof(path)) {
+                memcpy(path, p + 6, len);
+                path[len] = '\0';
+            }
+        }
+        struct sockaddr_in to = client;
+        const char *r = strstr(buffer, " reply=");
+        if (r) {
+            char ip[64];
+            unsigned int port;
+            if (sscanf(r + 7, "%63[^: ]:%u", ip, &port) == 2 && port > 0 && port < 65536 &&
+                inet_pton(AF_INET, ip, &to.sin_addr) == 1) {
+                to.sin_port = htons((unsigned short)port);
+            }
+        }
+
+        // Planification : délai, pertes et doublons tirés d'avance
+        uint64_t t0 = now_ns();
+        long count = 0, lost = 0, dups = 0;
+        for (long a = 0; a < agents; a++) {
+            if (rng_unit() < loss) {
+                lost++;
+                continue;
+            }
+            int copies = 1 + (rng_unit() < dup);
+            dups += copies - 1;
+            for (int c = 0; c < copies; c++) {
+                events[count].due_ns = t0 + (uint64_t)(rng_unit() * delay_ms * 1e6);
+                events[count].agent  = (uint32_t)a;
+                count++;
+            }
+        }
+        qsort(events, count, sizeof(*events), cmp_event);
+
+        // Émission par lots de réponses échues
+        struct mmsghdr msgs[BATCH];
+        struct iovec   iov[BATCH];
+        long sent = 0, errors = 0, batches = 0;
+        double ns_per_reply = rate > 0 ? 1e9 / rate : 0;
+
+        for (long i = 0; i < count; ) {
+            uint64_t due = events[i].due_ns;
+            if (ns_per_reply > 0 && t0 + (uint64_t)(i * ns_per_reply) > due) {
+                due = t0 + (uint64_t)(i * ns_per_reply);
+            }
+            if (due > now_ns()) {
+                sleep_until(due);
+            }
+
+            // Toutes les réponses échues (au plus BATCH) partent d'un coup ;
+            // la première l'est forcément, on vient d'attendre son échéance.
+            uint64_t t = now_ns();
+            int b = 0;
+            do {
+                const reply_event_t *ev = &events[i + b];
+                int len = path[0]
+                    ? snprintf(payloads[b], BUFFER_SIZE, "emu-%05u path=%s", ev->agent, path)
+                    : snprintf(payloads[b], BUFFER_SIZE, "emu-%05u", ev->agent);
+                iov[b].iov_base = payloads[b];
+                iov[b].iov_len  = (size_t)len < BUFFER_SIZE ? (size_t)len : BUFFER_SIZE - 1;
+                memset(&msgs[b], 0, sizeof(msgs[b]));
+                msgs[b].msg_hdr.msg_name    = &to;
+                msgs[b].msg_hdr.msg_namelen = sizeof(to);
+                msgs[b].msg_hdr.msg_iov     = &iov[b];
+                msgs[b].msg_hdr.msg_iovlen  = 1;
+                b++;
+            } while (i + b < count && b < BATCH && events[i + b].due_ns <= t &&
+                     (ns_per_reply == 0 || t0 + (uint64_t)((i + b) * ns_per_reply) <= t));
+
+            // Les lots tournent sur les adresses sources émulées
+            int fd = srcs[batches++ % nsrcs];
+            int done = sendmmsg(fd, msgs, b, 0);
+            if (done < 0) {
+                // File pleine : on attend un peu, puis on réessaie le même
+                // lot. EAGAIN : le tampon d'émission se vide (POLLOUT) ;
+                // ENOBUFS : file de la carte pleine, rien à attendre sur le
+                // socket, on dort RETRY_NS.
+                if (errno == EAGAIN) {
+                    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                    poll(&pfd, 1, 10);
+                    continue;
+                }
+                if (errno == ENOBUFS) {
+                    struct timespec pause = { 0, RETRY_NS };
+                    nanosleep(&pause, NULL);
+                    continue;
+                }
+                errors++;
+                done = 1;
+            }
+            sent += done;
+            i    += done;
+        }
+
+        double secs = (now_ns() - t0) / 1e9;
+        printf("[Emu] Requête de %s:%u -> %ld réponses (%ld perdues, %ld doublons, %ld erreurs) "
+               "en %.3f s, %.0f réponses/s\n",
+               inet_ntoa(to.sin_addr), ntohs(to.sin_port), sent, lost, dups, errors,
+               secs, secs > 0 ? sent / secs : 0.0);
+        fflush(stdout);
+    }
+
+    return 0;
+}
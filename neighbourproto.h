@@ -0,0 +1,799 @@
+/****************************************************
+ * neighbourproto.h
+ *
+ * Protocole de découverte de voisins, partagé par
+ * neighbourshowagent.c et netinfod.c (simple inclusion,
+ * rien à ajouter à la ligne de compilation).
+ *
+ * Message :
+ *    "NEIGHBOR_DISCOVERY message_id=1234 hop=3 origin=machineA"
+ *    + champs optionnels "path=a,b,c" et "reply=ip:port"
+ * Réponse :
+ *    "hostname" ou "hostname path=<path reçu>"
+ *
+ * Avec le champ "inv=1", la réponse embarque aussi l'inventaire
+ * des adresses de l'agent, découpé en au plus INV_MAX_PARTS
+ * datagrammes :
+ *    "hostname [path=...] inv=01/03" '\0' <enregistrements binaires>
+ * Seul le premier morceau porte le chemin. Un enregistrement :
+ *    [lg nom u8][nom][famille u8 : 4 ou 6][préfixe u8][adresse 4|16 o.]
+ * et n'est jamais coupé entre deux datagrammes.
+ *
+ * Contient le tri noyau (filtre BPF), les garde-fous
+ * (hop, seaux de jetons par source, origin et destination
+ * "reply=", budgets de relais et d'octets d'inventaire), la
+ * déduplication et le traitement complet d'un message.
+ ****************************************************/
+
+#ifndef NEIGHBOURPROTO_H
+#define NEIGHBOURPROTO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <stdint.h>
+#include <linux/filter.h>
+
+#define AGENT_PORT 9999
+#define BUFFER_SIZE 1024
+#define PATH_SIZE   768  // taille max du vecteur de chemin "a,b,c"
+#define HOSTNAME_MAX 256 // buffer du hostname local (gethostname)
+
+// Plafond de hop : au-delà, le message est ignoré (le client refuse aussi)
+#define HOP_MAX 8
+
+// Seaux de jetons : débit (messages/s) et rafale autorisés
+#define SRC_RATE      20   // par IP source
+#define SRC_BURST     40
+#define ORIGIN_RATE   10   // par origin (nouveaux message_id)
+#define ORIGIN_BURST  20
+#define RELAY_RATE    50   // relais par seconde, tous messages confondus
+#define RELAY_BURST   50
+#define REPLY_RATE    20   // réponses par destination "reply=" (IP)
+#define REPLY_BURST   40
+
+// Octets d'inventaire envoyés par seconde à une même IP ; au-delà, la
+// réponse se réduit au hostname (un inventaire complet par seconde)
+#define INV_BYTE_RATE  (INV_MAX_PARTS * BUFFER_SIZE)
+#define INV_BYTE_BURST (INV_MAX_PARTS * BUFFER_SIZE)
+
+// Inventaire joint aux réponses ("inv=1")
+#define INV_MAX_PARTS 16
+#define INV_BUFSIZE   (INV_MAX_PARTS * BUFFER_SIZE)
+
+// Messages déjà vus (origin, message_id) : oubliés après SEEN_TTL_MS
+#define SEEN_TTL_MS   30000
+
+/*
+ * Table de hachage compacte à taille fixe (puissance de 2), commune aux
+ * messages vus et aux seaux de jetons. Une entrée fait 16 octets et ne
+ * conserve qu'une clé hachée sur 64 bits. On sonde au plus RL_PROBES cases :
+ * si toutes sont occupées, la plus ancienne est recyclée. La mémoire est
+ * donc bornée quel que soit le nombre d'origins ou de sources forgées.
+ */
+#define RL_TABLE_SIZE 4096
+#define RL_PROBES     8
+
+typedef struct {
+    uint64_t key;      // 0 = case libre
+    uint32_t stamp_ms; // dernier accès
+    float    tokens;
+} rl_entry_t;
+
+/*
+ * État d'une instance de traitement : tables des garde-fous, compteurs et
+ * buffer d'inventaire. Un par worker de l'agent (alloué par le worker après
+ * son placement, donc sur son nœud NUMA), un seul pour netinfod : aucun
+ * verrou, aucune ligne de cache partagée entre cœurs. Contrepartie : un
+ * doublon reçu par un autre worker n'est pas reconnu, et une source
+ * répartie sur n workers dispose au pire de n seaux ; le budget de relais,
+ * lui, reste global (relay_budget).
+ */
+typedef struct {
+    rl_entry_t seen_table[RL_TABLE_SIZE];
+    rl_entry_t src_table[RL_TABLE_SIZE];
+    rl_entry_t origin_table[RL_TABLE_SIZE];
+    rl_entry_t reply_table[RL_TABLE_SIZE];
+    rl_entry_t inv_table[RL_TABLE_SIZE];
+
+    // Compteurs de messages ignorés, résumés au plus une fois par seconde
+    unsigned long drop_hop, drop_src, drop_origin, drop_relay, drop_reply, drop_inv;
+    uint32_t      last_report;
+    int           id;        // worker, -1 : instance unique
+
+    unsigned char inv[INV_BUFSIZE];
+} discovery_state_t;
+
+/*
+ * Budget global de relais, partagé par tous les workers : seau de jetons
+ * tenu dans un seul mot (heure en ms << 32 | millièmes de jeton), mis à
+ * jour par compare-and-swap. 0 = jamais utilisé.
+ */
+static uint64_t relay_budget;
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static uint64_t hash_bytes(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = data;
+    uint64_t h = 1469598103934665603ULL ^ seed; // FNV-1a 64 bits
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+// Trouve l'entrée 'key', ou en recycle une ; *created vaut 1 dans ce cas.
+static rl_entry_t *rl_lookup(rl_entry_t *table, uint64_t key,
+                             uint32_t now, int *created)
+{
+    size_t start = (size_t)(key ^ (key >> 29)) & (RL_TABLE_SIZE - 1);
+    rl_entry_t *victim = NULL;
+
+    for (size_t i = 0; i < RL_PROBES; i++) {
+        rl_entry_t *e = &table[(start + i) & (RL_TABLE_SIZE - 1)];
+        if (e->key == key) {
+            *created = 0;
+            return e;
+        }
+        if (e->key == 0) {
+            if (!victim || victim->key != 0) {
+                victim = e;
+            }
+        } else if (!victim ||
+                   (victim->key != 0 &&
+                    (uint32_t)(now - e->stamp_ms) > (uint32_t)(now - victim->stamp_ms))) {
+            victim = e;
+        }
+    }
+
+    victim->key      = key;
+    victim->stamp_ms = now;
+    victim->tokens   = 0;
+    *created = 1;
+    return victim;
+}
+
+// Consomme 'cost' jetons du seau 'e' ; renvoie 0 s'il n'y en a pas assez.
+static int take_tokens(rl_entry_t *e, int created, uint32_t now,
+                       float rate, float burst, float cost)
+{
+    if (created) {
+        e->tokens = burst;
+    } else {
+        e->tokens += (float)(uint32_t)(now - e->stamp_ms) * rate / 1000.0f;
+        if (e->tokens > burst) {
+            e->tokens = burst;
+        }
+    }
+    e->stamp_ms = now;
+
+    if (e->tokens < cost) {
+        return 0;
+    }
+    e->tokens -= cost;
+    return 1;
+}
+
+static int take_token(rl_entry_t *e, int created, uint32_t now,
+                      float rate, float burst)
+{
+    return take_tokens(e, created, now, rate, burst, 1.0f);
+}
+
+static int allow_source(discovery_state_t *st, const struct sockaddr_in *src, uint32_t now) {
+    int created;
+    uint64_t key = hash_bytes(&src->sin_addr, sizeof(src->sin_addr), 1);
+    rl_entry_t *e = rl_lookup(st->src_table, key, now, &created);
+    return take_token(e, created, now, SRC_RATE, SRC_BURST);
+}
+
+static int allow_origin(discovery_state_t *st, const char *origin, uint32_t now) {
+    int created;
+    uint64_t key = hash_bytes(origin, strlen(origin), 2);
+    rl_entry_t *e = rl_lookup(st->origin_table, key, now, &created);
+    return take_token(e, created, now, ORIGIN_RATE, ORIGIN_BURST);
+}
+
+/*
+ * "reply=" désigne une IP que personne n'a vérifiée : sans limite, une
+ * source forgée ferait répondre chaque agent du chemin vers une victime.
+ * Les réponses vers une même destination "reply=" sont donc plafonnées.
+ */
+static int allow_reply(discovery_state_t *st, const struct sockaddr_in *to, uint32_t now) {
+    int created;
+    uint64_t key = hash_bytes(&to->sin_addr, sizeof(to->sin_addr), 3);
+    rl_entry_t *e = rl_lookup(st->reply_table, key, now, &created);
+    return take_token(e, created, now, REPLY_RATE, REPLY_BURST);
+}
+
+// Budget d'octets d'inventaire vers l'IP de 'to' ; 0 si 'bytes' le dépasse.
+static int allow_inventory(discovery_state_t *st, const struct sockaddr_in *to,
+                           size_t bytes, uint32_t now) {
+    int created;
+    uint64_t key = hash_bytes(&to->sin_addr, sizeof(to->sin_addr), 4);
+    rl_entry_t *e = rl_lookup(st->inv_table, key, now, &created);
+    return take_tokens(e, created, now, INV_BYTE_RATE, INV_BYTE_BURST, (float)bytes);
+}
+
+static int allow_relay(uint32_t now) {
+    const uint64_t full = (uint64_t)RELAY_BURST * 1000;
+    uint64_t old = __atomic_load_n(&relay_budget, __ATOMIC_RELAXED), next;
+    do {
+        // RELAY_RATE jetons/s = RELAY_RATE millièmes par ms
+        uint64_t milli = old == 0 ? full
+            : (uint32_t)old + (uint64_t)(uint32_t)(now - (uint32_t)(old >> 32)) * RELAY_RATE;
+        if (milli > full) {
+            milli = full;
+        }
+        if (milli < 1000) {
+            return 0;
+        }
+        next = ((uint64_t)now << 32) | (uint32_t)(milli - 1000);
+    } while (!__atomic_compare_exchange_n(&relay_budget, &old, next, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 1;
+}
+
+/*
+ * État d'un worker (-1 : instance unique), alloué et mis à zéro par le
+ * thread appelant : après cpu_pin_self(), les pages sont sur son nœud.
+ * NULL si la mémoire manque.
+ */
+static inline discovery_state_t *discovery_state_new(int id) {
+    discovery_state_t *st = malloc(sizeof(*st));
+    if (st) {
+        memset(st, 0, sizeof(*st)); // first-touch
+        st->id = id;
+    }
+    return st;
+}
+
+static void report_drops(discovery_state_t *st, uint32_t now) {
+    if ((uint32_t)(now - st->last_report) < 1000) {
+        return;
+    }
+    st->last_report = now;
+    if (st->drop_hop || st->drop_src || st->drop_origin || st->drop_relay ||
+        st->drop_reply || st->drop_inv) {
+        char who[32] = "";
+        if (st->id >= 0) {
+            snprintf(who, sizeof(who), " (worker %d)", st->id);
+        }
+        fprintf(stderr, "[Agent] Ignorés%s: hop=%lu source=%lu origin=%lu relais=%lu"
+                " reply=%lu inventaire=%lu\n", who,
+                st->drop_hop, st->drop_src, st->drop_origin, st->drop_relay,
+                st->drop_reply, st->drop_inv);
+        st->drop_hop = st->drop_src = st->drop_origin = 0;
+        st->drop_relay = st->drop_reply = st->drop_inv = 0;
+    }
+}
+
+static uint64_t seen_key(const char *origin, int msg_id) {
+    return hash_bytes(origin, strlen(origin), (uint64_t)(uint32_t)msg_id << 8);
+}
+
+// Vérifie si (origin, message_id) déjà vu depuis moins de SEEN_TTL_MS
+static int has_already_seen(const discovery_state_t *st, const char *origin, int msg_id,
+                            uint32_t now) {
+    uint64_t key = seen_key(origin, msg_id);
+    size_t start = (size_t)(key ^ (key >> 29)) & (RL_TABLE_SIZE - 1);
+    for (size_t i = 0; i < RL_PROBES; i++) {
+        const rl_entry_t *e = &st->seen_table[(start + i) & (RL_TABLE_SIZE - 1)];
+        if (e->key == key) {
+            return (uint32_t)(now - e->stamp_ms) < SEEN_TTL_MS;
+        }
+    }
+    return 0;
+}
+
+// Marque (origin, message_id) comme vu
+static void mark_as_seen(discovery_state_t *st, const char *origin, int msg_id, uint32_t now) {
+    int created;
+    rl_entry_t *e = rl_lookup(st->seen_table, seen_key(origin, msg_id), now, &created);
+    e->stamp_ms = now;
+}
+
+/*
+ * Filtre BPF classique attaché au socket UDP.
+ *
+ * Sur un socket UDP, le programme voit le paquet à partir de l'en-tête UDP :
+ * la charge utile commence à l'offset 8. On accepte uniquement
+ *    "NEIGHBOR_DISCOVERY message_id=<1 à 11 car.> hop=<1..HOP_MAX> ..."
+ * Le cBPF n'a pas de boucle : la recherche de " hop=" après le message_id,
+ * de longueur variable, est déroulée pour chaque position possible.
+ * Le reste (origin, path, reply) est toujours validé en espace utilisateur.
+ */
+#if HOP_MAX > 9
+#error "Le filtre BPF suppose un hop sur un seul chiffre"
+#endif
+
+#define BPF_UDP_HDR     8
+#define BPF_MIN_PAYLOAD 46   // "NEIGHBOR_DISCOVERY message_id=0 hop=1 origin=x"
+#define BPF_ID_MAXLEN   11   // "-2147483648"
+#define BPF_PROG_MAX    160
+#define BPF_TO_DROP     0xFE // cibles symboliques, résolues à la fin
+#define BPF_TO_ACCEPT   0xFD
+
+static struct sock_filter bpf_insns[BPF_PROG_MAX];
+static unsigned short bpf_count;
+
+static void bpf_emit(unsigned short code, unsigned char jt, unsigned char jf,
+                     unsigned int k)
+{
+    struct sock_filter insn = { code, jt, jf, k };
+    bpf_insns[bpf_count++] = insn;
+}
+
+// Octets 'str' (4 max) lus en big-endian, comme le fait BPF_LD
+static unsigned int bpf_word(const char *str, size_t len) {
+    unsigned int k = 0;
+    for (size_t i = 0; i < len; i++) {
+        k = (k << 8) | (unsigned char)str[i];
+    }
+    return k;
+}
+
+static void build_discovery_filter(void) {
+    static const char prefix[] = "NEIGHBOR_DISCOVERY message_id=";
+    const size_t prefix_len = sizeof(prefix) - 1;
+
+    bpf_count = 0;
+
+    // Taille : ni trop court pour être valide, ni plus grand que notre buffer
+    bpf_emit(BPF_LD | BPF_W | BPF_LEN, 0, 0, 0);
+    bpf_emit(BPF_JMP | BPF_JGE | BPF_K, 0, BPF_TO_DROP, BPF_UDP_HDR + BPF_MIN_PAYLOAD);
+    bpf_emit(BPF_JMP | BPF_JGT | BPF_K, BPF_TO_DROP, 0, BPF_UDP_HDR + BUFFER_SIZE - 1);
+
+    // Préfixe fixe, par mots de 4 octets puis le reliquat octet par octet
+    size_t off = 0;
+    for (; off + 4 <= prefix_len; off += 4) {
+        bpf_emit(BPF_LD | BPF_W | BPF_ABS, 0, 0, BPF_UDP_HDR + off);
+        bpf_emit(BPF_JMP | BPF_JEQ | BPF_K, 0, BPF_TO_DROP, bpf_word(prefix + off, 4));
+    }
+    for (; off < prefix_len; off++) {
+        bpf_emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, BPF_UDP_HDR + off);
+        bpf_emit(BPF_JMP | BPF_JEQ | BPF_K, 0, BPF_TO_DROP, (unsigned char)prefix[off]);
+    }
+
+    // " hop=N " après un message_id de 1 à BPF_ID_MAXLEN caractères.
+    // Chaque bloc fait 10 insns : si " hop" ne colle pas, on saute au suivant.
+    // Le hop tient sur un seul chiffre (HOP_MAX <= 9), '1' à '0' + HOP_MAX,
+    // suivi d'un espace : "hop=10" ou "hop=1000" sont rejetés.
+    for (size_t idlen = 1; idlen <= BPF_ID_MAXLEN; idlen++) {
+        unsigned int at = BPF_UDP_HDR + prefix_len + idlen;
+        bpf_emit(BPF_LD | BPF_W | BPF_ABS, 0, 0, at);
+        bpf_emit(BPF_JMP | BPF_JEQ | BPF_K, 0, 8, bpf_word(" hop", 4));
+        bpf_emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, at + 4);
+        bpf_emit(BPF_JMP | BPF_JEQ | BPF_K, 0, BPF_TO_DROP, '=');
+        bpf_emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, at + 5);
+        bpf_emit(BPF_JMP | BPF_JGE | BPF_K, 0, BPF_TO_DROP, '1');
+        bpf_emit(BPF_JMP | BPF_JGT | BPF_K, BPF_TO_DROP, 0, '0' + HOP_MAX);
+        bpf_emit(BPF_LD | BPF_B | BPF_ABS, 0, 0, at + 6);
+        bpf_emit(BPF_JMP | BPF_JEQ | BPF_K, 0, BPF_TO_DROP, ' ');
+        bpf_emit(BPF_JMP | BPF_JA, 0, 0, 0); // -> ACCEPT, résolu plus bas
+        bpf_insns[bpf_count - 1].k = BPF_TO_ACCEPT;
+    }
+
+    unsigned short drop = bpf_count;
+    bpf_emit(BPF_RET | BPF_K, 0, 0, 0);
+    unsigned short accept = bpf_count;
+    bpf_emit(BPF_RET | BPF_K, 0, 0, 0xFFFFFFFF);
+
+    // Résolution des sauts symboliques (offsets relatifs à l'insn suivante)
+    for (unsigned short i = 0; i < drop; i++) {
+        struct sock_filter *f = &bpf_insns[i];
+        if (BPF_CLASS(f->code) != BPF_JMP) {
+            continue;
+        }
+        if (BPF_OP(f->code) == BPF_JA) {
+            if (f->k == BPF_TO_ACCEPT) {
+                f->k = accept - i - 1;
+            }
+            continue;
+        }
+        if (f->jt == BPF_TO_DROP) f->jt = drop - i - 1;
+        if (f->jf == BPF_TO_DROP) f->jf = drop - i - 1;
+    }
+}
+
+// Attache le filtre ; en cas d'échec, le tri se fait en espace utilisateur.
+static void attach_discovery_filter(int sockfd) {
+    build_discovery_filter();
+
+    struct sock_fprog fprog = { bpf_count, bpf_insns };
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER,
+                   &fprog, sizeof(fprog)) < 0) {
+        perror("setsockopt(SO_ATTACH_FILTER)");
+        return;
+    }
+    printf("[Agent] Filtre BPF attaché (%u instructions)\n", bpf_count);
+}
+
+/*
+ * Cas limites du filtre, joués dans le noyau : un socket lié sur
+ * 127.0.0.1 (port éphémère) porte le filtre et s'envoie chaque message.
+ * Affiche le sort de chacun ; renvoie 0 si tous ont le sort attendu.
+ */
+static inline int discovery_filter_check(void) {
+    static const struct {
+        const char *msg;
+        int         accept;
+    } cases[] = {
+        { "NEIGHBOR_DISCOVERY message_id=1 hop=1 origin=abc", 1 },
+        { "NEIGHBOR_DISCOVERY message_id=2 hop=8 origin=abc path=x", 1 },
+        { "NEIGHBOR_DISCOVERY message_id=-2147483648 hop=3 origin=abc", 1 },
+        { "NEIGHBOR_DISCOVERY message_id=4 hop=0 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=5 hop=9 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=6 hop=10 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=7 hop=79 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=8 hop=1000 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=9 hop=1xorigin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY message_id=123456789012 hop=1 origin=abc", 0 },
+        { "NEIGHBOR_DISCOVERY hop=1 message_id=11 origin=abc", 0 },
+    };
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    build_discovery_filter();
+    struct sock_fprog fprog = { bpf_count, bpf_insns };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addrlen) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+        perror("filtre");
+        close(fd);
+        return 1;
+    }
+    struct timeval tv = { 0, 100000 }; // un message accepté arrive bien avant
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t len = strlen(cases[i].msg);
+        sendto(fd, cases[i].msg, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        char buf[BUFFER_SIZE];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        int got = n == (ssize_t)len && memcmp(buf, cases[i].msg, len) == 0;
+        failed |= got != cases[i].accept;
+        printf("%-7s %-7s %s\n", got ? "reçu" : "rejeté",
+               got == cases[i].accept ? "OK" : "ERREUR", cases[i].msg);
+    }
+    close(fd);
+    return failed;
+}
+
+// Fonction utilitaire pour envoyer la requête (message) en UDP à une IP donnée
+static void send_udp_message(const char *ip, unsigned short port,
+                             const char *message, size_t msg_len)
+{
+    int sockfd;
+    struct sockaddr_in addr;
+
+    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("socket");
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = inet_addr(ip);
+
+    if (sendto(sockfd, message, msg_len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("sendto");
+    }
+    close(sockfd);
+}
+
+/*
+ * Ce que l'hôte fournit au traitement des messages : son nom, sa passerelle
+ * par défaut (1 si trouvée, 0 sinon) et son inventaire d'adresses encodé
+ * avec inv_put_record() (renvoie la taille écrite). Avec plusieurs
+ * workers, ces fonctions sont appelées en parallèle, sans verrou.
+ */
+typedef struct {
+    const char *hostname;
+    int    (*get_gateway)(char *gw, size_t gwlen);
+    size_t (*get_inventory)(unsigned char *buf, size_t buflen);
+} discovery_host_t;
+
+/*
+ * Ajoute un enregistrement d'inventaire à buf[off..cap[.
+ * Renvoie le nouvel offset, ou off inchangé s'il n'y a plus de place.
+ */
+static size_t inv_put_record(unsigned char *buf, size_t cap, size_t off,
+                             const char *ifname, int family,
+                             const void *addr, int prefixlen)
+{
+    size_t namelen = strnlen(ifname, IF_NAMESIZE - 1); // nom d'interface ou d'alias
+    size_t alen    = (family == AF_INET) ? 4 : 16;
+    size_t need    = 1 + namelen + 2 + alen;
+
+    if (off + need > cap) {
+        return off;
+    }
+    buf[off++] = (unsigned char)namelen;
+    memcpy(buf + off, ifname, namelen);
+    off += namelen;
+    buf[off++] = (family == AF_INET) ? 4 : 6;
+    buf[off++] = (unsigned char)prefixlen;
+    memcpy(buf + off, addr, alen);
+    return off + alen;
+}
+
+// Taille de l'enregistrement à buf[off], 0 s'il est tronqué.
+static size_t inv_record_len(const unsigned char *buf, size_t len, size_t off) {
+    if (off >= len) {
+        return 0;
+    }
+    size_t namelen = buf[off];
+    if (off + 1 + namelen + 2 > len) {
+        return 0;
+    }
+    size_t rec = 1 + namelen + 2 + (buf[off + 1 + namelen] == 4 ? 4 : 16);
+    return (off + rec <= len) ? rec : 0;
+}
+
+/*
+ * Envoie l'inventaire en morceaux d'au plus BUFFER_SIZE - 1 octets, chacun
+ * préfixé par "hostname [path=...] inv=i/n" et un octet nul. Renvoie 0 sans
+ * rien envoyer si le budget d'octets de la destination est épuisé.
+ */
+static int send_inventory_reply(discovery_state_t *st, int sockfd,
+                                const struct sockaddr_in *to,
+                                const discovery_host_t *host, const char *path,
+                                uint32_t now)
+{
+    unsigned char *inv = st->inv;
+    size_t invlen = host->get_inventory(inv, INV_BUFSIZE);
+
+    // En-têtes de taille fixe ("inv=%02d/%02d") : le découpage peut être
+    // calculé avant de connaître le nombre total de morceaux.
+    char first_hdr[BUFFER_SIZE], other_hdr[BUFFER_SIZE];
+    int first_len = path[0]
+        ? snprintf(first_hdr, sizeof(first_hdr), "%s path=%s inv=00/00", host->hostname, path)
+        : snprintf(first_hdr, sizeof(first_hdr), "%s inv=00/00", host->hostname);
+    int other_len = snprintf(other_hdr, sizeof(other_hdr), "%s inv=00/00", host->hostname);
+    if (first_len + 1 >= BUFFER_SIZE || other_len + 1 >= BUFFER_SIZE) {
+        return 0;
+    }
+
+    size_t starts[INV_MAX_PARTS + 1];
+    int parts = 0;
+    size_t off = 0;
+    do {
+        size_t room = BUFFER_SIZE - 1 - (size_t)((parts == 0 ? first_len : other_len) + 1);
+        starts[parts++] = off;
+        size_t used = 0, rec;
+        while ((rec = inv_record_len(inv, invlen, off)) && used + rec <= room) {
+            off  += rec;
+            used += rec;
+        }
+    } while (off < invlen && inv_record_len(inv, invlen, off) && parts < INV_MAX_PARTS);
+    starts[parts] = off;
+
+    // Les en-têtes "inv=" ont la taille de "inv=00/00" : total exact
+    size_t total = (size_t)(first_len + 1) + (size_t)(parts - 1) * (size_t)(other_len + 1) + off;
+    if (!allow_inventory(st, to, total, now)) {
+        return 0;
+    }
+
+    for (int i = 0; i < parts; i++) {
+        char datagram[BUFFER_SIZE];
+        int hlen = (i == 0)
+            ? (path[0]
+               ? snprintf(datagram, sizeof(datagram), "%s path=%s inv=%02d/%02d",
+                          host->hostname, path, i + 1, parts)
+               : snprintf(datagram, sizeof(datagram), "%s inv=%02d/%02d",
+                          host->hostname, i + 1, parts))
+            : snprintf(datagram, sizeof(datagram), "%s inv=%02d/%02d",
+                       host->hostname, i + 1, parts);
+        size_t chunk = starts[i + 1] - starts[i];
+        datagram[hlen] = '\0';
+        memcpy(datagram + hlen + 1, inv + starts[i], chunk);
+
+        if (sendto(sockfd, datagram, hlen + 1 + chunk, 0,
+                   (const struct sockaddr *)to, sizeof(*to)) < 0) {
+            perror("sendto inventory");
+            break;
+        }
+    }
+    return 1;
+}
+
+// Extrait les champs optionnels "path=", "reply=ip:port" et "inv=1" d'un
+// message. path est vide et reply_addr->sin_family vaut 0 si absents.
+static void parse_optional_fields(const char *buffer,
+                                  char *path, size_t pathlen,
+                                  struct sockaddr_in *reply_addr,
+                                  int *want_inventory)
+{
+    memset(path, 0, pathlen);
+    memset(reply_addr, 0, sizeof(*reply_addr));
+    *want_inventory = (strstr(buffer, " inv=1") != NULL);
+
+    const char *p = strstr(buffer, " path=");
+    if (p) {
+        p += 6;
+        size_t n = strcspn(p, " ");
+        if (n < pathlen) {
+            memcpy(path, p, n);
+        }
+    }
+
+    const char *r = strstr(buffer, " reply=");
+    if (r) {
+        char ip[64];
+        unsigned int port = 0;
+        if (sscanf(r + 7, "%63[^: ]:%u", ip, &port) == 2 && port > 0 && port < 65536 &&
+            inet_pton(AF_INET, ip, &reply_addr->sin_addr) == 1) {
+            reply_addr->sin_family = AF_INET;
+            reply_addr->sin_port   = htons((unsigned short)port);
+        }
+    }
+}
+
+/*
+ * Traite un datagramme reçu sur le port de découverte : validation,
+ * garde-fous (tables de 'st'), réponse au client et relais éventuel vers
+ * la passerelle de l'hôte.
+ */
+static void discovery_handle(discovery_state_t *st, int sockfd, const char *buffer,
+                             const struct sockaddr_in *client_addr,
+                             const discovery_host_t *host)
+{
+    const char *hostname = host->hostname;
+
+    uint32_t now = now_ms();
+    report_drops(st, now);
+
+    // On s'attend à un message du type:
+    //    "NEIGHBOR_DISCOVERY message_id=1234 hop=3 origin=MachineA"
+    // On va parser ça très simplement
+    int msg_id = 0;
+    int hop    = 0;
+    char origin[64];
+    memset(origin, 0, sizeof(origin));
+
+    if (strncmp(buffer, "NEIGHBOR_DISCOVERY", 18) == 0) {
+        // Extraire message_id, hop, origin
+        // Format naïf : "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s"
+        char dummy[32]; // pour "NEIGHBOR_DISCOVERY"
+        if (sscanf(buffer, "%31s message_id=%d hop=%d origin=%63s",
+                   dummy, &msg_id, &hop, origin) == 4)
+        {
+            // Garde-fous : hop borné, puis débit par IP source (avant
+            // même la déduplication, qui coûte une recherche), puis
+            // débit par origin pour les message_id nouveaux.
+            if (hop < 1 || hop > HOP_MAX) {
+                st->drop_hop++;
+            } else if (!allow_source(st, client_addr, now)) {
+                st->drop_src++;
+            } else if (has_already_seen(st, origin, msg_id, now)) {
+                // déjà vu, on ne fait rien
+            } else if (!allow_origin(st, origin, now)) {
+                st->drop_origin++;
+            } else {
+                // Marquer comme vu
+                mark_as_seen(st, origin, msg_id, now);
+
+                char path[PATH_SIZE];
+                struct sockaddr_in reply_addr;
+                int want_inventory;
+                parse_optional_fields(buffer, path, sizeof(path), &reply_addr,
+                                      &want_inventory);
+
+                // Un message relayé arrive depuis le socket éphémère du
+                // relais : on répond à l'adresse "reply=" du client d'origine,
+                // dans la limite de REPLY_RATE réponses par seconde vers elle.
+                if (reply_addr.sin_family != AF_INET ||
+                    reply_addr.sin_addr.s_addr == client_addr->sin_addr.s_addr) {
+                    reply_addr = *client_addr;
+                } else if (!allow_reply(st, &reply_addr, now)) {
+                    st->drop_reply++;
+                    return;
+                }
+
+                // Répondre immédiatement au client -> on envoie "hostname"
+                // (suivi du chemin reçu si le client en a fourni un) ;
+                // l'inventaire n'est joint que dans le budget d'octets.
+                int sent_inventory = 0;
+                if (want_inventory && host->get_inventory) {
+                    sent_inventory = send_inventory_reply(st, sockfd, &reply_addr, host, path, now);
+                    if (!sent_inventory) {
+                        st->drop_inv++;
+                    }
+                }
+                if (!sent_inventory) {
+                    // Assez grand pour tout hostname et tout chemin ; sur le fil,
+                    // la réponse reste bornée à un datagramme de BUFFER_SIZE - 1
+                    char response[HOSTNAME_MAX + PATH_SIZE + 8];
+                    if (path[0]) {
+                        snprintf(response, sizeof(response), "%s path=%s",
+                                 hostname, path);
+                    } else {
+                        snprintf(response, sizeof(response), "%s", hostname);
+                    }
+                    size_t rlen = strlen(response);
+                    if (rlen > BUFFER_SIZE - 1) {
+                        rlen = BUFFER_SIZE - 1;
+                    }
+                    ssize_t sent = sendto(sockfd,
+                                          response,
+                                          rlen,
+                                          0,
+                                          (struct sockaddr *)&reply_addr,
+                                          sizeof(reply_addr));
+                    if (sent < 0) {
+                        perror("sendto response");
+                    }
+                }
+
+                // Si hop > 1, relayer vers la gateway (hop - 1)
+                // On s'ajoute au chemin ; s'il n'y a plus de place, on ne
+                // relaie pas plutôt que d'annoncer une topologie fausse.
+                if (hop > 1 && path[0] &&
+                    strlen(path) + 1 + strlen(hostname) >= sizeof(path)) {
+                    fprintf(stderr, "[Agent] Chemin trop long, pas de relais (%s)\n", origin);
+                } else if (hop > 1 && !allow_relay(now)) {
+                    st->drop_relay++;
+                } else if (hop > 1) {
+                    // Récupère la GW
+                    char gateway[64];
+                    if (host->get_gateway(gateway, sizeof(gateway))) {
+                        char ipstr[INET_ADDRSTRLEN];
+                        inet_ntop(AF_INET, &reply_addr.sin_addr, ipstr, sizeof(ipstr));
+
+                        // Construit le nouveau message
+                        char new_msg[BUFFER_SIZE];
+                        if (path[0]) {
+                            snprintf(new_msg, sizeof(new_msg),
+                                     "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s"
+                                     " path=%s,%s reply=%s:%u%s",
+                                     msg_id, hop - 1, origin, path, hostname,
+                                     ipstr, ntohs(reply_addr.sin_port),
+                                     want_inventory ? " inv=1" : "");
+                        } else {
+                            snprintf(new_msg, sizeof(new_msg),
+                                     "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s"
+                                     " reply=%s:%u%s",
+                                     msg_id, hop - 1, origin,
+                                     ipstr, ntohs(reply_addr.sin_port),
+                                     want_inventory ? " inv=1" : "");
+                        }
+
+                        // Envoie en unicast à la GW
+                        send_udp_message(gateway, AGENT_PORT,
+                                         new_msg, strlen(new_msg));
+                        // NOTE : Sur un routeur, on voudrait diffuser
+                        //        sur chaque interface (sauf celle d'où
+                        //        est venue la requête). Ici, on se limite
+                        //        à la gateway par défaut : BFS simple.
+                    }
+                }
+            }
+        }
+        // sinon -> format invalide, on ignore
+    }
+    // sinon -> message non reconnu, on ignore
+}
+
+#endif /* NEIGHBOURPROTO_H */
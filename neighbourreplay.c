@@ -0,0 +1,378 @@
+/****************************************************
+ * neighbourreplay.c
+ *
+ * Compilation :
+ *    gcc -O2 neighbourreplay.c -o neighbourreplay
+ *
+ * Exécution (exemples) :
+ *    ./neighbourreplay -f capture.nscap                 # vitesse réelle
+ *    ./neighbourreplay -f capture.nscap -speed 10       # 10x
+ *    ./neighbourreplay -f capture.nscap -speed 0 -loop 20   # au plus vite
+ *
+ * Explications :
+ *  - Rejoue un journal capturé par "neighbourshowagent -record" (format :
+ *    neighbourcap.h) contre un agent local (-target, 127.0.0.1 par défaut),
+ *    à la vitesse d'origine, N fois plus vite, ou sans attente (-speed 0).
+ *  - Chaque source d'origine a son propre socket, lié à 127.b.c.d pour
+ *    l'IP source a.b.c.d : les seaux de jetons par source de l'agent
+ *    voient la même répartition qu'en production.
+ *  - Sauf avec -verbatim, chaque message est réécrit :
+ *       "reply=" est retiré (les réponses nous reviennent),
+ *       "path=" est remplacé par un jeton "rp<numéro>" que l'agent renvoie
+ *       dans sa réponse : on mesure la latence exacte de chaque message ;
+ *       à partir du 2e tour (-loop), l'origin reçoit un suffixe "~<tour>"
+ *       pour ne pas être écarté par la déduplication.
+ *  - Affiche le débit d'envoi, le nombre de réponses et les percentiles
+ *    de latence : un banc déterministe du chemin analyse / déduplication /
+ *    relais de l'agent. (Les messages hop>1 sont relayés par l'agent vers
+ *    sa passerelle : lancer le banc dans un namespace isolé au besoin.)
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+#include "neighbourcap.h"
+
+#define AGENT_PORT    9999
+#define BUFFER_SIZE   1024
+#define MAX_SRC_SOCKS 1024
+
+typedef struct {
+    const cap_rec_hdr_t *hdr;
+    const char          *data;
+} record_t;
+
+static int      epfd;
+static uint64_t *sent_ns;     // instant d'envoi par numéro de message
+static uint64_t *latency_ns;  // latences mesurées
+static long      latency_count;
+static long      replies_total;
+static unsigned long seq_total;  // nombre de numéros de message alloués
+
+// Une source d'origine -> un socket lié à 127.b.c.d
+static uint32_t src_keys[MAX_SRC_SOCKS];
+static int      src_fds[MAX_SRC_SOCKS];
+static int      src_count;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s -f <capture> [-target ip] [-speed x] [-loop n]\n"
+                    "          [-wait ms] [-verbatim] [-onesrc]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static int open_source(uint32_t bind_addr) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+    int buf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family      = AF_INET;
+    a.sin_addr.s_addr = bind_addr;
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        perror("bind");
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    return fd;
+}
+
+static int source_for(uint32_t orig_addr, int one_source) {
+    if (one_source) {
+        if (src_count == 0) {
+            src_fds[src_count++] = open_source(htonl(INADDR_ANY));
+        }
+        return src_fds[0];
+    }
+    for (int i = 0; i < src_count; i++) {
+        if (src_keys[i] == orig_addr) {
+            return src_fds[i];
+        }
+    }
+    if (src_count == MAX_SRC_SOCKS) {
+        return src_fds[ntohl(orig_addr) % MAX_SRC_SOCKS];
+    }
+    uint32_t mapped = htonl((127u << 24) | (ntohl(orig_addr) & 0x00FFFFFFu));
+    src_keys[src_count] = orig_addr;
+    src_fds[src_count]  = open_source(mapped);
+    return src_fds[src_count++];
+}
+
+/*
+ * Réécrit un message de découverte : sans "reply=", avec "path=rp<seq>",
+ * et l'origin suffixée par "~<tour>" au-delà du premier tour.
+ * Les autres datagrammes sont copiés tels quels.
+ */
+static size_t rewrite_message(const char *in, size_t len, char *out, size_t outlen,
+                              unsigned long seq, int loop)
+{
+    if (len < 18 || strncmp(in, "NEIGHBOR_DISCOVERY", 18) != 0 || len >= outlen) {
+        size_t n = len < outlen ? len : outlen;
+        memcpy(out, in, n);
+        return n;
+    }
+
+    char msg[BUFFER_SIZE];
+    memcpy(msg, in, len);
+    msg[len] = '\0';
+
+    size_t off = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(msg, " ", &save); tok; tok = strtok_r(NULL, " ", &save)) {
+        if (strncmp(tok, "path=", 5) == 0 || strncmp(tok, "reply=", 6) == 0) {
+            continue;
+        }
+        int n;
+        if (loop > 0 && strncmp(tok, "origin=", 7) == 0) {
+            n = snprintf(out + off, outlen - off, "%s%s~%d", off ? " " : "", tok, loop);
+        } else {
+            n = snprintf(out + off, outlen - off, "%s%s", off ? " " : "", tok);
+        }
+        if (n < 0 || (size_t)n >= outlen - off) {
+            return off;
+        }
+        off += n;
+    }
+    int n = snprintf(out + off, outlen - off, " path=rp%lu", seq);
+    if (n > 0 && (size_t)n < outlen - off) {
+        off += n;
+    }
+    return off;
+}
+
+// Lit toutes les réponses disponibles, sans bloquer plus de timeout_ms
+static void drain_replies(int timeout_ms) {
+    struct epoll_event evs[64];
+    int n = epoll_wait(epfd, evs, 64, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        char buf[BUFFER_SIZE];
+        ssize_t r;
+        while ((r = recv(evs[i].data.fd, buf, sizeof(buf) - 1, 0)) >= 0) {
+            uint64_t now = cap_clock_ns(CLOCK_MONOTONIC);
+            buf[r] = '\0';
+            replies_total++;
+            const char *p = strstr(buf, " path=rp");
+            if (!p) {
+                continue;
+            }
+            unsigned long seq = strtoul(p + 8, NULL, 10);
+            // Seule la première réponse à un message compte (inventaire en
+            // plusieurs morceaux, doublons)
+            if (seq < seq_total && sent_ns[seq]) {
+                latency_ns[latency_count++] = now - sent_ns[seq];
+                sent_ns[seq] = 0;
+            }
+        }
+    }
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(double p) {
+    if (latency_count == 0) {
+        return 0;
+    }
+    long idx = (long)(p * (latency_count - 1) + 0.5);
+    return latency_ns[idx] / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    const char *target_ip = "127.0.0.1";
+    double speed = 1.0;
+    int loops = 1, wait_ms = 1000, verbatim = 0, one_source = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i+1 < argc)            path = argv[++i];
+        else if (strcmp(argv[i], "-target") == 0 && i+1 < argc)  target_ip = argv[++i];
+        else if (strcmp(argv[i], "-speed") == 0 && i+1 < argc)   speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "-loop") == 0 && i+1 < argc)    loops = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-wait") == 0 && i+1 < argc)    wait_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-verbatim") == 0)              verbatim = 1;
+        else if (strcmp(argv[i], "-onesrc") == 0)                one_source = 1;
+        else usage(argv[0]);
+    }
+    if (!path || speed < 0 || loops < 1) {
+        usage(argv[0]);
+    }
+
+    struct sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port   = htons(AGENT_PORT);
+    if (inet_pton(AF_INET, target_ip, &target.sin_addr) != 1) {
+        usage(argv[0]);
+    }
+    // Les adresses 127.b.c.d ne sont joignables que sur lo
+    if ((ntohl(target.sin_addr.s_addr) >> 24) != 127) {
+        one_source = 1;
+    }
+
+    // Le journal est projeté en mémoire : aucune E/S pendant le rejeu
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(cap_file_hdr_t)) {
+        fprintf(stderr, "%s : journal trop court\n", path);
+        return 1;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (memcmp(map, CAP_MAGIC, sizeof(CAP_MAGIC)) != 0) {
+        fprintf(stderr, "%s : pas un journal de capture\n", path);
+        return 1;
+    }
+
+    // Index des enregistrements
+    long nrec = 0, cap = 1024;
+    record_t *recs = xrealloc(NULL, cap * sizeof(*recs));
+    size_t off = sizeof(cap_file_hdr_t);
+    while (off + sizeof(cap_rec_hdr_t) <= (size_t)st.st_size) {
+        const cap_rec_hdr_t *h = (const cap_rec_hdr_t *)(map + off);
+        if (off + sizeof(*h) + h->len > (size_t)st.st_size) {
+            break; // dernier enregistrement tronqué (agent tué en pleine écriture)
+        }
+        if (nrec == cap) {
+            cap *= 2;
+            recs = xrealloc(recs, cap * sizeof(*recs));
+        }
+        recs[nrec].hdr  = h;
+        recs[nrec].data = map + off + sizeof(*h);
+        nrec++;
+        off += sizeof(*h) + h->len;
+    }
+    if (nrec == 0) {
+        fprintf(stderr, "%s : aucun enregistrement\n", path);
+        return 1;
+    }
+
+    long total = nrec * loops;
+    seq_total  = (unsigned long)total;
+    sent_ns    = calloc(total, sizeof(*sent_ns));
+    latency_ns = calloc(total, sizeof(*latency_ns));
+    epfd = epoll_create1(0);
+    if (!sent_ns || !latency_ns || epfd < 0) {
+        perror("init");
+        return 1;
+    }
+
+    uint64_t span_ns = recs[nrec - 1].hdr->ts_ns;
+    char speed_str[32];
+    if (speed > 0) {
+        snprintf(speed_str, sizeof(speed_str), "%gx", speed);
+    } else {
+        snprintf(speed_str, sizeof(speed_str), "max");
+    }
+    printf("[Replay] %ld datagrammes (%.3f s capturés) x %d tour(s) -> %s, vitesse %s\n",
+           nrec, span_ns / 1e9, loops, target_ip, speed_str);
+
+    uint64_t t0 = cap_clock_ns(CLOCK_MONOTONIC);
+    long sent = 0, send_errors = 0;
+
+    for (int loop = 0; loop < loops; loop++) {
+        for (long i = 0; i < nrec; i++) {
+            unsigned long seq = (unsigned long)loop * nrec + i;
+
+            if (speed > 0) {
+                // Les tours s'enchaînent : le tour L commence après L durées
+                uint64_t due = t0 + (uint64_t)((loop * (span_ns + 1000000) +
+                                                recs[i].hdr->ts_ns) / speed);
+                uint64_t now = cap_clock_ns(CLOCK_MONOTONIC);
+                while (now < due) {
+                    // On attend en lisant les réponses
+                    drain_replies((int)((due - now) / 1000000));
+                    now = cap_clock_ns(CLOCK_MONOTONIC);
+                    if (due - now < 1000000) {
+                        break;
+                    }
+                }
+            }
+
+            char out[BUFFER_SIZE];
+            size_t len = verbatim
+                ? (recs[i].hdr->len < sizeof(out) ? recs[i].hdr->len : sizeof(out))
+                : rewrite_message(recs[i].data, recs[i].hdr->len, out, sizeof(out),
+                                  seq, loop);
+            const char *payload = verbatim ? recs[i].data : out;
+
+            int sfd = source_for(recs[i].hdr->src_addr, one_source);
+            sent_ns[seq] = cap_clock_ns(CLOCK_MONOTONIC);
+            int ok = 1;
+            while (sendto(sfd, payload, len, 0,
+                          (struct sockaddr *)&target, sizeof(target)) < 0) {
+                if (errno == EAGAIN || errno == ENOBUFS) {
+                    drain_replies(0);
+                    continue;
+                }
+                send_errors++;
+                sent_ns[seq] = 0;
+                ok = 0;
+                break;
+            }
+            if (!ok) {
+                continue; // seuls les datagrammes partis comptent comme envoyés
+            }
+            sent++;
+
+            if ((sent & 63) == 0) {
+                drain_replies(0);
+            }
+        }
+    }
+    double send_secs = (cap_clock_ns(CLOCK_MONOTONIC) - t0) / 1e9;
+
+    // Réponses retardataires
+    uint64_t deadline = cap_clock_ns(CLOCK_MONOTONIC) + (uint64_t)wait_ms * 1000000;
+    while (cap_clock_ns(CLOCK_MONOTONIC) < deadline) {
+        drain_replies(50);
+    }
+
+    qsort(latency_ns, latency_count, sizeof(*latency_ns), cmp_u64);
+    printf("[Replay] Envoyés   : %ld (%ld erreurs) en %.3f s, %.0f msg/s, %d source(s)\n",
+           sent, send_errors, send_secs, send_secs > 0 ? sent / send_secs : 0.0, src_count);
+    printf("[Replay] Réponses  : %ld datagrammes, %ld messages servis (%.1f %%)\n",
+           replies_total, latency_count, sent ? 100.0 * latency_count / sent : 0.0);
+    if (!verbatim && latency_count > 0) {
+        printf("[Replay] Latence   : p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+               percentile_us(0.50), percentile_us(0.90), percentile_us(0.99),
+               latency_ns[latency_count - 1] / 1e3);
+    }
+    return 0;
+}
@@ -8,12 +8,32 @@
  *    ./neighborshow
  *    ./neighborshow -hop 1
  *    ./neighborshow -hop 2
+ *    ./neighborshow -hop 3 -graph dot | dot -Tsvg > topo.svg
+ *    ./neighborshow -hop 3 -graph json
+ *    ./neighborshow -hop 2 -inv
+ *    ./neighborshow --local
+ *    ./neighborshow --local -state reachable,stale -merge
  *
  * Explications :
  *  - Envoie un broadcast sur 255.255.255.255:9999
- *  - Message du type "NEIGHBOR_DISCOVERY message_id=XXX hop=N origin=YYY"
- *  - Attend 2s de réponses
- *  - Stocke et affiche les hostnames reçus
+ *  - Message du type "NEIGHBOR_DISCOVERY message_id=XXX hop=N origin=YYY path=YYY"
+ *  - Chaque relais s'ajoute à "path", et les agents renvoient
+ *    "hostname path=YYY,relais1,..." : on en déduit les arêtes du graphe
+ *  - Avec -inv, le message porte "inv=1" : chaque agent joint à sa réponse
+ *    l'inventaire binaire de ses adresses (voir neighbourproto.h), en un ou
+ *    plusieurs datagrammes "hostname ... inv=i/n\0<binaire>". Découverte et
+ *    inventaire tiennent alors en un seul aller-retour.
+ *  - Attend 2s de réponses (-timeout ms pour changer ce délai)
+ *  - -dest ip : envoi unicast au lieu du broadcast (p.ex. vers neighbouremu)
+ *  - -stats : résumé sur stderr (réponses, répondants, délai du dernier
+ *    nouveau répondant), utilisé par neighboursim.sh
+ *  - Stocke et affiche les hostnames reçus (ou le graphe en DOT / JSON)
+ *  - --local : affiche directement la table des voisins du noyau (ARP et
+ *    NDP, un dump RTM_GETNEIGH), filtrée par état avec -state
+ *    (reachable,stale,delay,probe,permanent par défaut ; "all" pour tout).
+ *    Avec -merge, lance aussi la découverte (avec inventaire) et indique
+ *    quels voisins font tourner l'agent, par adresse source de la réponse
+ *    ou par les adresses de l'inventaire.
  ****************************************************/
 
 #include <stdio.h>
@@ -26,15 +46,628 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <time.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <net/if.h>
+
+#include "nlutil.h"
 
 #define AGENT_PORT 9999
 #define BUFFER_SIZE 1024
+#define HOP_MAX 8 // au-delà, les agents ignorent le message
+
+enum { OUTPUT_LIST, OUTPUT_DOT, OUTPUT_JSON };
 
 static void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-hop n]\n", prog);
+    fprintf(stderr, "Usage: %s [-hop n] [-graph dot|json] [-inv] [-timeout ms] [-stats]\n"
+                    "          [-dest ip]\n"
+                    "       %s --local [-state s1,s2,...|all] [-merge [-hop n] [-timeout ms]]\n",
+            prog, prog);
     exit(EXIT_FAILURE);
 }
 
+/*
+ * Graphe de topologie en mémoire.
+ *  - les noeuds (hostnames) sont indexés par une table de hachage à adressage
+ *    ouvert, pour dédupliquer sans parcourir toute la liste à chaque réponse ;
+ *  - les arêtes sont des paires (a, b) d'indices de noeuds, dédupliquées par
+ *    une seconde table de hachage.
+ * Les tables doublent quand elles sont à moitié pleines.
+ */
+typedef struct {
+    char **names;      // names[i] = hostname du noeud i
+    int    count;
+    int    cap;
+    int   *slots;      // table de hachage : indice de noeud + 1, 0 = libre
+    size_t nslots;
+} node_set_t;
+
+typedef struct {
+    int   *pairs;      // pairs[2*i], pairs[2*i+1] = extrémités de l'arête i
+    int    count;
+    int    cap;
+    int   *slots;
+    size_t nslots;
+} edge_set_t;
+
+static uint32_t hash_str(const char *s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t hash_pair(int a, int b) {
+    uint64_t x = ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void node_rehash(node_set_t *ns, size_t nslots) {
+    free(ns->slots);
+    ns->slots  = calloc(nslots, sizeof(int));
+    ns->nslots = nslots;
+    if (!ns->slots) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ns->count; i++) {
+        size_t h = hash_str(ns->names[i]) & (nslots - 1);
+        while (ns->slots[h]) {
+            h = (h + 1) & (nslots - 1);
+        }
+        ns->slots[h] = i + 1;
+    }
+}
+
+// Renvoie l'indice du noeud 'name', en le créant s'il est nouveau.
+static int node_intern(node_set_t *ns, const char *name) {
+    if ((size_t)(ns->count + 1) * 2 > ns->nslots) {
+        node_rehash(ns, ns->nslots ? ns->nslots * 2 : 64);
+    }
+    size_t h = hash_str(name) & (ns->nslots - 1);
+    while (ns->slots[h]) {
+        int idx = ns->slots[h] - 1;
+        if (strcmp(ns->names[idx], name) == 0) {
+            return idx;
+        }
+        h = (h + 1) & (ns->nslots - 1);
+    }
+    if (ns->count == ns->cap) {
+        ns->cap   = ns->cap ? ns->cap * 2 : 64;
+        ns->names = xrealloc(ns->names, ns->cap * sizeof(char *));
+    }
+    ns->names[ns->count] = strdup(name);
+    ns->slots[h] = ns->count + 1;
+    return ns->count++;
+}
+
+static void edge_rehash(edge_set_t *es, size_t nslots) {
+    free(es->slots);
+    es->slots  = calloc(nslots, sizeof(int));
+    es->nslots = nslots;
+    if (!es->slots) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < es->count; i++) {
+        size_t h = hash_pair(es->pairs[2*i], es->pairs[2*i+1]) & (nslots - 1);
+        while (es->slots[h]) {
+            h = (h + 1) & (nslots - 1);
+        }
+        es->slots[h] = i + 1;
+    }
+}
+
+// Ajoute l'arête a -> b si elle n'existe pas déjà.
+static void edge_add(edge_set_t *es, int a, int b) {
+    if (a == b) {
+        return;
+    }
+    if ((size_t)(es->count + 1) * 2 > es->nslots) {
+        edge_rehash(es, es->nslots ? es->nslots * 2 : 64);
+    }
+    size_t h = hash_pair(a, b) & (es->nslots - 1);
+    while (es->slots[h]) {
+        int idx = es->slots[h] - 1;
+        if (es->pairs[2*idx] == a && es->pairs[2*idx+1] == b) {
+            return;
+        }
+        h = (h + 1) & (es->nslots - 1);
+    }
+    if (es->count == es->cap) {
+        es->cap   = es->cap ? es->cap * 2 : 64;
+        es->pairs = xrealloc(es->pairs, es->cap * 2 * sizeof(int));
+    }
+    es->pairs[2*es->count]   = a;
+    es->pairs[2*es->count+1] = b;
+    es->slots[h] = es->count + 1;
+    es->count++;
+}
+
+// Ce qu'on sait de chaque noeud, indexé comme node_set_t.names
+typedef struct {
+    char     responded;   // le noeud a répondu lui-même
+    uint32_t parts_seen;  // morceaux d'inventaire reçus (bit i = morceau i+1)
+    char    *inv;         // inventaire décodé, "ifname: addr/prefix\n" par ligne
+    size_t   inv_len;
+    size_t   inv_cap;
+    struct in_addr sender; // adresse d'où est venue sa première réponse
+} node_info_t;
+
+/*
+ * Intègre une réponse "hostname" ou "hostname path=a,b,c [inv=i/n]" au graphe.
+ * Renvoie l'indice du noeud qui a répondu, -1 si la réponse est vide.
+ * *part / *parts reçoivent le numéro de morceau d'inventaire (0 si absent).
+ * Les anciens agents ne renvoient que le hostname : pas d'arête dans ce cas.
+ */
+static int record_reply(node_set_t *ns, edge_set_t *es, char *reply,
+                        int *part, int *parts) {
+    *part = *parts = 0;
+    char *inv = strstr(reply, " inv=");
+    if (inv) {
+        if (sscanf(inv + 5, "%d/%d", part, parts) != 2) {
+            *part = *parts = 0;
+        }
+        *inv = '\0';
+    }
+    char *path = strstr(reply, " path=");
+    if (path) {
+        *path = '\0';
+        path += 6;
+        path[strcspn(path, " ")] = '\0';
+    }
+    reply[strcspn(reply, " ")] = '\0';
+    if (reply[0] == '\0') {
+        return -1;
+    }
+    int self = node_intern(ns, reply);
+    if (!path) {
+        return self;
+    }
+
+    int prev = -1;
+    char *saveptr = NULL;
+    for (char *hop = strtok_r(path, ",", &saveptr); hop;
+         hop = strtok_r(NULL, ",", &saveptr)) {
+        int cur = node_intern(ns, hop);
+        if (prev >= 0) {
+            edge_add(es, prev, cur);
+        }
+        prev = cur;
+    }
+    if (prev >= 0) {
+        edge_add(es, prev, self);
+    }
+    return self;
+}
+
+static void info_append(node_info_t *info, const char *text, size_t len) {
+    if (info->inv_len + len + 1 > info->inv_cap) {
+        info->inv_cap = (info->inv_len + len + 1) * 2;
+        info->inv = xrealloc(info->inv, info->inv_cap);
+    }
+    memcpy(info->inv + info->inv_len, text, len);
+    info->inv_len += len;
+    info->inv[info->inv_len] = '\0';
+}
+
+/*
+ * Décode un morceau d'inventaire binaire :
+ *    [lg nom u8][nom][famille u8 : 4 ou 6][préfixe u8][adresse 4|16 o.]
+ * Un morceau déjà reçu (doublon réseau) est ignoré.
+ */
+static void record_inventory(node_info_t *info, int part, int parts,
+                             const unsigned char *bin, size_t len)
+{
+    if (part < 1 || part > parts || part > 32) {
+        return;
+    }
+    uint32_t bit = 1u << (part - 1);
+    if (info->parts_seen & bit) {
+        return;
+    }
+    info->parts_seen |= bit;
+
+    size_t off = 0;
+    while (off < len) {
+        size_t namelen = bin[off];
+        if (off + 1 + namelen + 2 > len) {
+            break;
+        }
+        int family = bin[off + 1 + namelen] == 4 ? AF_INET : AF_INET6;
+        int prefix = bin[off + 2 + namelen];
+        size_t alen = (family == AF_INET) ? 4 : 16;
+        if (off + 3 + namelen + alen > len) {
+            break;
+        }
+
+        char addr_str[INET6_ADDRSTRLEN];
+        char line[512];
+        inet_ntop(family, bin + off + 3 + namelen, addr_str, sizeof(addr_str));
+        int n = snprintf(line, sizeof(line), "%.*s: %s/%d\n",
+                         (int)namelen, (const char *)bin + off + 1, addr_str, prefix);
+        info_append(info, line, n);
+        off += 3 + namelen + alen;
+    }
+}
+
+// Échappe une chaîne pour DOT / JSON (guillemets et antislash).
+static void print_quoted(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)*s >= 0x20) {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+static void print_graph_dot(const node_set_t *ns, const edge_set_t *es) {
+    printf("digraph neighbors {\n");
+    for (int i = 0; i < ns->count; i++) {
+        printf("  n%d [label=", i);
+        print_quoted(ns->names[i]);
+        printf("];\n");
+    }
+    for (int i = 0; i < es->count; i++) {
+        printf("  n%d -> n%d;\n", es->pairs[2*i], es->pairs[2*i+1]);
+    }
+    printf("}\n");
+}
+
+static void print_graph_json(const node_set_t *ns, const edge_set_t *es,
+                             const node_info_t *info) {
+    printf("{\"nodes\":[");
+    for (int i = 0; i < ns->count; i++) {
+        printf(i ? "," : "");
+        print_quoted(ns->names[i]);
+    }
+    printf("],\"edges\":[");
+    for (int i = 0; i < es->count; i++) {
+        printf("%s[%d,%d]", i ? "," : "", es->pairs[2*i], es->pairs[2*i+1]);
+    }
+    printf("]");
+
+    // Inventaires éventuels : {"hostname": ["ifname: addr/prefix", ...]}
+    int first = 1;
+    for (int i = 0; i < ns->count; i++) {
+        if (!info[i].inv) {
+            continue;
+        }
+        printf(first ? ",\"inventory\":{" : ",");
+        first = 0;
+        print_quoted(ns->names[i]);
+        printf(":[");
+        char *save = NULL, *copy = strdup(info[i].inv);
+        int n = 0;
+        for (char *l = strtok_r(copy, "\n", &save); l; l = strtok_r(NULL, "\n", &save)) {
+            printf(n++ ? "," : "");
+            print_quoted(l);
+        }
+        free(copy);
+        printf("]");
+    }
+    printf(first ? "}\n" : "}}\n");
+}
+
+/*
+ * Table des voisins du noyau (--local) : ARP pour IPv4, NDP pour IPv6,
+ * lue par un seul dump RTM_GETNEIGH. Pas de broadcast ni d'attente.
+ */
+typedef struct {
+    int           family;
+    unsigned char addr[16];
+    unsigned char lladdr[16];
+    int           lladdr_len;
+    int           ifindex;
+    int           state;      // NUD_*
+    int           router;     // NTF_ROUTER (IPv6)
+} neigh_entry_t;
+
+typedef struct {
+    neigh_entry_t *entries;
+    int            count;
+    int            cap;
+    int            state_mask; // états retenus
+} neigh_table_t;
+
+static const struct {
+    int         state;
+    const char *name;
+} nud_names[] = {
+    { NUD_INCOMPLETE, "INCOMPLETE" }, { NUD_REACHABLE, "REACHABLE" },
+    { NUD_STALE,      "STALE" },      { NUD_DELAY,     "DELAY" },
+    { NUD_PROBE,      "PROBE" },      { NUD_FAILED,    "FAILED" },
+    { NUD_NOARP,      "NOARP" },      { NUD_PERMANENT, "PERMANENT" },
+};
+#define NUD_NAME_COUNT (int)(sizeof(nud_names) / sizeof(nud_names[0]))
+
+// Par défaut : les voisins joignables ou récemment vus
+#define NUD_DEFAULT_MASK (NUD_REACHABLE | NUD_STALE | NUD_DELAY | NUD_PROBE | NUD_PERMANENT)
+
+static const char *nud_name(int state) {
+    for (int i = 0; i < NUD_NAME_COUNT; i++) {
+        if (state & nud_names[i].state) {
+            return nud_names[i].name;
+        }
+    }
+    return "NONE";
+}
+
+// "reachable,stale" -> masque NUD_* ; -1 si un nom est inconnu
+static int parse_nud_mask(const char *arg) {
+    if (strcasecmp(arg, "all") == 0) {
+        return 0xff;
+    }
+    int mask = 0;
+    char copy[256], *save = NULL;
+    snprintf(copy, sizeof(copy), "%s", arg);
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int found = 0;
+        for (int i = 0; i < NUD_NAME_COUNT; i++) {
+            if (strcasecmp(tok, nud_names[i].name) == 0) {
+                mask |= nud_names[i].state;
+                found = 1;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+    }
+    return mask;
+}
+
+static int neigh_cb(struct nlmsghdr *nh, void *ctx) {
+    neigh_table_t *t = ctx;
+    if (nh->nlmsg_type != RTM_NEWNEIGH) {
+        return 0;
+    }
+    struct ndmsg *ndm = NLMSG_DATA(nh);
+    if ((ndm->ndm_family != AF_INET && ndm->ndm_family != AF_INET6) ||
+        !(ndm->ndm_state & t->state_mask)) {
+        return 0;
+    }
+    struct rtattr *tb[NDA_MAX + 1];
+    nl_parse_attrs(tb, NDA_MAX, (struct rtattr *)((char *)ndm + NLMSG_ALIGN(sizeof(*ndm))),
+                   nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm)));
+    if (!tb[NDA_DST]) {
+        return 0;
+    }
+
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 256;
+        t->entries = xrealloc(t->entries, t->cap * sizeof(*t->entries));
+    }
+    neigh_entry_t *e = &t->entries[t->count++];
+    memset(e, 0, sizeof(*e));
+    e->family  = ndm->ndm_family;
+    e->ifindex = ndm->ndm_ifindex;
+    e->state   = ndm->ndm_state;
+    e->router  = (ndm->ndm_flags & NTF_ROUTER) != 0;
+    memcpy(e->addr, RTA_DATA(tb[NDA_DST]), e->family == AF_INET ? 4 : 16);
+    if (tb[NDA_LLADDR]) {
+        e->lladdr_len = RTA_PAYLOAD(tb[NDA_LLADDR]);
+        if (e->lladdr_len > (int)sizeof(e->lladdr)) {
+            e->lladdr_len = sizeof(e->lladdr);
+        }
+        memcpy(e->lladdr, RTA_DATA(tb[NDA_LLADDR]), e->lladdr_len);
+    }
+    return 0;
+}
+
+static int dump_neighbours(neigh_table_t *t) {
+    int fd = nl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct ndmsg ndm;
+    memset(&ndm, 0, sizeof(ndm));
+    ndm.ndm_family = AF_UNSPEC;
+    int ret = nl_dump(fd, RTM_GETNEIGH, AF_UNSPEC, &ndm, sizeof(ndm), neigh_cb, t);
+    if (ret < 0) {
+        perror("RTM_GETNEIGH");
+    }
+    close(fd);
+    return ret;
+}
+
+/*
+ * Adresses des agents -> hôte agent, construit une fois avant de parcourir
+ * les voisins : adresse source de chaque réponse (IPv4) et adresses de son
+ * inventaire (IPv4 et IPv6). Même table ouverte que node_set_t.
+ */
+typedef struct {
+    int           family;
+    unsigned char addr[16];
+    int           agent;
+} agent_addr_t;
+
+typedef struct {
+    agent_addr_t *items;
+    int           count;
+    int           cap;
+    int          *slots;   // indice + 1, 0 = libre
+    size_t        nslots;
+} agent_map_t;
+
+static uint32_t hash_addr(int family, const unsigned char *addr) {
+    uint32_t h = 2166136261u ^ (uint32_t)family; // FNV-1a
+    for (int i = 0; i < (family == AF_INET ? 4 : 16); i++) {
+        h ^= addr[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void agent_map_rehash(agent_map_t *m, size_t nslots) {
+    free(m->slots);
+    m->slots  = calloc(nslots, sizeof(int));
+    m->nslots = nslots;
+    if (!m->slots) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < m->count; i++) {
+        size_t h = hash_addr(m->items[i].family, m->items[i].addr) & (nslots - 1);
+        while (m->slots[h]) {
+            h = (h + 1) & (nslots - 1);
+        }
+        m->slots[h] = i + 1;
+    }
+}
+
+// Emplacement de (family, addr) : libre (slots[h] == 0) ou déjà occupé par elle
+static size_t agent_map_slot(const agent_map_t *m, int family, const unsigned char *addr) {
+    size_t len = family == AF_INET ? 4 : 16;
+    size_t h = hash_addr(family, addr) & (m->nslots - 1);
+    while (m->slots[h]) {
+        const agent_addr_t *it = &m->items[m->slots[h] - 1];
+        if (it->family == family && memcmp(it->addr, addr, len) == 0) {
+            break;
+        }
+        h = (h + 1) & (m->nslots - 1);
+    }
+    return h;
+}
+
+// Le premier agent inscrit pour une adresse la garde
+static void agent_map_add(agent_map_t *m, int family, const unsigned char *addr, int agent) {
+    if ((size_t)(m->count + 1) * 2 > m->nslots) {
+        agent_map_rehash(m, m->nslots ? m->nslots * 2 : 64);
+    }
+    size_t h = agent_map_slot(m, family, addr);
+    if (m->slots[h]) {
+        return;
+    }
+    if (m->count == m->cap) {
+        m->cap   = m->cap ? m->cap * 2 : 64;
+        m->items = xrealloc(m->items, m->cap * sizeof(*m->items));
+    }
+    agent_addr_t *it = &m->items[m->count];
+    memset(it, 0, sizeof(*it));
+    it->family = family;
+    it->agent  = agent;
+    memcpy(it->addr, addr, family == AF_INET ? 4 : 16);
+    m->slots[h] = m->count + 1;
+    m->count++;
+}
+
+// Agents dans l'ordre des réponses : le premier qui annonce une adresse l'emporte
+static void agent_map_build(agent_map_t *m, const node_info_t *info,
+                            const int *responders, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const node_info_t *ni = &info[responders[i]];
+        agent_map_add(m, AF_INET, (const unsigned char *)&ni->sender, responders[i]);
+        // Lignes "ifname: addr/prefix" de l'inventaire
+        for (const char *l = ni->inv; l && *l; ) {
+            const char *end = strchr(l, '\n');
+            const char *a = strstr(l, ": ");
+            if (a && a < end) {
+                char str[INET6_ADDRSTRLEN];
+                size_t len = strcspn(a + 2, "/\n");
+                unsigned char bin[16];
+                if (len < sizeof(str)) {
+                    memcpy(str, a + 2, len);
+                    str[len] = '\0';
+                    int family = strchr(str, ':') ? AF_INET6 : AF_INET;
+                    if (inet_pton(family, str, bin) == 1) {
+                        agent_map_add(m, family, bin, responders[i]);
+                    }
+                }
+            }
+            l = end + 1;
+        }
+    }
+}
+
+// Hôte agent correspondant à un voisin, -1 si aucun
+static int neigh_agent(const agent_map_t *m, const neigh_entry_t *e) {
+    if (m->count == 0) {
+        return -1;
+    }
+    size_t h = agent_map_slot(m, e->family, e->addr);
+    return m->slots[h] ? m->items[m->slots[h] - 1].agent : -1;
+}
+
+static void print_neighbours(const neigh_table_t *t, const node_set_t *ns,
+                             const node_info_t *info, const int *responders,
+                             int responder_count, int merged)
+{
+    printf("=== Voisins L2 (table du noyau) ===\n");
+    if (t->count == 0) {
+        printf("Aucun voisin.\n");
+    }
+    char *agent_seen = merged ? calloc(ns->count + 1, 1) : NULL;
+    int with_agent = 0;
+    agent_map_t agents = {0};
+    if (merged) {
+        agent_map_build(&agents, info, responders, responder_count);
+    }
+
+    for (int i = 0; i < t->count; i++) {
+        const neigh_entry_t *e = &t->entries[i];
+        char addr_str[INET6_ADDRSTRLEN], ifname[IF_NAMESIZE];
+        inet_ntop(e->family, e->addr, addr_str, sizeof(addr_str));
+        if (!if_indextoname(e->ifindex, ifname)) {
+            snprintf(ifname, sizeof(ifname), "if%d", e->ifindex);
+        }
+        printf("- %s dev %s", addr_str, ifname);
+        if (e->lladdr_len > 0) {
+            printf(" lladdr ");
+            for (int b = 0; b < e->lladdr_len; b++) {
+                printf("%s%02x", b ? ":" : "", e->lladdr[b]);
+            }
+        }
+        printf("%s %s", e->router ? " router" : "", nud_name(e->state));
+        if (merged) {
+            int a = neigh_agent(&agents, e);
+            if (a >= 0) {
+                printf(" agent=%s", ns->names[a]);
+                agent_seen[a] = 1;
+                with_agent++;
+            }
+        }
+        printf("\n");
+    }
+
+    if (merged) {
+        printf("=== %d voisin(s) avec agent sur %d ===\n", with_agent, t->count);
+        // Agents qui ont répondu sans être dans la table (relayés, autre segment)
+        int first = 1;
+        for (int i = 0; i < responder_count; i++) {
+            if (agent_seen[responders[i]]) {
+                continue;
+            }
+            if (first) {
+                printf("=== Agents hors de la table des voisins ===\n");
+                first = 0;
+            }
+            printf("- %s (%s)\n", ns->names[responders[i]], inet_ntoa(info[responders[i]].sender));
+        }
+        free(agent_seen);
+        free(agents.items);
+        free(agents.slots);
+    }
+}
+
 // Récupération du hostname local pour 'origin'
 static void get_local_hostname(char *buf, size_t buflen) {
     if (gethostname(buf, buflen) != 0) {
@@ -46,23 +679,73 @@ static void get_local_hostname(char *buf, size_t buflen) {
 
 int main(int argc, char *argv[]) {
     int hop = 1; // par défaut
+    int output = OUTPUT_LIST;
+    int want_inventory = 0;
+    int timeout_ms = 2000;
+    int show_stats = 0;
+    const char *dest_ip = "255.255.255.255";
+    int local_mode = 0;
+    int merge = 0;
+    neigh_table_t neigh = { NULL, 0, 0, NUD_DEFAULT_MASK };
     // Lecture des arguments
     for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-hop") == 0) {
+        if (strcmp(argv[i], "--local") == 0) {
+            local_mode = 1;
+        } else if (strcmp(argv[i], "-merge") == 0) {
+            merge = 1;
+        } else if (strcmp(argv[i], "-state") == 0 && i+1 < argc) {
+            neigh.state_mask = parse_nud_mask(argv[++i]);
+            if (neigh.state_mask <= 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-hop") == 0) {
             if (i+1 < argc) {
                 hop = atoi(argv[++i]);
-                if (hop < 1) {
+                if (hop < 1 || hop > HOP_MAX) {
                     fprintf(stderr, "Valeur de hop invalide.\n");
                     return 1;
                 }
             } else {
                 usage(argv[0]);
             }
+        } else if (strcmp(argv[i], "-timeout") == 0 && i+1 < argc) {
+            timeout_ms = atoi(argv[++i]);
+            if (timeout_ms < 1) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-dest") == 0 && i+1 < argc) {
+            dest_ip = argv[++i];
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "-inv") == 0) {
+            want_inventory = 1;
+        } else if (strcmp(argv[i], "-graph") == 0 && i+1 < argc) {
+            i++;
+            if (strcmp(argv[i], "dot") == 0) {
+                output = OUTPUT_DOT;
+            } else if (strcmp(argv[i], "json") == 0) {
+                output = OUTPUT_JSON;
+            } else {
+                usage(argv[0]);
+            }
         } else {
             usage(argv[0]);
         }
     }
 
+    // --local : la table des voisins suffit, réponse immédiate
+    if (local_mode && !merge) {
+        if (dump_neighbours(&neigh) < 0) {
+            return 1;
+        }
+        print_neighbours(&neigh, NULL, NULL, NULL, 0, 0);
+        return 0;
+    }
+    if (local_mode) {
+        // Fusion : l'inventaire permet d'associer aussi les voisins IPv6
+        want_inventory = 1;
+    }
+
     // Création du socket pour l'envoi et la réception
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
@@ -91,10 +774,14 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Mettre un timeout de 2 secondes pour la réception
+    // Gros buffer de réception : des milliers de réponses arrivent en rafale
+    int rcvbuf = 8 << 20;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Mettre un timeout de 2 secondes (par défaut) pour la réception
     struct timeval tv;
-    tv.tv_sec  = 2;
-    tv.tv_usec = 0;
+    tv.tv_sec  = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
     if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO,
                    &tv, sizeof(tv)) < 0) {
         perror("setsockopt(SO_RCVTIMEO)");
@@ -107,7 +794,11 @@ int main(int argc, char *argv[]) {
     memset(&bcast_addr, 0, sizeof(bcast_addr));
     bcast_addr.sin_family      = AF_INET;
     bcast_addr.sin_port        = htons(AGENT_PORT);
-    bcast_addr.sin_addr.s_addr = inet_addr("255.255.255.255");
+    if (inet_pton(AF_INET, dest_ip, &bcast_addr.sin_addr) != 1) {
+        fprintf(stderr, "Adresse invalide: %s\n", dest_ip);
+        close(sockfd);
+        return 1;
+    }
 
     // Générer un message_id aléatoire
     srand(time(NULL));
@@ -118,13 +809,17 @@ int main(int argc, char *argv[]) {
     get_local_hostname(myhostname, sizeof(myhostname));
 
     // Construire la requête
-    // Format : "NEIGHBOR_DISCOVERY message_id=1234 hop=2 origin=MonHost"
+    // Format : "NEIGHBOR_DISCOVERY message_id=1234 hop=2 origin=MonHost path=MonHost"
+    // Le vecteur de chemin démarre avec nous : c'est la racine du graphe.
     char request[BUFFER_SIZE];
     snprintf(request, sizeof(request),
-             "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s",
-             message_id, hop, myhostname);
+             "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s path=%s%s",
+             message_id, hop, myhostname, myhostname,
+             want_inventory ? " inv=1" : "");
 
     // Envoi broadcast
+    struct timespec t_start;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
     ssize_t sent = sendto(sockfd, request, strlen(request), 0,
                           (struct sockaddr*)&bcast_addr, sizeof(bcast_addr));
     if (sent < 0) {
@@ -133,10 +828,18 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Pour éviter les doublons, on stocke dans un tableau (simple)
-    #define MAX_NEIGHBORS 1000
-    char neighbors[MAX_NEIGHBORS][256];
-    int neighbor_count = 0;
+    // Les hostnames sont dédupliqués par le graphe ; on garde l'ordre
+    // d'arrivée des répondants pour l'affichage en liste.
+    node_set_t nodes = {0};
+    edge_set_t edges = {0};
+    int  *responders = NULL;
+    int   responder_count = 0;
+    long  reply_count = 0;
+    double last_new_ms = 0; // délai du dernier nouveau répondant
+    node_info_t *info = NULL;
+    int   info_cap = 0;
+
+    node_intern(&nodes, myhostname);
 
     // Réception de réponses
     while (1) {
@@ -152,31 +855,76 @@ int main(int argc, char *argv[]) {
         }
         buffer[recvlen] = '\0';
 
-        // Le message reçu est censé être un hostname
-        // On vérifie simplement s'il est déjà connu
-        int known = 0;
-        for (int i = 0; i < neighbor_count; i++) {
-            if (strcmp(neighbors[i], buffer) == 0) {
-                known = 1;
-                break;
-            }
+        // Le message reçu est "hostname" ou "hostname path=a,b,c", suivi
+        // pour l'inventaire d'un octet nul et des enregistrements binaires.
+        size_t hdrlen = strlen(buffer);
+        const unsigned char *bin = (const unsigned char *)buffer + hdrlen + 1;
+        size_t binlen = (size_t)recvlen > hdrlen ? (size_t)recvlen - hdrlen - 1 : 0;
+
+        int part, parts;
+        int idx = record_reply(&nodes, &edges, buffer, &part, &parts);
+        if (idx < 0) {
+            continue;
+        }
+        if (nodes.cap > info_cap) {
+            info = xrealloc(info, nodes.cap * sizeof(*info));
+            memset(info + info_cap, 0, (nodes.cap - info_cap) * sizeof(*info));
+            info_cap = nodes.cap;
+            responders = xrealloc(responders, info_cap * sizeof(int));
         }
-        if (!known && neighbor_count < MAX_NEIGHBORS) {
-            strncpy(neighbors[neighbor_count], buffer, sizeof(neighbors[neighbor_count]) - 1);
-            neighbors[neighbor_count][sizeof(neighbors[neighbor_count]) - 1] = '\0';
-            neighbor_count++;
+        reply_count++;
+        if (!info[idx].responded) {
+            struct timespec t_now;
+            clock_gettime(CLOCK_MONOTONIC, &t_now);
+            last_new_ms = (t_now.tv_sec - t_start.tv_sec) * 1e3 +
+                          (t_now.tv_nsec - t_start.tv_nsec) / 1e6;
+            info[idx].responded = 1;
+            info[idx].sender    = sender_addr.sin_addr;
+            responders[responder_count++] = idx;
         }
+        if (parts > 0) {
+            record_inventory(&info[idx], part, parts, bin, binlen);
+        }
+    }
+    if (nodes.cap > info_cap) {
+        info = xrealloc(info, nodes.cap * sizeof(*info));
+        memset(info + info_cap, 0, (nodes.cap - info_cap) * sizeof(*info));
+        info_cap = nodes.cap;
     }
 
     close(sockfd);
 
+    if (show_stats) {
+        fprintf(stderr, "stats: replies=%ld responders=%d nodes=%d edges=%d last_new_ms=%.1f\n",
+                reply_count, responder_count, nodes.count, edges.count, last_new_ms);
+    }
+
     // Affichage des résultats
-    printf("=== Neighbors trouvés (hop=%d) ===\n", hop);
-    if (neighbor_count == 0) {
-        printf("Aucun voisin détecté.\n");
+    if (local_mode) {
+        // Lue après la découverte : les échanges ont rafraîchi la table
+        if (dump_neighbours(&neigh) < 0) {
+            return 1;
+        }
+        print_neighbours(&neigh, &nodes, info, responders, responder_count, 1);
+    } else if (output == OUTPUT_DOT) {
+        print_graph_dot(&nodes, &edges);
+    } else if (output == OUTPUT_JSON) {
+        print_graph_json(&nodes, &edges, info);
     } else {
-        for (int i = 0; i < neighbor_count; i++) {
-            printf("- %s\n", neighbors[i]);
+        printf("=== Neighbors trouvés (hop=%d) ===\n", hop);
+        if (responder_count == 0) {
+            printf("Aucun voisin détecté.\n");
+        } else {
+            for (int i = 0; i < responder_count; i++) {
+                const node_info_t *ni = &info[responders[i]];
+                printf("- %s\n", nodes.names[responders[i]]);
+                // Inventaire indenté sous le hostname
+                for (const char *l = ni->inv; l && *l; ) {
+                    const char *end = strchr(l, '\n');
+                    printf("    %.*s\n", (int)(end - l), l);
+                    l = end + 1;
+                }
+            }
         }
     }
 
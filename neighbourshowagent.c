@@ -2,20 +2,69 @@
  * agent.c
  *
  * Compilation :
- *    gcc agent.c -o agent
+ *    gcc -pthread agent.c -o agent
  *
  * Exécution (exemple) :
  *    sudo ./agent
+ *    sudo ./agent -record capture.nscap   # journal pour neighbourreplay
+ *    sudo ./agent -cpus 0-3               # un worker fixé par cœur listé
+ *    sudo ./agent -cpus 0-3 -busypoll 50  # faible latence
+ *    ./agent -filtercheck                 # cas limites du filtre BPF
  *
  * Explications :
  *  - Écoute UDP 9999
  *  - À la réception d'un message du type :
  *       "NEIGHBOR_DISCOVERY message_id=1234 hop=3 origin=machineA"
  *    -> Répond avec le hostname
- *    -> S'il hop>1, décrémente hop et envoie la requête vers la gateway.
+ *    -> S'il hop>1, décrémente hop et envoie la requête vers la gateway
+ *       (passerelle par défaut lue par rtnetlink, plus de popen("ip route")).
+ *
+ *  - Champs optionnels (ignorés par les anciens agents) :
+ *       "path=machineA,relais1,relais2"  : vecteur de chemin, chaque relais
+ *                                          s'y ajoute avant de retransmettre
+ *       "reply=10.0.0.1:40000"           : adresse du client d'origine, posée
+ *                                          par le premier relais pour que les
+ *                                          réponses lointaines lui parviennent
+ *    -> La réponse devient alors "hostname path=<path reçu>"
+ *       "inv=1"                          : joindre l'inventaire des adresses
+ *                                          (format binaire, neighbourproto.h)
+ *
+ *  - Garde-fous contre l'amplification :
+ *       hop > HOP_MAX            -> message ignoré
+ *       seau de jetons par IP source et par origin (table de hachage compacte)
+ *       budget global de relais par seconde
+ *
+ *  - Un filtre BPF classique (SO_ATTACH_FILTER) rejette dans le noyau les
+ *    datagrammes étrangers, mal formés ou dont le hop dépasse HOP_MAX :
+ *    ni réveil ni copie en espace utilisateur pour ces paquets.
+ *    -filtercheck joue ses cas limites (hop=0, 9, 10, 1000, message_id
+ *    trop long...) sur un socket local et vérifie lesquels le noyau
+ *    rejette.
+ *
+ *  - -record <fichier> : enregistre chaque datagramme reçu (horodaté) dans
+ *    un journal binaire compact (format : neighbourcap.h), rejouable avec
+ *    neighbourreplay.c. Le journal est vidé au moins chaque seconde et
+ *    fermé proprement sur SIGINT / SIGTERM.
+ *
+ *  - Le traitement des messages est dans neighbourproto.h (partagé avec
+ *    netinfod.c).
+ *
+ *  - -w n / -cpus <liste|auto> : plusieurs workers, chacun avec son
+ *    socket SO_REUSEPORT ; avec -cpus, chacun fixé sur un cœur et servi
+ *    par les datagrammes reçus sur ce cœur (cpupin.h). Chaque worker a ses
+ *    propres tables de garde-fous et son buffer d'inventaire, alloués
+ *    après placement (nœud NUMA local), et ses caches de passerelle et
+ *    d'adresses : le traitement est parallèle, sans verrou. Seuls le
+ *    budget de relais (atomique) et le journal -record (son verrou) sont
+ *    communs.
+ *
+ *  - -busypoll usec : mode faible latence (busypoll.h), SO_BUSY_POLL sur
+ *    chaque socket : le recvfrom() bloquant du worker interroge lui-même
+ *    la file de la carte. Mesure : latbench.sh (avec et sans).
  *
  ****************************************************/
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,23 +73,36 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netdb.h>
 #include <time.h>
 #include <ctype.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
 
-#define AGENT_PORT 9999
-#define BUFFER_SIZE 1024
+#include "nlutil.h"
+#include "ifsnapshot.h"
+#include "neighbourproto.h"
+#include "neighbourcap.h"
+#include "cpupin.h"
+#include "busypoll.h"
 
-// Stockage basique des messages déjà vus (origin, message_id)
-#define MAX_SEEN 1000
+#define MAX_WORKERS 64
 
-typedef struct {
-    char origin[64];
-    int  message_id;
-} seen_message_t;
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
 
-static seen_message_t seen_messages[MAX_SEEN];
-static int seen_count = 0;
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-record <fichier>] [-w n] [-cpus <liste|auto>] [-busypoll usec]\n"
+                    "       %s -filtercheck\n",
+            prog, prog);
+    exit(EXIT_FAILURE);
+}
 
 // Récupère le hostname local
 static void get_local_hostname(char *buf, size_t buflen) {
@@ -51,93 +113,169 @@ static void get_local_hostname(char *buf, size_t buflen) {
     }
 }
 
-// Récupère la passerelle par défaut (IPv4) en la parsant dans "ip route show default"
-// => renvoie 1 si trouvé, 0 sinon
-static int get_default_gateway(char *gateway, size_t gwlen) {
-    FILE *fp = popen("ip route show default", "r");
-    if (!fp) {
-        perror("popen");
+// Passerelle par défaut (IPv4), lue par rtnetlink et gardée GATEWAY_TTL_MS
+#define GATEWAY_TTL_MS 1000
+
+static int gateway_cb(struct nlmsghdr *nh, void *ctx) {
+    char *gw = ctx;
+    struct rtmsg *rtm = NLMSG_DATA(nh);
+    struct rtattr *tb[RTA_MAX + 1];
+    if (nh->nlmsg_type != RTM_NEWROUTE || rtm->rtm_family != AF_INET ||
+        rtm->rtm_dst_len != 0 || gw[0]) {
         return 0;
     }
-    char line[256];
-    memset(gateway, 0, gwlen);
-
-    while (fgets(line, sizeof(line), fp)) {
-        // Exemple: "default via 192.168.1.254 dev eth0 ..."
-        char *via = strstr(line, "via ");
-        if (via) {
-            via += 4; // skip "via "
-            sscanf(via, "%63s", gateway);
-            break;
-        }
+    nl_parse_attrs(tb, RTA_MAX, RTM_RTA(rtm), RTM_PAYLOAD(nh));
+    unsigned int table = tb[RTA_TABLE] ? *(unsigned int *)RTA_DATA(tb[RTA_TABLE])
+                                       : rtm->rtm_table;
+    if (table == RT_TABLE_MAIN && tb[RTA_GATEWAY]) {
+        inet_ntop(AF_INET, RTA_DATA(tb[RTA_GATEWAY]), gw, INET_ADDRSTRLEN);
     }
+    return 0;
+}
 
-    pclose(fp);
+// => renvoie 1 si trouvé, 0 sinon (cache propre à chaque worker)
+static int get_default_gateway(char *gateway, size_t gwlen) {
+    static __thread char     cached[INET_ADDRSTRLEN];
+    static __thread uint32_t cached_at;
+    static __thread int      cached_valid;
 
-    if (strlen(gateway) > 0) {
-        return 1;
-    } else {
-        return 0;
+    uint32_t now = now_ms();
+    if (!cached_valid || now - cached_at >= GATEWAY_TTL_MS) {
+        int fd = nl_open(0);
+        if (fd < 0) {
+            return 0;
+        }
+        // Le noyau ne renvoie que la table main (Linux >= 4.20), sinon on filtre ici
+        int one = 1;
+        setsockopt(fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &one, sizeof(one));
+        struct {
+            struct rtmsg  rtm;
+            struct rtattr rta;
+            unsigned int  table;
+        } req;
+        memset(&req, 0, sizeof(req));
+        req.rtm.rtm_family = AF_INET;
+        req.rta.rta_type   = RTA_TABLE;
+        req.rta.rta_len    = RTA_LENGTH(sizeof(req.table));
+        req.table          = RT_TABLE_MAIN;
+
+        cached[0] = '\0';
+        int ret = nl_dump(fd, RTM_GETROUTE, AF_INET, &req, sizeof(req), gateway_cb, cached);
+        close(fd);
+        if (ret < 0) {
+            return 0;
+        }
+        cached_at    = now;
+        cached_valid = 1;
     }
+
+    snprintf(gateway, gwlen, "%s", cached);
+    return gateway[0] != '\0';
 }
 
-// Vérifie si (origin, message_id) déjà vu
-static int has_already_seen(const char *origin, int msg_id) {
-    for (int i = 0; i < seen_count; i++) {
-        if ((seen_messages[i].message_id == msg_id) &&
-            (strcmp(seen_messages[i].origin, origin) == 0)) {
-            return 1;
+/*
+ * Inventaire des adresses IPv4/IPv6 pour les réponses "inv=1", encodé
+ * depuis l'énumération partagée (ifsnapshot.h, étiquettes d'alias
+ * comprises). Les adresses sont gardées INVENTORY_TTL_MS, dans une arène
+ * propre à chaque worker.
+ */
+#define INVENTORY_TTL_MS 1000
+
+static size_t get_inventory(unsigned char *buf, size_t buflen) {
+    static __thread ifsnap_t snap;
+    static __thread uint32_t snap_at;
+    static __thread int      snap_valid;
+
+    uint32_t now = now_ms();
+    if (!snap_valid || now - snap_at >= INVENTORY_TTL_MS) {
+        if (ifsnap_collect_alloc(&snap, NULL) < 0) {
+            perror("rtnetlink");
+            return 0;
         }
+        snap_at    = now;
+        snap_valid = 1;
     }
-    return 0;
-}
 
-// Marque (origin, message_id) comme vu
-static void mark_as_seen(const char *origin, int msg_id) {
-    if (seen_count < MAX_SEEN) {
-        strncpy(seen_messages[seen_count].origin, origin, sizeof(seen_messages[seen_count].origin) - 1);
-        seen_messages[seen_count].origin[sizeof(seen_messages[seen_count].origin) - 1] = '\0';
-        seen_messages[seen_count].message_id = msg_id;
-        seen_count++;
+    size_t off = 0;
+    for (size_t i = 0; i < snap.count; i++) {
+        const ifsnap_rec_t *r = &snap.recs[i];
+        off = inv_put_record(buf, buflen, off, r->ifname, r->family, r->addr, r->prefixlen);
     }
+    return off;
 }
 
-// Fonction utilitaire pour envoyer la requête (message) en UDP à une IP donnée
-static void send_udp_message(const char *ip, unsigned short port,
-                             const char *message, size_t msg_len)
-{
+/*
+ * Worker : son socket, son cœur (-1 : aucun) et son état de découverte
+ * (neighbourproto.h), à lui seul. Le journal est commun : cap_lock.
+ */
+typedef struct {
+    int id;
+    int cpu;
     int sockfd;
-    struct sockaddr_in addr;
+    discovery_state_t *state;
+} agent_worker_t;
 
-    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-        perror("socket");
-        return;
+static pthread_mutex_t cap_lock = PTHREAD_MUTEX_INITIALIZER;
+static capture_t capture;
+static int       recording; // -record, fixé avant le départ des workers
+static discovery_host_t host;
+
+static void *worker_loop(void *arg) {
+    agent_worker_t *w = arg;
+    struct sockaddr_in client_addr;
+
+    // Placement d'abord : la pile et les buffers du worker restent sur le nœud local
+    if (w->cpu >= 0 && cpu_pin_self(w->cpu) != 0) {
+        fprintf(stderr, "[Agent] Worker %d : placement sur le cœur %d impossible\n",
+                w->id, w->cpu);
+    }
+    w->state = discovery_state_new(w->id);
+    if (!w->state) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
     }
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family      = AF_INET;
-    addr.sin_port        = htons(port);
-    addr.sin_addr.s_addr = inet_addr(ip);
+    // Boucle principale de réception
+    while (!stop_requested) {
+        char buffer[BUFFER_SIZE];
+        socklen_t addr_len = sizeof(client_addr);
+        ssize_t recvlen = recvfrom(w->sockfd, buffer, BUFFER_SIZE - 1, 0,
+                                   (struct sockaddr *)&client_addr, &addr_len);
+        if (recvlen < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Délai de réception (capture active) : vidage périodique
+                pthread_mutex_lock(&cap_lock);
+                cap_tick(&capture);
+                pthread_mutex_unlock(&cap_lock);
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("recvfrom");
+            break; // quitte la boucle en cas d'erreur
+        }
 
-    if (sendto(sockfd, message, msg_len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("sendto");
+        buffer[recvlen] = '\0';
+        if (recording) {
+            pthread_mutex_lock(&cap_lock);
+            cap_write(&capture, &client_addr, buffer, recvlen);
+            pthread_mutex_unlock(&cap_lock);
+        }
+        discovery_handle(w->state, w->sockfd, buffer, &client_addr, &host);
     }
-    close(sockfd);
+    return NULL;
 }
 
-int main(void) {
+// Socket unique (un seul worker, sans placement)
+static int open_socket(void) {
     int sockfd;
-    struct sockaddr_in serv_addr, client_addr;
-    socklen_t addr_len = sizeof(client_addr);
-
-    // Récupération du hostname local
-    char hostname[256];
-    get_local_hostname(hostname, sizeof(hostname));
+    struct sockaddr_in serv_addr;
 
     // Création du socket UDP
     if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     // Bind sur le port AGENT_PORT (9999)
@@ -149,85 +287,128 @@ int main(void) {
     if (bind(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         perror("bind");
         close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+int main(int argc, char *argv[]) {
+    static agent_worker_t workers[MAX_WORKERS];
+    int cpus[MAX_WORKERS];
+    int nworkers = 1, ncpus = 0, busy_poll_usec = 0;
+    const char *record_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-filtercheck") == 0) {
+            return discovery_filter_check();
+        } else if (strcmp(argv[i], "-record") == 0 && i+1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0 && i+1 < argc) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-busypoll") == 0 && i+1 < argc) {
+            busy_poll_usec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-cpus") == 0 && i+1 < argc) {
+            ncpus = cpu_list_parse(argv[++i], cpus, MAX_WORKERS);
+            if (ncpus <= 0) {
+                fprintf(stderr, "Liste de cœurs invalide: %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    // Avec -cpus : un worker par cœur listé
+    if (ncpus > 0) {
+        nworkers = ncpus;
+    }
+    if (nworkers < 1 || nworkers > MAX_WORKERS) {
+        usage(argv[0]);
+    }
+
+    memset(&capture, 0, sizeof(capture));
+    if (record_path && cap_open(&capture, record_path) < 0) {
         return 1;
     }
+    recording = record_path != NULL;
 
-    printf("[Agent] Démarré sur le port %d\n", AGENT_PORT);
-    printf("[Agent] Mon hostname = %s\n", hostname);
+    // Sans SA_RESTART : recvfrom() est interrompu et on ferme le journal
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
 
-    // Boucle principale de réception
-    while (1) {
-        char buffer[BUFFER_SIZE];
-        ssize_t recvlen = recvfrom(sockfd, buffer, BUFFER_SIZE - 1, 0,
-                                   (struct sockaddr *)&client_addr, &addr_len);
-        if (recvlen < 0) {
-            perror("recvfrom");
-            break; // quitte la boucle en cas d'erreur
+    // Récupération du hostname local
+    static char hostname[HOSTNAME_MAX];
+    get_local_hostname(hostname, sizeof(hostname));
+
+    // Un socket, ou un par worker dans le groupe SO_REUSEPORT (ordre des bind)
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].id     = i;
+        workers[i].cpu    = ncpus > 0 ? cpus[i] : -1;
+        workers[i].sockfd = nworkers == 1 && ncpus == 0
+            ? open_socket()
+            : reuseport_socket(SOCK_DGRAM, AGENT_PORT, workers[i].cpu);
+        if (workers[i].sockfd < 0) {
+            return 1;
+        }
+        attach_discovery_filter(workers[i].sockfd);
+        if (busy_poll_usec > 0 && busy_poll_socket(workers[i].sockfd, busy_poll_usec) < 0) {
+            return 1;
         }
+        // Capture : recvfrom() rend la main chaque seconde pour cap_tick()
+        if (record_path) {
+            struct timeval tick = { 1, 0 };
+            setsockopt(workers[i].sockfd, SOL_SOCKET, SO_RCVTIMEO, &tick, sizeof(tick));
+        }
+    }
+    if (ncpus > 0 && reuseport_steer(workers[0].sockfd, cpus, nworkers) < 0) {
+        perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)"); // hachage du flux à la place
+    }
 
-        buffer[recvlen] = '\0';
+    host = (discovery_host_t){ hostname, get_default_gateway, get_inventory };
 
-        // On s'attend à un message du type:
-        //    "NEIGHBOR_DISCOVERY message_id=1234 hop=3 origin=MachineA"
-        // On va parser ça très simplement
-        int msg_id = 0;
-        int hop    = 0;
-        char origin[64];
-        memset(origin, 0, sizeof(origin));
-
-        if (strncmp(buffer, "NEIGHBOR_DISCOVERY", 18) == 0) {
-            // Extraire message_id, hop, origin
-            // Format naïf : "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s"
-            char dummy[32]; // pour "NEIGHBOR_DISCOVERY"
-            if (sscanf(buffer, "%s message_id=%d hop=%d origin=%63s",
-                       dummy, &msg_id, &hop, origin) == 4)
-            {
-                // Vérifier si on a déjà vu (origin, msg_id)
-                if (!has_already_seen(origin, msg_id)) {
-                    // Marquer comme vu
-                    mark_as_seen(origin, msg_id);
-
-                    // Répondre immédiatement au client -> on envoie "hostname"
-                    {
-                        ssize_t sent = sendto(sockfd,
-                                              hostname,
-                                              strlen(hostname),
-                                              0,
-                                              (struct sockaddr *)&client_addr,
-                                              addr_len);
-                        if (sent < 0) {
-                            perror("sendto response");
-                        }
-                    }
-
-                    // Si hop > 1, relayer vers la gateway (hop - 1)
-                    if (hop > 1) {
-                        // Récupère la GW
-                        char gateway[64];
-                        if (get_default_gateway(gateway, sizeof(gateway))) {
-                            // Construit le nouveau message
-                            char new_msg[BUFFER_SIZE];
-                            snprintf(new_msg, sizeof(new_msg),
-                                     "NEIGHBOR_DISCOVERY message_id=%d hop=%d origin=%s",
-                                     msg_id, hop - 1, origin);
-
-                            // Envoie en unicast à la GW
-                            send_udp_message(gateway, AGENT_PORT,
-                                             new_msg, strlen(new_msg));
-                            // NOTE : Sur un routeur, on voudrait diffuser
-                            //        sur chaque interface (sauf celle d'où
-                            //        est venue la requête). Ici, on se limite
-                            //        à la gateway par défaut : BFS simple.
-                        }
-                    }
-                }
-                // sinon -> déjà vu, on ne fait rien
-            }
-            // sinon -> format invalide, on ignore
+    printf("[Agent] Démarré sur le port %d\n", AGENT_PORT);
+    printf("[Agent] Mon hostname = %s\n", hostname);
+    if (record_path) {
+        printf("[Agent] Capture vers %s\n", record_path);
+    }
+    if (busy_poll_usec > 0) {
+        printf("[Agent] Busy polling : %d µs\n", busy_poll_usec);
+    }
+
+    // Les signaux d'arrêt ne réveillent que le thread principal (worker 0)
+    sigset_t stop_set, old_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, &old_set);
+    for (int i = 1; i < nworkers; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker_loop, &workers[i]) != 0) {
+            perror("pthread_create");
+            return 1;
         }
-        // sinon -> message non reconnu, on ignore
     }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    for (int i = 0; i < nworkers; i++) {
+        if (workers[i].cpu >= 0) {
+            printf("[Agent] Worker %d : cœur %d (nœud %d)\n", i, workers[i].cpu,
+                   cpu_node(workers[i].cpu));
+        }
+    }
+    fflush(stdout);
+
+    worker_loop(&workers[0]);
 
-    close(sockfd);
+    // Les autres workers s'arrêtent avec le processus, hors écriture du journal
+    pthread_mutex_lock(&cap_lock);
+    if (record_path) {
+        printf("[Agent] %lu datagrammes capturés\n", capture.records);
+        cap_close(&capture);
+    }
+    for (int i = 0; i < nworkers; i++) {
+        close(workers[i].sockfd);
+    }
     return 0;
 }
@@ -0,0 +1,269 @@
+#!/bin/bash
+#####################################################
+# neighboursim.sh
+#
+# Banc d'essai de la découverte multi-sauts sur une
+# seule machine Linux : un namespace réseau par noeud,
+# reliés par des paires veth (liens point à point) et
+# des bridges (segments partagés).
+#
+# Exécution (root, iproute2) :
+#    sudo ./neighboursim.sh -t line -n 20 -hop 5
+#    sudo ./neighboursim.sh -t tree -n 500 -k 3 -hop 5
+#    sudo ./neighboursim.sh -t mesh -n 100 -hop 8
+#    sudo ./neighboursim.sh -t fattree -k 4 -hop 4
+#
+# Topologies :
+#  - line    : 0 - 1 - 2 - ... - n-1
+#  - tree    : arbre k-aire enraciné en 0
+#  - mesh    : grille carrée (liens droite / bas)
+#  - fattree : leaf-spine, k/2 spines, k leaves, chaque
+#              leaf porte un bridge avec k/2 hôtes
+#              (-n est alors calculé)
+#
+# Le noeud 0 lance neighbourshow ; chaque noeud lance un
+# agent avec son propre hostname (unshare -u). L'agent ne
+# relaie que vers sa passerelle par défaut : on la pointe
+# vers le premier fils dans l'arbre couvrant (BFS depuis 0),
+# et chaque noeud a une route retour vers les adresses du
+# noeud 0 via son parent, pour que les réponses "reply="
+# reviennent.
+#
+# Mesures :
+#  - complétude   : répondants / noeuds
+#  - convergence  : délai du dernier nouveau répondant
+#  - paquets UDP émis par noeud (/proc/net/snmp de chaque ns)
+#  - CPU des agents (utime + stime pendant la découverte)
+#####################################################
+
+set -u
+
+TOPO=line
+N=10
+K=2
+HOP=3
+TIMEOUT=3000
+AGENT=./neighbourshowagent
+CLIENT=./neighbourshow
+KEEP=0
+PFX=nsim
+
+usage() {
+    echo "Usage: $0 [-t line|tree|mesh|fattree] [-n noeuds] [-k arité] [-hop n]" >&2
+    echo "          [-timeout ms] [-agent binaire] [-client binaire] [-keep]" >&2
+    exit 1
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -t)       TOPO=$2; shift ;;
+        -n)       N=$2; shift ;;
+        -k)       K=$2; shift ;;
+        -hop)     HOP=$2; shift ;;
+        -timeout) TIMEOUT=$2; shift ;;
+        -agent)   AGENT=$2; shift ;;
+        -client)  CLIENT=$2; shift ;;
+        -keep)    KEEP=1 ;;
+        *)        usage ;;
+    esac
+    shift
+done
+
+[ "$(id -u)" -eq 0 ] || { echo "Il faut être root." >&2; exit 1; }
+AGENT=$(readlink -f "$AGENT")
+CLIENT=$(readlink -f "$CLIENT")
+[ -x "$AGENT" ] && [ -x "$CLIENT" ] || { echo "Binaires introuvables : $AGENT $CLIENT" >&2; exit 1; }
+
+# ---------- Construction de la liste des liens ----------
+# LINKS : "a b" (veth point à point) ; SEGMENTS : "m1 m2 m3 ..." (bridge)
+LINKS=()
+SEGMENTS=()
+
+case "$TOPO" in
+    line)
+        for ((i = 1; i < N; i++)); do LINKS+=("$((i - 1)) $i"); done
+        ;;
+    tree)
+        for ((i = 1; i < N; i++)); do LINKS+=("$(((i - 1) / K)) $i"); done
+        ;;
+    mesh)
+        W=1
+        while ((W * W < N)); do ((W++)); done
+        for ((i = 0; i < N; i++)); do
+            ((i % W + 1 < W && i + 1 < N)) && LINKS+=("$i $((i + 1))")
+            ((i + W < N)) && LINKS+=("$i $((i + W))")
+        done
+        ;;
+    fattree)
+        ((K >= 2 && K % 2 == 0)) || { echo "fattree : k pair >= 2" >&2; exit 1; }
+        SPINES=$((K / 2)); LEAVES=$K; HOSTS=$((K / 2))
+        # Numérotation : hôtes d'abord (le noeud 0 est un hôte), puis leaves, puis spines
+        N=$((LEAVES * HOSTS + LEAVES + SPINES))
+        for ((l = 0; l < LEAVES; l++)); do
+            leaf=$((LEAVES * HOSTS + l))
+            members="$leaf"
+            for ((h = 0; h < HOSTS; h++)); do members+=" $((l * HOSTS + h))"; done
+            SEGMENTS+=("$members")
+            for ((s = 0; s < SPINES; s++)); do
+                LINKS+=("$leaf $((LEAVES * HOSTS + LEAVES + s))")
+            done
+        done
+        ;;
+    *)
+        usage ;;
+esac
+
+# ---------- Nettoyage ----------
+AGENT_PIDS=()
+cleanup() {
+    for pid in "${AGENT_PIDS[@]}"; do kill "$pid" 2>/dev/null; done
+    wait 2>/dev/null
+    if [ "$KEEP" -eq 0 ]; then
+        for ((i = 0; i < N; i++)); do ip netns del "$PFX$i" 2>/dev/null; done
+        ip netns del "${PFX}sw" 2>/dev/null
+    fi
+}
+trap cleanup EXIT INT TERM
+
+echo "[sim] Topologie $TOPO : $N noeuds, ${#LINKS[@]} liens, ${#SEGMENTS[@]} segments, hop=$HOP"
+
+for ((i = 0; i < N; i++)); do
+    ip netns add "$PFX$i"
+    ip -n "$PFX$i" link set lo up
+    ip netns exec "$PFX$i" sysctl -qw net.ipv4.ip_forward=1
+    ip netns exec "$PFX$i" sysctl -qw net.ipv6.conf.all.disable_ipv6=1
+done
+
+# ADJ[i] : "voisin:adresse_du_voisin ..." ; ADDRS[i] : adresses du noeud i
+declare -A ADJ ADDRS
+
+# Liens point à point en /30 : 10.X.Y.Z, jusqu'à 16384 liens
+lid=0
+for l in "${LINKS[@]}"; do
+    set -- $l; a=$1; b=$2
+    base=$((lid * 4))
+    ipa="10.$((base >> 16 & 255)).$((base >> 8 & 255)).$((base & 255 | 1))"
+    ipb="10.$((base >> 16 & 255)).$((base >> 8 & 255)).$((base & 255 | 2))"
+    ip link add "v${lid}a" netns "$PFX$a" type veth peer name "v${lid}b" netns "$PFX$b"
+    ip -n "$PFX$a" addr add "$ipa/30" dev "v${lid}a"
+    ip -n "$PFX$b" addr add "$ipb/30" dev "v${lid}b"
+    ip -n "$PFX$a" link set "v${lid}a" up
+    ip -n "$PFX$b" link set "v${lid}b" up
+    ADJ[$a]+="$b:$ipb "; ADJ[$b]+="$a:$ipa "
+    ADDRS[$a]+="$ipa "; ADDRS[$b]+="$ipb "
+    lid=$((lid + 1))
+done
+
+# Segments partagés : un bridge par segment dans le namespace "sw"
+if [ ${#SEGMENTS[@]} -gt 0 ]; then
+    ip netns add "${PFX}sw"
+    sid=0
+    for seg in "${SEGMENTS[@]}"; do
+        ip -n "${PFX}sw" link add "br$sid" type bridge
+        ip -n "${PFX}sw" link set "br$sid" up
+        host=1
+        declare -a SEG_IP=() SEG_NODE=()
+        for m in $seg; do
+            addr="172.$((16 + sid / 256)).$((sid % 256)).$host"
+            ip link add "s${sid}m$host" netns "$PFX$m" type veth peer name "p${sid}m$host" netns "${PFX}sw"
+            ip -n "${PFX}sw" link set "p${sid}m$host" master "br$sid" up
+            ip -n "$PFX$m" addr add "$addr/24" dev "s${sid}m$host"
+            ip -n "$PFX$m" link set "s${sid}m$host" up
+            ADDRS[$m]+="$addr "
+            SEG_IP+=("$addr"); SEG_NODE+=("$m")
+            host=$((host + 1))
+        done
+        for ((x = 0; x < ${#SEG_NODE[@]}; x++)); do
+            for ((y = 0; y < ${#SEG_NODE[@]}; y++)); do
+                ((x != y)) && ADJ[${SEG_NODE[$x]}]+="${SEG_NODE[$y]}:${SEG_IP[$y]} "
+            done
+        done
+        unset SEG_IP SEG_NODE
+        sid=$((sid + 1))
+    done
+fi
+
+# ---------- Arbre couvrant (BFS depuis 0) et routes ----------
+declare -A PARENT VIA FIRST_CHILD
+PARENT[0]=-1
+queue=(0)
+qh=0
+while ((qh < ${#queue[@]})); do
+    u=${queue[$qh]}; qh=$((qh + 1))
+    for e in ${ADJ[$u]:-}; do
+        v=${e%%:*}; vaddr=${e#*:}
+        [ -n "${PARENT[$v]:-}" ] && continue
+        PARENT[$v]=$u
+        [ -z "${FIRST_CHILD[$u]:-}" ] && FIRST_CHILD[$u]=$vaddr
+        queue+=("$v")
+    done
+done
+# Adresse du parent vue depuis chaque noeud
+for ((v = 1; v < N; v++)); do
+    p=${PARENT[$v]:-}
+    [ -z "$p" ] && continue
+    for e in ${ADJ[$v]}; do
+        [ "${e%%:*}" = "$p" ] && { VIA[$v]=${e#*:}; break; }
+    done
+done
+
+unreachable=0
+for ((v = 0; v < N; v++)); do
+    if [ -z "${PARENT[$v]:-}" ]; then unreachable=$((unreachable + 1)); continue; fi
+    gw=${FIRST_CHILD[$v]:-${VIA[$v]:-}}
+    [ -n "$gw" ] && ip -n "$PFX$v" route add default via "$gw"
+    if ((v != 0)) && [ "${PARENT[$v]}" != 0 ]; then
+        for a in ${ADDRS[0]}; do
+            ip -n "$PFX$v" route add "$a/32" via "${VIA[$v]}"
+        done
+    fi
+done
+((unreachable > 0)) && echo "[sim] Attention : $unreachable noeud(s) non connexe(s)"
+
+# ---------- Lancement des agents ----------
+LOGDIR=$(mktemp -d /tmp/neighboursim.XXXXXX)
+for ((i = 0; i < N; i++)); do
+    ip netns exec "$PFX$i" unshare -u sh -c "hostname node$i; exec $AGENT" \
+        > "$LOGDIR/agent$i.log" 2>&1 &
+    AGENT_PIDS+=($!)
+done
+sleep 1
+
+udp_out() {
+    ip netns exec "$1" awk '/^Udp:/ && $2 ~ /^[0-9]+$/ { print $5 }' /proc/net/snmp
+}
+cpu_ticks() {
+    awk '{ print $14 + $15 }' "/proc/$1/stat" 2>/dev/null || echo 0
+}
+
+declare -a OUT0 CPU0
+for ((i = 0; i < N; i++)); do
+    OUT0[$i]=$(udp_out "$PFX$i")
+    CPU0[$i]=$(cpu_ticks "${AGENT_PIDS[$i]}")
+done
+
+# ---------- Découverte ----------
+ip netns exec "${PFX}0" unshare -u sh -c \
+    "hostname node0; exec $CLIENT -hop $HOP -timeout $TIMEOUT -stats" \
+    > "$LOGDIR/client.out" 2> "$LOGDIR/client.err"
+
+# ---------- Résultats ----------
+responders=$(grep -c '^- ' "$LOGDIR/client.out")
+stats=$(grep '^stats:' "$LOGDIR/client.err")
+last_ms=$(echo "$stats" | sed -n 's/.*last_new_ms=\([0-9.]*\).*/\1/p')
+
+pkts_total=0; pkts_max=0; cpu_total=0; cpu_max=0
+for ((i = 0; i < N; i++)); do
+    d=$(( $(udp_out "$PFX$i") - ${OUT0[$i]} ))
+    c=$(( $(cpu_ticks "${AGENT_PIDS[$i]}") - ${CPU0[$i]} ))
+    pkts_total=$((pkts_total + d)); ((d > pkts_max)) && pkts_max=$d
+    cpu_total=$((cpu_total + c));   ((c > cpu_max)) && cpu_max=$c
+done
+hz=$(getconf CLK_TCK)
+
+echo "[sim] Complétude    : $responders / $N noeuds"
+echo "[sim] Convergence   : ${last_ms:-?} ms (dernier nouveau répondant)"
+echo "[sim] Paquets UDP   : total $pkts_total, moyenne $(awk "BEGIN { printf \"%.2f\", $pkts_total / $N }") / noeud, max $pkts_max"
+echo "[sim] CPU agents    : total $(awk "BEGIN { printf \"%.3f\", $cpu_total / $hz }") s, max $(awk "BEGIN { printf \"%.3f\", $cpu_max / $hz }") s"
+echo "[sim] Client        : $stats"
+echo "[sim] Journaux      : $LOGDIR"
@@ -0,0 +1,562 @@
+/****************************************************
+ * netinfod.c
+ *
+ * Compilation :
+ *    gcc netinfod.c -o netinfod
+ *
+ * Exécution (exemple) :
+ *    sudo ./netinfod
+ *
+ * Explications :
+ *  - Remplace ifnetshowserv.c (TCP 9999) et neighbourshowagent.c
+ *    (UDP 9999) par un seul processus et une seule boucle epoll.
+ *  - TCP : mêmes requêtes et même format que ifnetshowserv.c
+ *       "-a"          -> "ifname: addr/prefix" pour toutes les interfaces
+ *       "-i <ifname>" -> "addr/prefix" pour l'interface (ou l'alias) demandée
+ *       "-o <ip>..."  -> interface qui possède ou dessert chaque adresse
+ *    "-a" et "-i" acceptent "-format text|json|bin" (rendus de ifsnapshot.h).
+ *  - UDP : même protocole de découverte que l'agent (neighbourproto.h).
+ *  - Les adresses sont un instantané ifsnapshot.h, comme dans
+ *    ifnetshowserv.c (étiquettes d'alias "lo:7" comprises) : une
+ *    notification de lien ou d'adresse l'invalide, il est redumpé à la
+ *    requête suivante, jamais à chaque requête. La passerelle par défaut
+ *    suit les notifications de routes : plus de popen("ip route").
+ *  - La réponse à "-a" est rendue une fois par format et par version de
+ *    l'état, et partagée entre les connexions.
+ ****************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <net/if.h>
+
+#include "nlutil.h"
+#include "neighbourproto.h"
+#include "iftrie.h"
+#include "ifsnapshot.h"
+
+#define SERVER_PORT 9999
+#define BUF_SIZE    4096
+#define MAX_EVENTS  64
+
+/* ---------- État partagé, maintenu par rtnetlink ---------- */
+
+// Adresses : instantané ifsnapshot.h (étiquettes d'alias comprises),
+// redumpé au premier besoin après une notification de lien ou d'adresse
+static ifsnap_t      snap;
+static int           snap_stale = 1;
+
+static char          gateway[INET_ADDRSTRLEN];
+static unsigned long state_gen;  // incrémenté à chaque changement d'adresses
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// Recharge l'instantané s'il a été invalidé ; -1 si le dump échoue
+static int state_refresh(void) {
+    if (!snap_stale) {
+        return 0;
+    }
+    if (ifsnap_collect_alloc(&snap, NULL) < 0) {
+        fprintf(stderr, "[netinfod] Échec du dump des adresses\n");
+        return -1;
+    }
+    snap_stale = 0;
+    state_gen++;
+    return 0;
+}
+
+static void handle_route(struct nlmsghdr *nh) {
+    struct rtmsg *rtm = NLMSG_DATA(nh);
+    struct rtattr *tb[RTA_MAX + 1];
+    nl_parse_attrs(tb, RTA_MAX, RTM_RTA(rtm), RTM_PAYLOAD(nh));
+
+    unsigned int table = tb[RTA_TABLE] ? *(unsigned int *)RTA_DATA(tb[RTA_TABLE])
+                                       : rtm->rtm_table;
+    if (rtm->rtm_family != AF_INET || rtm->rtm_dst_len != 0 ||
+        table != RT_TABLE_MAIN || !tb[RTA_GATEWAY]) {
+        return;
+    }
+
+    char gw[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, RTA_DATA(tb[RTA_GATEWAY]), gw, sizeof(gw));
+    if (nh->nlmsg_type == RTM_DELROUTE) {
+        if (strcmp(gw, gateway) == 0) {
+            gateway[0] = '\0';
+        }
+    } else {
+        snprintf(gateway, sizeof(gateway), "%s", gw);
+    }
+}
+
+static int handle_nl_msg(struct nlmsghdr *nh, void *ctx) {
+    (void)ctx;
+    switch (nh->nlmsg_type) {
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+        snap_stale = 1;
+        break;
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+        handle_route(nh);
+        break;
+    }
+    return 0;
+}
+
+// (Re)charge tout l'état : au démarrage, ou si des notifications ont été perdues.
+static int full_sync(int nlfd) {
+    gateway[0] = '\0';
+    snap_stale = 1;
+    if (nl_dump(nlfd, RTM_GETROUTE, AF_INET, NULL, 0, handle_nl_msg, NULL) < 0 ||
+        state_refresh() < 0) {
+        fprintf(stderr, "[netinfod] Échec du dump rtnetlink\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Applique les notifications en attente sur le socket d'événements.
+static void drain_events(int evfd, int nlfd) {
+    char buf[NL_BUFSIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+        ssize_t len = recv(evfd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // Le noyau a dû jeter des notifications : on repart d'un dump
+                fprintf(stderr, "[netinfod] Notifications perdues, resynchronisation\n");
+                full_sync(nlfd);
+                continue;
+            }
+            return; // EAGAIN : plus rien à lire
+        }
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+             NLMSG_OK(nh, (size_t)len);
+             nh = NLMSG_NEXT(nh, len)) {
+            handle_nl_msg(nh, NULL);
+        }
+    }
+}
+
+// Passerelle par défaut pour le relais de découverte
+static int state_gateway(char *gw, size_t gwlen) {
+    snprintf(gw, gwlen, "%s", gateway);
+    return gw[0] != '\0';
+}
+
+// Inventaire joint aux réponses de découverte "inv=1", depuis l'état en cache
+static size_t state_inventory(unsigned char *buf, size_t buflen) {
+    size_t off = 0;
+    if (state_refresh() < 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < snap.count; i++) {
+        const ifsnap_rec_t *r = &snap.recs[i];
+        off = inv_put_record(buf, buflen, off, r->ifname, r->family, r->addr, r->prefixlen);
+    }
+    return off;
+}
+
+/* ---------- Rendu des réponses TCP ---------- */
+
+// Réponse partagée entre connexions, libérée par le dernier utilisateur
+typedef struct {
+    int    refcnt;
+    size_t len;
+    size_t cap;
+    char   data[];
+} response_t;
+
+static response_t *resp_new(void) {
+    response_t *r = xrealloc(NULL, sizeof(*r) + BUF_SIZE);
+    r->refcnt = 1;
+    r->len    = 0;
+    r->cap    = BUF_SIZE;
+    r->data[0] = '\0';
+    return r;
+}
+
+static void resp_put(response_t *r) {
+    if (r && --r->refcnt == 0) {
+        free(r);
+    }
+}
+
+static response_t *resp_printf(response_t *r, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(r->data + r->len, r->cap - r->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            return r;
+        }
+        if ((size_t)n < r->cap - r->len) {
+            r->len += n;
+            return r;
+        }
+        r->cap = (r->cap + n) * 2;
+        r = xrealloc(r, sizeof(*r) + r->cap);
+    }
+}
+
+// Rendu d'un instantané (cf. ifsnapshot.h) dans une réponse à sa taille
+static response_t *render_snap(const ifsnap_t *v, int with_name, ifsnap_render_fn render) {
+    response_t *r = resp_new();
+    size_t len = render(v, with_name, NULL, 0);
+    if (len >= r->cap) {
+        r->cap = len + 1;
+        r = xrealloc(r, sizeof(*r) + r->cap);
+    }
+    render(v, with_name, r->data, r->cap);
+    r->len = len;
+    return r;
+}
+
+#define RENDER_KINDS (sizeof(ifsnap_renderers) / sizeof(ifsnap_renderers[0]))
+
+static response_t   *cached_all[RENDER_KINDS];
+static unsigned long cached_all_gen[RENDER_KINDS];
+
+static response_t *render_all(size_t kind) {
+    if (!cached_all[kind] || cached_all_gen[kind] != state_gen) {
+        resp_put(cached_all[kind]);
+        cached_all[kind] = render_snap(&snap, 1, ifsnap_renderers[kind].fn);
+        cached_all_gen[kind] = state_gen;
+    }
+    cached_all[kind]->refcnt++;
+    return cached_all[kind];
+}
+
+static response_t *render_one(const char *ifname, size_t kind) {
+    // Vue des seules adresses de l'interface (ou de l'alias), gardée d'un appel à l'autre
+    static ifsnap_t view;
+    if (view.cap < snap.count) {
+        view.cap  = snap.count;
+        view.recs = xrealloc(view.recs, view.cap * sizeof(*view.recs));
+    }
+    view.count = 0;
+    for (size_t i = 0; i < snap.count; i++) {
+        if (strncmp(snap.recs[i].ifname, ifname, IF_NAMESIZE) == 0) {
+            view.recs[view.count++] = snap.recs[i];
+        }
+    }
+    view.needed = view.count;
+
+    if (view.count == 0 && ifsnap_renderers[kind].fn == ifsnap_render_text) {
+        return resp_printf(resp_new(), "Aucune adresse pour l'interface %s\n", ifname);
+    }
+    return render_snap(&view, 0, ifsnap_renderers[kind].fn);
+}
+
+// Arbre des préfixes pour "-o", reconstruit seulement quand l'état change
+static iftrie_t      owner_trie;
+static unsigned long owner_trie_gen;
+
+static response_t *render_owner(const char *ips) {
+    if (owner_trie_gen != state_gen) {
+        iftrie_free(&owner_trie);
+        ifsnap_to_trie(&snap, &owner_trie);
+        iftrie_build(&owner_trie);
+        owner_trie_gen = state_gen;
+    }
+
+    response_t *r = resp_new();
+    for (;;) {
+        ips += strspn(ips, " \t\r\n");
+        size_t len = strcspn(ips, " \t\r\n");
+        if (len == 0) {
+            break;
+        }
+        size_t n;
+        while ((n = iftrie_answer(&owner_trie, ips, len, r->data + r->len, r->cap - r->len)) == 0) {
+            r->cap *= 2;
+            r = xrealloc(r, sizeof(*r) + r->cap);
+        }
+        r->len += n;
+        ips += len;
+    }
+    if (r->len == 0) {
+        r = resp_printf(r, "Aucune adresse demandée\n");
+    }
+    r->data[r->len] = '\0';
+    return r;
+}
+
+static response_t *handle_request(char *request) {
+    if (state_refresh() < 0) {
+        return resp_printf(resp_new(), "État des adresses indisponible\n");
+    }
+    if (strncmp(request, "-o ", 3) == 0) {
+        return render_owner(request + 3);
+    }
+
+    // "-a" et "-i" suivis ou non de "-format <f>", comme ifnetshowserv.c
+    size_t kind = 0; // text
+    char *fmt = strstr(request, " -format ");
+    if (fmt) {
+        char fmt_name[16] = "";
+        sscanf(fmt + 9, "%15s", fmt_name);
+        *fmt = '\0';
+        for (kind = 0; kind < RENDER_KINDS; kind++) {
+            if (strcmp(ifsnap_renderers[kind].name, fmt_name) == 0) {
+                break;
+            }
+        }
+        if (kind == RENDER_KINDS) {
+            return resp_printf(resp_new(), "Format inconnu: %s\n", fmt_name);
+        }
+    }
+    if (strncmp(request, "-a", 2) == 0) {
+        return render_all(kind);
+    }
+    if (strncmp(request, "-i ", 3) == 0) {
+        char ifn[128];
+        memset(ifn, 0, sizeof(ifn));
+        sscanf(request + 3, "%127s", ifn);
+        return render_one(ifn, kind);
+    }
+    return resp_printf(resp_new(), "Requête invalide: %s\n", request);
+}
+
+/* ---------- Boucle d'événements ---------- */
+
+enum { SRC_TCP_LISTEN, SRC_UDP, SRC_NETLINK, SRC_CONN };
+
+typedef struct {
+    int kind;
+    int fd;
+} source_t;
+
+typedef struct {
+    source_t    src;           // doit rester en tête (data.ptr d'epoll)
+    char        request[BUF_SIZE];
+    size_t      reqlen;
+    response_t *resp;
+    size_t      off;
+} conn_t;
+
+static int epfd;
+
+static void conn_close(conn_t *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->src.fd, NULL);
+    close(c->src.fd);
+    resp_put(c->resp);
+    free(c);
+}
+
+static void on_accept(int listenfd) {
+    for (;;) {
+        int fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+        conn_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->src.kind = SRC_CONN;
+        c->src.fd   = fd;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static void on_conn(conn_t *c, unsigned int events) {
+    if (!c->resp && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        // Comme ifnetshowserv.c : la requête tient dans un seul envoi
+        ssize_t r = read(c->src.fd, c->request + c->reqlen,
+                         sizeof(c->request) - 1 - c->reqlen);
+        if (r <= 0) {
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+                return;
+            }
+            conn_close(c);
+            return;
+        }
+        c->reqlen += r;
+        c->request[c->reqlen] = '\0';
+        c->resp = handle_request(c->request);
+
+        struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = c };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->src.fd, &ev);
+    }
+
+    if (c->resp) {
+        while (c->off < c->resp->len) {
+            ssize_t w = write(c->src.fd, c->resp->data + c->off, c->resp->len - c->off);
+            if (w < 0) {
+                if (errno == EAGAIN || errno == EINTR) {
+                    return; // on attend le prochain EPOLLOUT
+                }
+                break;
+            }
+            c->off += w;
+        }
+        conn_close(c);
+    }
+}
+
+// Garde-fous de découverte : une seule boucle, un seul état
+static discovery_state_t discovery = { .id = -1 };
+
+static void on_udp(int udpfd, const discovery_host_t *host) {
+    for (;;) {
+        char buffer[BUFFER_SIZE];
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+
+        ssize_t recvlen = recvfrom(udpfd, buffer, BUFFER_SIZE - 1, MSG_DONTWAIT,
+                                   (struct sockaddr *)&client_addr, &addr_len);
+        if (recvlen < 0) {
+            return;
+        }
+        buffer[recvlen] = '\0';
+        discovery_handle(&discovery, udpfd, buffer, &client_addr, host);
+    }
+}
+
+static int open_listener(int type) {
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(SERVER_PORT);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (type == SOCK_STREAM && listen(fd, 128) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);
+
+    char hostname[HOSTNAME_MAX];
+    if (gethostname(hostname, sizeof(hostname)) != 0) {
+        perror("gethostname");
+        snprintf(hostname, sizeof(hostname), "UnknownHost");
+    }
+
+    // On s'abonne avant le dump initial : un changement survenu entre les
+    // deux est rejoué par la notification, et les handlers sont idempotents.
+    int evfd = nl_open(RTMGRP_LINK | RTMGRP_IPV4_IFADDR |
+                       RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE);
+    int nlfd = nl_open(0);
+    if (evfd < 0 || nlfd < 0 || full_sync(nlfd) < 0) {
+        return 1;
+    }
+
+    int tcpfd = open_listener(SOCK_STREAM);
+    int udpfd = open_listener(SOCK_DGRAM);
+    if (tcpfd < 0 || udpfd < 0) {
+        return 1;
+    }
+    attach_discovery_filter(udpfd);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    static source_t tcp_src, udp_src, nl_src;
+    tcp_src = (source_t){ SRC_TCP_LISTEN, tcpfd };
+    udp_src = (source_t){ SRC_UDP, udpfd };
+    nl_src  = (source_t){ SRC_NETLINK, evfd };
+    source_t *sources[] = { &tcp_src, &udp_src, &nl_src };
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = sources[i] };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sources[i]->fd, &ev) < 0) {
+            perror("epoll_ctl");
+            return 1;
+        }
+    }
+
+    discovery_host_t host = { hostname, state_gateway, state_inventory };
+
+    printf("[netinfod] En écoute sur TCP et UDP %d (%zu adresses, passerelle %s)\n",
+           SERVER_PORT, snap.count, gateway[0] ? gateway : "aucune");
+    printf("[netinfod] Mon hostname = %s\n", hostname);
+
+    for (;;) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            source_t *src = events[i].data.ptr;
+            switch (src->kind) {
+            case SRC_TCP_LISTEN:
+                on_accept(src->fd);
+                break;
+            case SRC_UDP:
+                on_udp(src->fd, &host);
+                break;
+            case SRC_NETLINK:
+                drain_events(src->fd, nlfd);
+                break;
+            case SRC_CONN:
+                on_conn((conn_t *)src, events[i].events);
+                break;
+            }
+        }
+    }
+
+    close(epfd);
+    close(tcpfd);
+    close(udpfd);
+    close(nlfd);
+    close(evfd);
+    return 0;
+}
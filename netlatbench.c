@@ -0,0 +1,251 @@
+/****************************************************
+ * netlatbench.c
+ *
+ * Compilation :
+ *    gcc -O2 netlatbench.c -o netlatbench
+ *
+ * Exécution (exemples) :
+ *    ./netlatbench -tcp 10.0.0.1 -req "-i eth0" -n 10000
+ *    ./netlatbench -udp 10.0.0.1 -src 10.0.1.0/24 -n 10000 -busypoll 50
+ *
+ * Explications :
+ *  - Mesure la latence de bout en bout, une requête à la fois
+ *    (jamais deux en vol) :
+ *     -tcp ip : ifnetshowserv, connexion + requête (-req, "-i lo"
+ *               par défaut) + réponse lue jusqu'à la fermeture ;
+ *     -udp ip : neighbourshowagent, message de découverte hop=1
+ *               jusqu'à la réponse "hostname".
+ *  - Affiche une ligne : min, p50, p90, p99, p99.9 et max en µs
+ *    (-label pour la nommer). latbench.sh lance les démons avec et
+ *    sans -busypoll et compare ces lignes.
+ *  - -busypoll usec : busy polling aussi côté client (busypoll.h).
+ *  - -src a.b.c.d/N (UDP) : l'adresse source tourne sur le préfixe
+ *    (adresses locales) ; avec un message_id et un origin propres à
+ *    chaque requête, on reste sous les seaux de jetons de l'agent.
+ *  - -warmup n : requêtes non comptées au départ (100 par défaut).
+ *  - -timeout ms : au-delà, la requête est comptée perdue et sort
+ *    des centiles.
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "busypoll.h"
+
+#define PORT 9999
+#define RESP_SIZE 65536
+
+static int busy_poll_usec;
+static struct timeval io_timeout = { 1, 0 };
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "  %s -tcp <ip> [-req <requête>] [options]\n", prog);
+    fprintf(stderr, "  %s -udp <ip> [-src a.b.c.d/N] [options]\n", prog);
+    fprintf(stderr, "Options: [-n requêtes] [-warmup n] [-timeout ms] [-busypoll usec] [-label nom]\n");
+    exit(EXIT_FAILURE);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Socket réglé pour la mesure : délai d'attente, busy polling éventuel
+static int bench_socket(int type) {
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+    if (busy_poll_usec > 0 && busy_poll_socket(fd, busy_poll_usec) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Une requête ifnetshowserv. Renvoie la latence en ns, 0 si la requête
+ * a échoué ou dépassé le délai.
+ */
+static uint64_t tcp_request(const struct sockaddr_in *server, const char *req) {
+    static char resp[RESP_SIZE];
+    int fd = bench_socket(SOCK_STREAM);
+    if (fd < 0) {
+        return 0;
+    }
+    uint64_t t0 = now_ns();
+    ssize_t n = -1;
+    if (connect(fd, (const struct sockaddr *)server, sizeof(*server)) == 0 &&
+        write(fd, req, strlen(req)) == (ssize_t)strlen(req)) {
+        while ((n = read(fd, resp, sizeof(resp))) > 0) {
+        }
+    }
+    uint64_t t1 = now_ns();
+    close(fd);
+    return n == 0 ? t1 - t0 : 0;
+}
+
+/*
+ * Un message de découverte vers l'agent, depuis 'src' (port quelconque).
+ * Renvoie la latence en ns, 0 si la réponse n'est pas arrivée.
+ */
+static uint64_t udp_request(const struct sockaddr_in *agent, const struct sockaddr_in *src,
+                            unsigned long seq) {
+    int fd = bench_socket(SOCK_DGRAM);
+    if (fd < 0) {
+        return 0;
+    }
+    if (src && bind(fd, (const struct sockaddr *)src, sizeof(*src)) < 0) {
+        perror("bind");
+        close(fd);
+        return 0;
+    }
+    char msg[128], resp[1024];
+    int len = snprintf(msg, sizeof(msg),
+                       "NEIGHBOR_DISCOVERY message_id=%lu hop=1 origin=bench%d-%lu",
+                       seq % 1000000000ul, (int)getpid(), seq);
+
+    uint64_t t0 = now_ns();
+    ssize_t n = -1;
+    if (sendto(fd, msg, len, 0, (const struct sockaddr *)agent, sizeof(*agent)) == len) {
+        n = recv(fd, resp, sizeof(resp), 0);
+    }
+    uint64_t t1 = now_ns();
+    close(fd);
+    return n > 0 ? t1 - t0 : 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Centile p (0..100) d'un tableau trié : rang ceil(p * n / 100)
+static double percentile_us(const uint64_t *v, size_t n, double p) {
+    size_t rank = (size_t)(p * n / 100.0 + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > n) {
+        rank = n;
+    }
+    return v[rank - 1] / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *tcp_ip = NULL, *udp_ip = NULL, *src_spec = NULL;
+    const char *req = "-i lo", *label = "";
+    long count = 10000, warmup = 100, timeout_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-tcp") == 0 && i+1 < argc) {
+            tcp_ip = argv[++i];
+        } else if (strcmp(argv[i], "-udp") == 0 && i+1 < argc) {
+            udp_ip = argv[++i];
+        } else if (strcmp(argv[i], "-req") == 0 && i+1 < argc) {
+            req = argv[++i];
+        } else if (strcmp(argv[i], "-src") == 0 && i+1 < argc) {
+            src_spec = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            count = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-warmup") == 0 && i+1 < argc) {
+            warmup = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-timeout") == 0 && i+1 < argc) {
+            timeout_ms = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-busypoll") == 0 && i+1 < argc) {
+            busy_poll_usec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-label") == 0 && i+1 < argc) {
+            label = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!tcp_ip == !udp_ip || count < 1 || warmup < 0 || timeout_ms < 1) {
+        usage(argv[0]);
+    }
+    io_timeout.tv_sec  = timeout_ms / 1000;
+    io_timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port   = htons(PORT);
+    if (inet_pton(AF_INET, tcp_ip ? tcp_ip : udp_ip, &server.sin_addr) != 1) {
+        fprintf(stderr, "Adresse invalide: %s\n", tcp_ip ? tcp_ip : udp_ip);
+        return 1;
+    }
+
+    // Préfixe source : adresses hôtes (hors réseau et broadcast au-delà de /31)
+    uint32_t src_base = 0, src_count = 0;
+    if (src_spec) {
+        char ip[INET_ADDRSTRLEN];
+        int plen;
+        struct in_addr a;
+        if (sscanf(src_spec, "%15[^/]/%d", ip, &plen) != 2 || plen < 8 || plen > 32 ||
+            inet_pton(AF_INET, ip, &a) != 1) {
+            fprintf(stderr, "Préfixe source invalide: %s\n", src_spec);
+            return 1;
+        }
+        uint32_t size = plen == 32 ? 1 : 1u << (32 - plen);
+        src_base  = ntohl(a.s_addr) & ~(size - 1);
+        src_count = size;
+        if (size > 2) {
+            src_base++;
+            src_count -= 2;
+        }
+    }
+
+    uint64_t *lat = malloc(count * sizeof(*lat));
+    if (!lat) {
+        perror("malloc");
+        return 1;
+    }
+    size_t n = 0;
+    long lost = 0;
+    for (long i = 0; i < warmup + count; i++) {
+        uint64_t ns;
+        if (tcp_ip) {
+            ns = tcp_request(&server, req);
+        } else {
+            struct sockaddr_in src;
+            memset(&src, 0, sizeof(src));
+            src.sin_family      = AF_INET;
+            src.sin_addr.s_addr = htonl(src_base + (uint32_t)(i % (src_count ? src_count : 1)));
+            ns = udp_request(&server, src_count ? &src : NULL, (unsigned long)i);
+        }
+        if (i < warmup) {
+            continue;
+        }
+        if (ns == 0) {
+            lost++;
+        } else {
+            lat[n++] = ns;
+        }
+    }
+
+    if (n == 0) {
+        fprintf(stderr, "Aucune réponse (%ld perdues)\n", lost);
+        return 1;
+    }
+    qsort(lat, n, sizeof(*lat), cmp_u64);
+    printf("%-12s n=%zu perdues=%ld  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f µs\n",
+           label, n, lost, lat[0] / 1000.0,
+           percentile_us(lat, n, 50), percentile_us(lat, n, 90),
+           percentile_us(lat, n, 99), percentile_us(lat, n, 99.9),
+           lat[n - 1] / 1000.0);
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/****************************************************
+ * nlutil.h
+ *
+ * Petits utilitaires rtnetlink partagés (simple inclusion) :
+ *  - ouverture d'un socket NETLINK_ROUTE, abonné ou non à
+ *    des groupes de notifications ;
+ *  - envoi d'une requête de dump (RTM_GETLINK, RTM_GETADDR,
+ *    RTM_GETROUTE, ...) ;
+ *  - lecture en flux de la réponse, message par message,
+ *    avec un buffer de taille fixe : la mémoire reste
+ *    bornée même pour des dumps de plusieurs millions
+ *    d'entrées.
+ ****************************************************/
+
+#ifndef NLUTIL_H
+#define NLUTIL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#define NL_BUFSIZE 65536
+
+// Rappel pour chaque message d'un dump ; une valeur < 0 arrête la lecture.
+typedef int (*nl_msg_cb)(struct nlmsghdr *nh, void *ctx);
+
+/*
+ * Ouvre un socket rtnetlink. 'groups' : masque RTMGRP_* pour recevoir
+ * les notifications du noyau (0 pour un socket de requêtes seulement).
+ */
+static inline int nl_open(unsigned int groups) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        perror("socket(NETLINK_ROUTE)");
+        return -1;
+    }
+
+    // Les dumps volumineux arrivent plus vite qu'on ne les lit
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = groups;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        perror("bind(NETLINK_ROUTE)");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Envoie une requête de dump 'type' pour la famille 'family'.
+ * 'payload' (taille 'len') suit l'en-tête netlink : ifinfomsg, ifaddrmsg,
+ * rtmsg... Si NULL, un rtgenmsg contenant 'family' est utilisé.
+ */
+static inline int nl_send_dump(int fd, int type, int family, unsigned int seq,
+                               const void *payload, size_t len)
+{
+    struct {
+        struct nlmsghdr nh;
+        char            body[256];
+    } req;
+    struct rtgenmsg gen;
+
+    if (!payload) {
+        memset(&gen, 0, sizeof(gen));
+        gen.rtgen_family = family;
+        payload = &gen;
+        len     = sizeof(gen);
+    }
+    if (len > sizeof(req.body)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len   = NLMSG_LENGTH(len);
+    req.nh.nlmsg_type  = type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq   = seq;
+    memcpy(NLMSG_DATA(&req.nh), payload, len);
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+
+    if (sendto(fd, &req, req.nh.nlmsg_len, 0,
+               (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        perror("sendto(NETLINK_ROUTE)");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Lit la réponse au dump 'seq' et appelle cb() pour chaque message,
+ * jusqu'à NLMSG_DONE. Renvoie 0 si le dump est complet, -1 sinon.
+ * Les messages d'une autre séquence (notifications) sont ignorés.
+ */
+static inline int nl_recv_dump(int fd, unsigned int seq, nl_msg_cb cb, void *ctx) {
+    char buf[NL_BUFSIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("recv(NETLINK_ROUTE)");
+            return -1;
+        }
+
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+             NLMSG_OK(nh, (size_t)len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != seq) {
+                continue;
+            }
+            if (nh->nlmsg_type == NLMSG_DONE) {
+                return 0;
+            }
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return err->error ? -1 : 0;
+            }
+            if (cb(nh, ctx) < 0) {
+                return -1;
+            }
+        }
+    }
+}
+
+// Dump complet : requête + lecture. Renvoie 0 si OK.
+static inline int nl_dump(int fd, int type, int family,
+                          const void *payload, size_t len,
+                          nl_msg_cb cb, void *ctx)
+{
+    static unsigned int next_seq;
+    unsigned int seq = __atomic_add_fetch(&next_seq, 1, __ATOMIC_RELAXED);
+    if (nl_send_dump(fd, type, family, seq, payload, len) < 0) {
+        return -1;
+    }
+    return nl_recv_dump(fd, seq, cb, ctx);
+}
+
+// Range les attributs d'un message dans tb[0..max] (NULL si absents).
+static inline void nl_parse_attrs(struct rtattr *tb[], int max,
+                                  struct rtattr *rta, int len)
+{
+    memset(tb, 0, sizeof(struct rtattr *) * (max + 1));
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        unsigned short type = rta->rta_type & ~NLA_F_NESTED;
+        if (type <= max) {
+            tb[type] = rta;
+        }
+    }
+}
+
+#endif /* NLUTIL_H */